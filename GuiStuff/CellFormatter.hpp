@@ -0,0 +1,194 @@
+#pragma once
+
+#include <wx/grid.h>
+
+#include <boost/hana.hpp>
+
+#include <array>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // Large enough for any fixed notation double, and any number at all in
+  // scientific notation.
+  //----------------------------------------------------------------------------
+  using FormatBuffer = std::array<char, 328>;
+
+  //----------------------------------------------------------------------------
+  // Same text std::to_string would produce, written into buffer without
+  // touching the heap.  A long double too long for fixed notation in buffer
+  // is written in scientific notation instead, and anything that still
+  // doesn't fit comes back empty rather than cut short.
+  //----------------------------------------------------------------------------
+  template <typename T>
+  std::string_view FormatValue(const T& value, FormatBuffer& buffer)
+  {
+    static_assert(
+      std::is_arithmetic_v<T> || std::is_enum_v<T>,
+      "only arithmetic fields can be displayed");
+
+    std::to_chars_result result;
+
+    if constexpr (std::is_floating_point_v<T>)
+    {
+      result = std::to_chars(
+        buffer.data(),
+        buffer.data() + buffer.size(),
+        value,
+        std::chars_format::fixed,
+        6);
+
+      if (result.ec != std::errc())
+      {
+        result = std::to_chars(
+          buffer.data(),
+          buffer.data() + buffer.size(),
+          value,
+          std::chars_format::scientific,
+          6);
+      }
+    }
+    else if constexpr (std::is_enum_v<T>)
+    {
+      result = std::to_chars(
+        buffer.data(),
+        buffer.data() + buffer.size(),
+        static_cast<std::underlying_type_t<T>>(value));
+    }
+    else
+    {
+      // promote so that uint8_t and friends print as numbers
+      result = std::to_chars(
+        buffer.data(),
+        buffer.data() + buffer.size(),
+        +value);
+    }
+
+    if (result.ec != std::errc())
+    {
+      return std::string_view();
+    }
+
+    return std::string_view(buffer.data(), result.ptr - buffer.data());
+  }
+
+  //----------------------------------------------------------------------------
+  // Formats field number column of a hana struct, for callers that only know
+  // the column at runtime (e.g. wx asking a virtual table for a cell).
+  //----------------------------------------------------------------------------
+  template <typename PacketType>
+  class FieldFormatter
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      static std::string_view Format(
+        const PacketType& packet,
+        std::size_t column,
+        FormatBuffer& buffer)
+      {
+        return mFormatters[column](packet, buffer);
+      }
+
+    private:
+
+      using FormatFunction =
+        std::string_view (*)(const PacketType&, FormatBuffer&);
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t Index>
+      static std::string_view FormatField(
+        const PacketType& packet,
+        FormatBuffer& buffer)
+      {
+        namespace hana = boost::hana;
+
+        auto accessor =
+          hana::second(hana::at_c<Index>(hana::accessors<PacketType>()));
+
+        return FormatValue(accessor(packet), buffer);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t ... Indices>
+      static constexpr auto MakeFormatters(std::index_sequence<Indices...>)
+      {
+        return std::array<FormatFunction, sizeof...(Indices)> {
+          &FormatField<Indices>...};
+      }
+
+      static constexpr auto mFormatters = MakeFormatters(
+        std::make_index_sequence<
+          decltype(boost::hana::length(
+            boost::hana::accessors<PacketType>()))::value>());
+  };
+
+  //----------------------------------------------------------------------------
+  // Remembers what is currently shown in each column of a single row grid so
+  // that unchanged cells are skipped.  Columns are only autosized again when a
+  // value has more characters than anything shown in that column before.
+  //----------------------------------------------------------------------------
+  class GridCellCache
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      explicit GridCellCache(std::size_t columnCount)
+        : mBuffer(),
+          mCells(columnCount),
+          mWidestValues(columnCount, 0)
+      {
+        for (auto& cell : mCells)
+        {
+          cell.reserve(32);
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <typename T>
+      void Update(wxGrid* pGrid, int row, int column, const T& value)
+      {
+        auto text = FormatValue(value, mBuffer);
+
+        auto& cell = mCells[column];
+
+        if (cell == text)
+        {
+          return;
+        }
+
+        cell.assign(text.data(), text.size());
+
+        pGrid->SetCellValue(
+          row,
+          column,
+          wxString::FromAscii(text.data(), text.size()));
+
+        if (text.size() > mWidestValues[column])
+        {
+          mWidestValues[column] = text.size();
+
+          pGrid->AutoSizeColumn(column);
+        }
+      }
+
+    private:
+
+      FormatBuffer mBuffer;
+
+      std::vector<std::string> mCells;
+
+      std::vector<std::size_t> mWidestValues;
+  };
+}
@@ -0,0 +1,314 @@
+#include "FrameClock.hpp"
+
+#include <wx/module.h>
+#include <wx/timer.h>
+
+#include <algorithm>
+#include <cmath>
+
+using gs::FrameClock;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+class FrameClock::TickTimer : public wxTimer
+{
+  public:
+
+    explicit TickTimer(FrameClock& clock)
+      : wxTimer(),
+        mClock(clock)
+    {
+    }
+
+    void Notify() override
+    {
+      mClock.OnTick();
+    }
+
+  private:
+
+    FrameClock& mClock;
+};
+
+//------------------------------------------------------------------------------
+// The clock itself is a function local static, destroyed after wx has gone,
+// so its timer is let go here as the app exits.
+//------------------------------------------------------------------------------
+class FrameClockModule : public wxModule
+{
+  public:
+
+    bool OnInit() override
+    {
+      return true;
+    }
+
+    void OnExit() override
+    {
+      FrameClock::GetInstance().Shutdown();
+    }
+
+  private:
+
+    wxDECLARE_DYNAMIC_CLASS(FrameClockModule);
+};
+
+wxIMPLEMENT_DYNAMIC_CLASS(FrameClockModule, wxModule);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+FrameClock& FrameClock::GetInstance()
+{
+  static FrameClock frameClock;
+
+  return frameClock;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+FrameClock::FrameClock()
+  : mpTimer(),
+    mIsShutDown(false),
+    mInvalidations(),
+    mPainting(),
+    mTargetRate(60.0),
+    mRate(60.0),
+    mLastTickTime(),
+    mPaintTime(0),
+    mIsQualityReduced(false),
+    mTicksSinceAdapt(0),
+    mTickCount(0),
+    mInvalidationCount(0),
+    mRepaintCount(0)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+FrameClock::~FrameClock() = default;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void FrameClock::Invalidate(wxWindow* pWindow)
+{
+  DoInvalidate(pWindow, std::nullopt);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void FrameClock::Invalidate(wxWindow* pWindow, const wxRect& rect)
+{
+  if (!rect.IsEmpty())
+  {
+    DoInvalidate(pWindow, rect);
+  }
+}
+
+//------------------------------------------------------------------------------
+// A window invalidated again before the tick is painted once, for the union
+// of the rectangles.
+//------------------------------------------------------------------------------
+void FrameClock::DoInvalidate(
+  wxWindow* pWindow,
+  const std::optional<wxRect>& rect)
+{
+  ++mInvalidationCount;
+
+  for (auto& invalidation : mInvalidations)
+  {
+    if (invalidation.mpWindow.get() == pWindow)
+    {
+      if (!rect)
+      {
+        invalidation.mRect.reset();
+      }
+      else if (invalidation.mRect)
+      {
+        invalidation.mRect = invalidation.mRect->Union(*rect);
+      }
+      return;
+    }
+  }
+
+  mInvalidations.push_back({pWindow, rect});
+
+  StartTimer();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void FrameClock::SetTargetRate(double rate)
+{
+  mTargetRate = std::max(mMinRate, rate);
+
+  mRate = mTargetRate;
+
+  mTicksSinceAdapt = 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool FrameClock::IsQualityReduced() const
+{
+  return mIsQualityReduced;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::ScaleFilter FrameClock::GetScaleFilter(ScaleFilter filter) const
+{
+  return mIsQualityReduced ? ScaleFilter::Nearest : filter;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::FrameClockStatistics FrameClock::GetStatistics() const
+{
+  return {
+    mTargetRate,
+    mRate,
+    mPaintTime,
+    mIsQualityReduced,
+    mTickCount,
+    mInvalidationCount,
+    mRepaintCount};
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void FrameClock::Shutdown()
+{
+  mIsShutDown = true;
+
+  mpTimer.reset();
+
+  mInvalidations.clear();
+
+  mPainting.clear();
+}
+
+//------------------------------------------------------------------------------
+// One tick period after the last tick, or straight away if the clock has
+// been idle longer than that.
+//------------------------------------------------------------------------------
+void FrameClock::StartTimer()
+{
+  if (mIsShutDown)
+  {
+    return;
+  }
+
+  if (!mpTimer)
+  {
+    mpTimer = std::make_unique<TickTimer>(*this);
+  }
+
+  if (mpTimer->IsRunning())
+  {
+    return;
+  }
+
+  auto tickTime =
+    mLastTickTime +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1.0 / mRate));
+
+  auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+    tickTime - std::chrono::steady_clock::now());
+
+  mpTimer->StartOnce(std::max(1, static_cast<int>(delay.count())));
+}
+
+//------------------------------------------------------------------------------
+// Every window is invalidated first and then painted, so wx gets a chance to
+// merge them.  Windows invalidated while painting wait for the next tick.
+// The whole tick counts as painting, invalidating included, as some ports
+// do part of the work there rather than in Update.
+//------------------------------------------------------------------------------
+void FrameClock::OnTick()
+{
+  mLastTickTime = std::chrono::steady_clock::now();
+
+  ++mTickCount;
+
+  mPainting.swap(mInvalidations);
+
+  for (auto& invalidation : mPainting)
+  {
+    auto pWindow = invalidation.mpWindow.get();
+
+    if (!pWindow || pWindow->IsBeingDeleted())
+    {
+      invalidation.mpWindow = nullptr;
+    }
+    else if (invalidation.mRect)
+    {
+      pWindow->RefreshRect(*invalidation.mRect, false);
+    }
+    else
+    {
+      pWindow->Refresh(false);
+    }
+  }
+
+  for (auto& invalidation : mPainting)
+  {
+    if (auto pWindow = invalidation.mpWindow.get())
+    {
+      pWindow->Update();
+
+      ++mRepaintCount;
+    }
+  }
+
+  Adapt(std::chrono::steady_clock::now() - mLastTickTime);
+
+  mPainting.clear();
+
+  if (!mInvalidations.empty())
+  {
+    StartTimer();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Over budget: reduce quality, and if that wasn't enough slow down so a tick
+// spends at most 80% of its period painting.  Well under budget: speed back
+// up, and once back at the target rate restore quality.
+//------------------------------------------------------------------------------
+void FrameClock::Adapt(std::chrono::nanoseconds paintTime)
+{
+  mPaintTime = (mPaintTime * 7 + paintTime) / 8;
+
+  if (++mTicksSinceAdapt < mAdaptPeriod)
+  {
+    return;
+  }
+
+  mTicksSinceAdapt = 0;
+
+  auto paintSeconds = std::chrono::duration<double>(mPaintTime).count();
+
+  if (paintSeconds > 1.0 / mRate)
+  {
+    if (!mIsQualityReduced)
+    {
+      mIsQualityReduced = true;
+    }
+    else
+    {
+      mRate = std::max(mMinRate, 0.8 / paintSeconds);
+    }
+  }
+  else if (paintSeconds < 0.5 / mRate)
+  {
+    if (mRate < mTargetRate)
+    {
+      mRate = std::min(mTargetRate, mRate * 1.5);
+    }
+    else
+    {
+      mIsQualityReduced = false;
+    }
+  }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <GuiStuff/ImageScaler.hpp>
+
+#include <wx/gdicmn.h>
+#include <wx/weakref.h>
+#include <wx/window.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct FrameClockStatistics
+  {
+    double mTargetRate;
+
+    // below mTargetRate while painting is over budget
+    double mRate;
+
+    // smoothed time a tick takes, invalidating and painting
+    std::chrono::nanoseconds mPaintTime;
+
+    bool mIsQualityReduced;
+
+    uint64_t mTickCount;
+
+    uint64_t mInvalidationCount;
+
+    uint64_t mRepaintCount;
+  };
+
+  //----------------------------------------------------------------------------
+  // Collects the repaints the GuiStuff widgets ask for and does them together
+  // on the next tick, so a window is painted at most once a tick however
+  // often its contents change.  Ticks are timed: while painting takes longer
+  // than a tick the widgets are first asked to scale at reduced quality,
+  // then the rate drops until painting fits, and both recover once painting
+  // takes under half a tick again.  The clock only ticks while something is
+  // waiting to be painted.  Gui thread only.
+  //----------------------------------------------------------------------------
+  class FrameClock
+  {
+    public:
+
+      static FrameClock& GetInstance();
+
+      ~FrameClock();
+
+      FrameClock(const FrameClock&) = delete;
+
+      FrameClock& operator = (const FrameClock&) = delete;
+
+      // Repaints all of pWindow on the next tick.
+      void Invalidate(wxWindow* pWindow);
+
+      // Repaints Rect of pWindow on the next tick, nothing if it is empty.
+      void Invalidate(wxWindow* pWindow, const wxRect& Rect);
+
+      // In ticks a second, 60 by default.
+      void SetTargetRate(double Rate);
+
+      bool IsQualityReduced() const;
+
+      // Filter, or the cheapest one while quality is reduced.
+      ScaleFilter GetScaleFilter(ScaleFilter Filter) const;
+
+      FrameClockStatistics GetStatistics() const;
+
+      // Stops ticking for good and lets the timer go while wx is still up,
+      // done by a wxModule as the app exits.  Invalidations after that are
+      // ignored.
+      void Shutdown();
+
+    private:
+
+      class TickTimer;
+
+      struct Invalidation
+      {
+        wxWeakRef<wxWindow> mpWindow;
+
+        // all of the window when empty
+        std::optional<wxRect> mRect;
+      };
+
+      FrameClock();
+
+      void DoInvalidate(wxWindow* pWindow, const std::optional<wxRect>& Rect);
+
+      void StartTimer();
+
+      void OnTick();
+
+      void Adapt(std::chrono::nanoseconds PaintTime);
+
+    private:
+
+      // made on first use, so there is an app to own it by then
+      std::unique_ptr<TickTimer> mpTimer;
+
+      bool mIsShutDown;
+
+      std::vector<Invalidation> mInvalidations;
+
+      // the invalidations being painted, kept to reuse its storage
+      std::vector<Invalidation> mPainting;
+
+      double mTargetRate;
+
+      double mRate;
+
+      std::chrono::steady_clock::time_point mLastTickTime;
+
+      std::chrono::nanoseconds mPaintTime;
+
+      bool mIsQualityReduced;
+
+      unsigned mTicksSinceAdapt;
+
+      uint64_t mTickCount;
+
+      uint64_t mInvalidationCount;
+
+      uint64_t mRepaintCount;
+
+      // ticks between changes of rate or quality
+      static constexpr unsigned mAdaptPeriod = 30;
+
+      static constexpr double mMinRate = 5.0;
+  };
+}
@@ -0,0 +1,64 @@
+#include "FrameFeed.hpp"
+
+#include <wx/rawbmp.h>
+
+#include <algorithm>
+
+using gs::FrameFeed;
+using gs::ScaleJob;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool FrameFeed::TakeNewest()
+{
+  if (auto pFrame = mFrames.Take())
+  {
+    mpImage = pFrame->mpImage;
+
+    mpPyramid.reset();
+
+    if (mpImage)
+    {
+      mpPyramid = std::make_shared<ImagePyramid>(
+        gs::ImageView {
+          reinterpret_cast<const uint8_t*>(mpImage->GetData().get()),
+          mpImage->GetWidth(),
+          mpImage->GetHeight(),
+          std::size_t(mpImage->GetWidth()) * GetBytesPerPixel(pFrame->mFormat),
+          pFrame->mFormat},
+        mpImage);
+    }
+    return true;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::shared_ptr<wxBitmap> ScaleJob::GetBitmap(const wxSize& size)
+{
+  auto pBitmap = std::move(mpSpareBitmap);
+
+  if (!pBitmap || pBitmap->GetSize() != size)
+  {
+    pBitmap = std::make_shared<wxBitmap>(
+      size.GetWidth(),
+      size.GetHeight(),
+      wxNativePixelFormat::BitsPerPixel);
+  }
+  return pBitmap;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void ScaleJob::Scale(
+  ImagePyramid& pyramid,
+  wxBitmap& bitmap,
+  ScaleFilter filter,
+  const ScaleMapping& mapping)
+{
+  pyramid.Build(
+    pyramid.GetLevelFor(std::min(mapping.mStepX, mapping.mStepY)) + 1);
+
+  pyramid.Scale(bitmap, filter, mapping);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <GuiStuff/Helpers.hpp>
+#include <GuiStuff/ImagePyramid.hpp>
+#include <GuiStuff/ImageScaler.hpp>
+#include <GuiStuff/LatestValue.hpp>
+
+#include <DanLib/Images/Image.hpp>
+
+#include <wx/bitmap.h>
+#include <wx/gdicmn.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct PublishedFrame
+  {
+    std::shared_ptr<const dl::image::Image> mpImage;
+
+    PixelFormat mFormat;
+  };
+
+  //----------------------------------------------------------------------------
+  // One stream of frames shown by a widget.  Producers publish into mFrames
+  // without waiting, the gui thread takes the newest frame into mpImage.  A
+  // frame stays in mFrames until the widget is free to scale it, so a burst
+  // of frames costs one wakeup and one rescale of the last one.  Everything
+  // from mpImage on is gui thread only.
+  //----------------------------------------------------------------------------
+  struct FrameFeed
+  {
+    //--------------------------------------------------------------------------
+    // Any thread, never waits on the gui thread.  onArrived runs on the gui
+    // thread once for every frame published before it gets to run, unless
+    // pLifetime has gone by then.
+    //--------------------------------------------------------------------------
+    template <typename Function>
+    void Publish(
+      const std::shared_ptr<const dl::image::Image>& pImage,
+      const PixelFormat& format,
+      const std::shared_ptr<void>& pLifetime,
+      Function onArrived)
+    {
+      mFrames.Set({pImage, format});
+
+      ++mPublishedCount;
+
+      if (mIsWakeupPending.exchange(true))
+      {
+        return;
+      }
+
+      std::weak_ptr<void> pWeakLifetime = pLifetime;
+
+      gs::DoOnGuiThread(
+        [this, pWeakLifetime, onArrived = std::move(onArrived)]
+        {
+          if (!pWeakLifetime.expired())
+          {
+            mIsWakeupPending = false;
+
+            onArrived();
+          }
+        });
+    }
+
+    // Gui thread.  Moves the newest frame published since the last call into
+    // mpImage with a fresh pyramid, false if there was none.
+    bool TakeNewest();
+
+    LatestValue<PublishedFrame> mFrames;
+
+    std::atomic<bool> mIsWakeupPending = false;
+
+    std::atomic<uint64_t> mPublishedCount = 0;
+
+    std::atomic<uint64_t> mDisplayedCount = 0;
+
+    std::shared_ptr<const dl::image::Image> mpImage;
+
+    // built level by level by whichever job first needs a coarser one
+    std::shared_ptr<ImagePyramid> mpPyramid;
+  };
+
+  //----------------------------------------------------------------------------
+  // Gui thread only.  At most one scaling job per bitmap is in flight,
+  // requests made meanwhile are folded into one follow up job.  The bitmap
+  // replaced by the last result is kept for the next job to draw into,
+  // workers only ever write the pixels of a bitmap they were given.
+  //----------------------------------------------------------------------------
+  struct ScaleJob
+  {
+    // Gui thread.  The spare bitmap when it is the right size.
+    std::shared_ptr<wxBitmap> GetBitmap(const wxSize& Size);
+
+    // Worker thread.  Builds whatever pyramid levels Mapping wants first, so
+    // a small bitmap is scaled from a level near its own size.
+    static void Scale(
+      ImagePyramid& Pyramid,
+      wxBitmap& Bitmap,
+      ScaleFilter Filter,
+      const ScaleMapping& Mapping);
+
+    bool mIsRunning = false;
+
+    bool mIsStale = false;
+
+    std::shared_ptr<wxBitmap> mpSpareBitmap;
+  };
+}
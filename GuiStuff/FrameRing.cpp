@@ -0,0 +1,798 @@
+#include "FrameRing.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+using gs::FrameRingFeed;
+using gs::FrameRingReader;
+using gs::FrameRingWriter;
+using gs::PixelEncoding;
+using gs::PixelFormat;
+
+//------------------------------------------------------------------------------
+// A POSIX shared memory object mapped read/write.
+//------------------------------------------------------------------------------
+class gs::SharedMemory
+{
+  public:
+
+    // Creates Name, which must not exist, Size bytes long.
+    SharedMemory(const std::string& Name, std::size_t Size);
+
+    // Opens an existing Name.
+    explicit SharedMemory(const std::string& Name);
+
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+
+    SharedMemory& operator = (const SharedMemory&) = delete;
+
+    std::byte* GetData() const
+    {
+      return mpData;
+    }
+
+    std::size_t GetSize() const
+    {
+      return mSize;
+    }
+
+  private:
+
+    void Map(int FileDescriptor);
+
+  private:
+
+    std::string mName;
+
+    std::byte* mpData;
+
+    std::size_t mSize;
+};
+
+namespace
+{
+  constexpr char cMagic[8] = {'G', 'S', 'R', 'I', 'N', 'G', '0', '1'};
+
+  constexpr std::size_t cPageSize = 4096;
+
+  // mLatest keeps the slot in its low byte
+  constexpr std::size_t cMaxSlotCount = 255;
+
+  constexpr uint64_t cSlotMask = 0xff;
+
+  //----------------------------------------------------------------------------
+  // At the start of the object, followed by a SlotHeader per slot and then,
+  // from the next page on, the slots' pixels.
+  //----------------------------------------------------------------------------
+  struct RingHeader
+  {
+    char mMagic[8];
+
+    uint64_t mSlotCount;
+
+    uint64_t mSlotBytes;
+
+    // frame number << 8 | slot of the newest frame, 0 before the first
+    std::atomic<uint64_t> mLatest;
+
+    // bumped by every publish, the futex readers wait on
+    std::atomic<uint32_t> mSignal;
+  };
+
+  //----------------------------------------------------------------------------
+  // mSequence is twice the number of the frame in the slot and odd while the
+  // producer writes it.  The producer marks a slot odd before checking
+  // mHoldCount and a reader counts itself in mHoldCount before checking
+  // mSequence, both sequentially consistent, so of a producer claiming a
+  // slot and a reader taking it at least one sees the other and backs off.
+  //----------------------------------------------------------------------------
+  struct SlotHeader
+  {
+    std::atomic<uint64_t> mSequence;
+
+    std::atomic<uint32_t> mHoldCount;
+
+    uint32_t mWidth;
+
+    uint32_t mHeight;
+
+    uint32_t mEncoding;
+
+    uint32_t mSignificantBits;
+  };
+
+  static_assert(
+    std::atomic<uint64_t>::is_always_lock_free &&
+    std::atomic<uint32_t>::is_always_lock_free,
+    "frame ring atomics must work across processes");
+
+  //----------------------------------------------------------------------------
+  // Whether a frame a slot header describes fits in a slot, nothing the
+  // producer wrote is trusted.
+  //----------------------------------------------------------------------------
+  bool IsFrameValid(
+    uint32_t width,
+    uint32_t height,
+    uint32_t encoding,
+    uint64_t slotBytes)
+  {
+    if (encoding > static_cast<uint32_t>(gs::PixelEncoding::BayerRg8))
+    {
+      return false;
+    }
+
+    gs::PixelFormat format;
+
+    format.mEncoding = static_cast<gs::PixelEncoding>(encoding);
+
+    return
+      uint64_t(width) * height <= slotBytes / gs::GetBytesPerPixel(format);
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  [[noreturn]] void ThrowSystemError(const std::string& What)
+  {
+    throw std::system_error(errno, std::generic_category(), What);
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  std::size_t AlignToPage(std::size_t size)
+  {
+    return (size + cPageSize - 1) / cPageSize * cPageSize;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  std::size_t GetHeaderBytes(std::size_t slotCount)
+  {
+    return AlignToPage(sizeof(RingHeader) + slotCount * sizeof(SlotHeader));
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  RingHeader& GetHeader(const gs::SharedMemory& memory)
+  {
+    return *reinterpret_cast<RingHeader*>(memory.GetData());
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  SlotHeader& GetSlotHeader(const gs::SharedMemory& memory, std::size_t slot)
+  {
+    auto pSlots =
+      reinterpret_cast<SlotHeader*>(memory.GetData() + sizeof(RingHeader));
+
+    return pSlots[slot];
+  }
+
+  //----------------------------------------------------------------------------
+  // Takes the ring's layout from the caller's own copy, never from the header
+  // the other end could rewrite.
+  //----------------------------------------------------------------------------
+  uint8_t* GetSlotData(
+    const gs::SharedMemory& memory,
+    std::size_t slotCount,
+    std::size_t slotBytes,
+    std::size_t slot)
+  {
+    return
+      reinterpret_cast<uint8_t*>(memory.GetData()) +
+      GetHeaderBytes(slotCount) + slot * slotBytes;
+  }
+
+  //----------------------------------------------------------------------------
+  // Sleeps until Signal no longer holds Value, Timeout passes or a spurious
+  // wakeup.  Without futexes it just naps.
+  //----------------------------------------------------------------------------
+  void WaitOnSignal(
+    std::atomic<uint32_t>& signal,
+    uint32_t value,
+    std::chrono::milliseconds timeout)
+  {
+#ifdef __linux__
+    timespec time;
+
+    time.tv_sec = timeout.count() / 1000;
+
+    time.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+    syscall(
+      SYS_futex,
+      reinterpret_cast<uint32_t*>(&signal),
+      FUTEX_WAIT,
+      value,
+      &time,
+      nullptr,
+      0);
+#else
+    std::this_thread::sleep_for(
+      std::min(timeout, std::chrono::milliseconds(1)));
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  // Wakes every waiter in every process.
+  //----------------------------------------------------------------------------
+  void WakeSignal(std::atomic<uint32_t>& signal)
+  {
+#ifdef __linux__
+    syscall(
+      SYS_futex,
+      reinterpret_cast<uint32_t*>(&signal),
+      FUTEX_WAKE,
+      INT_MAX,
+      nullptr,
+      nullptr,
+      0);
+#else
+    (void)signal;
+#endif
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::SharedMemory::SharedMemory(const std::string& name, std::size_t size)
+  : mName(name),
+    mpData(nullptr),
+    mSize(size)
+{
+  auto fileDescriptor =
+    shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+  if (fileDescriptor < 0)
+  {
+    ThrowSystemError("unable to create " + name);
+  }
+
+  if (ftruncate(fileDescriptor, size) != 0)
+  {
+    close(fileDescriptor);
+
+    shm_unlink(name.c_str());
+
+    ThrowSystemError("unable to resize " + name);
+  }
+
+  try
+  {
+    Map(fileDescriptor);
+  }
+  catch (...)
+  {
+    shm_unlink(name.c_str());
+
+    throw;
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::SharedMemory::SharedMemory(const std::string& name)
+  : mName(name),
+    mpData(nullptr),
+    mSize(0)
+{
+  auto fileDescriptor = shm_open(name.c_str(), O_RDWR, 0);
+
+  if (fileDescriptor < 0)
+  {
+    ThrowSystemError("unable to open " + name);
+  }
+
+  struct stat status;
+
+  if (fstat(fileDescriptor, &status) != 0)
+  {
+    close(fileDescriptor);
+
+    ThrowSystemError("unable to stat " + name);
+  }
+
+  mSize = status.st_size;
+
+  Map(fileDescriptor);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::SharedMemory::~SharedMemory()
+{
+  if (mpData)
+  {
+    munmap(mpData, mSize);
+  }
+}
+
+//------------------------------------------------------------------------------
+// The mapping outlives the descriptor.
+//------------------------------------------------------------------------------
+void gs::SharedMemory::Map(int fileDescriptor)
+{
+  if (mSize == 0)
+  {
+    close(fileDescriptor);
+
+    return;
+  }
+
+  auto pData = mmap(
+    nullptr,
+    mSize,
+    PROT_READ | PROT_WRITE,
+    MAP_SHARED,
+    fileDescriptor,
+    0);
+
+  close(fileDescriptor);
+
+  if (pData == MAP_FAILED)
+  {
+    ThrowSystemError("unable to map " + mName);
+  }
+
+  mpData = static_cast<std::byte*>(pData);
+}
+
+//------------------------------------------------------------------------------
+// The magic goes in last so a reader opening the ring part way through
+// setting up turns it down.
+//------------------------------------------------------------------------------
+FrameRingWriter::FrameRingWriter(
+  const std::string& name,
+  std::size_t slotCount,
+  std::size_t maxFrameBytes)
+  : mName(name),
+    mpMemory(),
+    mSlotCount(slotCount),
+    mSlotBytes(AlignToPage(maxFrameBytes)),
+    mSlot(0),
+    mNextSlot(0),
+    mIsWriting(false),
+    mPublishedCount(0),
+    mDroppedCount(0)
+{
+  if (slotCount < 2 || slotCount > cMaxSlotCount || maxFrameBytes == 0)
+  {
+    throw std::invalid_argument("bad frame ring size for " + name);
+  }
+
+  shm_unlink(name.c_str());
+
+  mpMemory = std::make_unique<SharedMemory>(
+    name,
+    GetHeaderBytes(slotCount) + slotCount * mSlotBytes);
+
+  auto pHeader = new (mpMemory->GetData()) RingHeader();
+
+  pHeader->mSlotCount = slotCount;
+
+  pHeader->mSlotBytes = mSlotBytes;
+
+  for (std::size_t slot = 0; slot < slotCount; ++slot)
+  {
+    new (&GetSlotHeader(*mpMemory, slot)) SlotHeader();
+  }
+
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::memcpy(pHeader->mMagic, cMagic, sizeof(cMagic));
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+FrameRingWriter::~FrameRingWriter()
+{
+  shm_unlink(mName.c_str());
+}
+
+//------------------------------------------------------------------------------
+// Never takes the newest frame's slot, a reader may be on its way to it.
+//------------------------------------------------------------------------------
+uint8_t* FrameRingWriter::BeginFrame()
+{
+  if (mIsWriting)
+  {
+    return GetSlotData(*mpMemory, mSlotCount, mSlotBytes, mSlot);
+  }
+
+  auto& header = GetHeader(*mpMemory);
+
+  auto latest = header.mLatest.load(std::memory_order_relaxed);
+
+  for (std::size_t i = 0; i < mSlotCount; ++i)
+  {
+    auto slot = (mNextSlot + i) % mSlotCount;
+
+    if (latest != 0 && slot == (latest & cSlotMask))
+    {
+      continue;
+    }
+
+    auto& slotHeader = GetSlotHeader(*mpMemory, slot);
+
+    auto sequence = slotHeader.mSequence.load(std::memory_order_relaxed);
+
+    slotHeader.mSequence.store(sequence | 1);
+
+    if (slotHeader.mHoldCount.load() == 0)
+    {
+      mSlot = slot;
+
+      mNextSlot = slot + 1;
+
+      mIsWriting = true;
+
+      return GetSlotData(*mpMemory, mSlotCount, mSlotBytes, slot);
+    }
+
+    slotHeader.mSequence.store(sequence);
+  }
+
+  ++mDroppedCount;
+
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void FrameRingWriter::EndFrame(
+  unsigned width,
+  unsigned height,
+  const PixelFormat& format)
+{
+  if (!mIsWriting)
+  {
+    return;
+  }
+
+  auto& header = GetHeader(*mpMemory);
+
+  auto size = std::size_t(width) * height * GetBytesPerPixel(format);
+
+  if (size > mSlotBytes)
+  {
+    throw std::invalid_argument("frame too big for " + mName);
+  }
+
+  auto& slotHeader = GetSlotHeader(*mpMemory, mSlot);
+
+  slotHeader.mWidth = width;
+
+  slotHeader.mHeight = height;
+
+  slotHeader.mEncoding = static_cast<uint32_t>(format.mEncoding);
+
+  slotHeader.mSignificantBits = format.mSignificantBits;
+
+  auto number = ++mPublishedCount;
+
+  slotHeader.mSequence.store(number * 2, std::memory_order_release);
+
+  header.mLatest.store(number << 8 | mSlot, std::memory_order_release);
+
+  header.mSignal.fetch_add(1, std::memory_order_release);
+
+  WakeSignal(header.mSignal);
+
+  mIsWriting = false;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool FrameRingWriter::Write(
+  const uint8_t* pPixels,
+  unsigned width,
+  unsigned height,
+  const PixelFormat& format)
+{
+  auto size = std::size_t(width) * height * GetBytesPerPixel(format);
+
+  if (size > mSlotBytes)
+  {
+    throw std::invalid_argument("frame too big for " + mName);
+  }
+
+  auto pSlot = BeginFrame();
+
+  if (!pSlot)
+  {
+    return false;
+  }
+
+  std::memcpy(pSlot, pPixels, size);
+
+  EndFrame(width, height, format);
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t FrameRingWriter::GetPublishedCount() const
+{
+  return mPublishedCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t FrameRingWriter::GetDroppedCount() const
+{
+  return mDroppedCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+FrameRingReader::FrameRingReader(const std::string& name)
+  : mpMemory(std::make_shared<SharedMemory>(name)),
+    mSlotCount(0),
+    mSlotBytes(0),
+    mSlots(),
+    mLastNumber(0),
+    mIsInterrupted(false)
+{
+  if (
+    mpMemory->GetSize() < GetHeaderBytes(0) ||
+    std::memcmp(GetHeader(*mpMemory).mMagic, cMagic, sizeof(cMagic)) != 0)
+  {
+    throw std::runtime_error(name + " is not a frame ring");
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  // copied once, as the producer could change them after they are checked
+  const auto& header = GetHeader(*mpMemory);
+
+  mSlotCount = header.mSlotCount;
+
+  mSlotBytes = header.mSlotBytes;
+
+  if (
+    mSlotCount > cMaxSlotCount ||
+    mSlotBytes > mpMemory->GetSize() ||
+    mpMemory->GetSize() < GetHeaderBytes(mSlotCount) + mSlotCount * mSlotBytes)
+  {
+    throw std::runtime_error(name + " is not a frame ring");
+  }
+
+  mSlots.resize(mSlotCount);
+
+  for (auto& slot : mSlots)
+  {
+    slot.mpIsHeld = std::make_shared<std::atomic<bool>>(false);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Slots whose frames are still in use are let go by the images' deleters.
+//------------------------------------------------------------------------------
+FrameRingReader::~FrameRingReader() = default;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::optional<FrameRingReader::Frame> FrameRingReader::WaitForFrame(
+  std::chrono::milliseconds timeout)
+{
+  using Clock = std::chrono::steady_clock;
+
+  DoReleaseUnusedSlots();
+
+  auto& header = GetHeader(*mpMemory);
+
+  auto deadline = Clock::now() + timeout;
+
+  while (true)
+  {
+    auto signal = header.mSignal.load(std::memory_order_acquire);
+
+    if (auto frame = DoTakeLatest())
+    {
+      return frame;
+    }
+
+    auto now = Clock::now();
+
+    if (mIsInterrupted.exchange(false) || now >= deadline)
+    {
+      return std::nullopt;
+    }
+
+    WaitOnSignal(
+      header.mSignal,
+      signal,
+      std::chrono::ceil<std::chrono::milliseconds>(deadline - now));
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void FrameRingReader::Interrupt()
+{
+  mIsInterrupted = true;
+
+  auto& header = GetHeader(*mpMemory);
+
+  // a reader past its check of mIsInterrupted then finds the signal moved on
+  // rather than sleeping out its timeout
+  header.mSignal.fetch_add(1, std::memory_order_release);
+
+  WakeSignal(header.mSignal);
+}
+
+//------------------------------------------------------------------------------
+// Only this thread copies the slots' images, so one no one else holds stays
+// that way and its slot can go back to the producer.
+//------------------------------------------------------------------------------
+void FrameRingReader::DoReleaseUnusedSlots()
+{
+  for (std::size_t i = 0; i < mSlots.size(); ++i)
+  {
+    auto& slot = mSlots[i];
+
+    if (slot.mpImage.use_count() == 1 && slot.mpIsHeld->exchange(false))
+    {
+      GetSlotHeader(*mpMemory, i).mHoldCount.fetch_sub(
+        1,
+        std::memory_order_release);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Retries when the producer reclaims the slot between reading mLatest and
+// holding it, which needs it to have published twice meanwhile.  A frame in
+// a slot the ring doesn't have, in an unknown encoding or bigger than a
+// slot is skipped.
+//------------------------------------------------------------------------------
+std::optional<FrameRingReader::Frame> FrameRingReader::DoTakeLatest()
+{
+  auto& header = GetHeader(*mpMemory);
+
+  while (true)
+  {
+    auto latest = header.mLatest.load(std::memory_order_acquire);
+
+    auto number = latest >> 8;
+
+    if (number <= mLastNumber)
+    {
+      return std::nullopt;
+    }
+
+    auto index = static_cast<std::size_t>(latest & cSlotMask);
+
+    if (index >= mSlots.size())
+    {
+      mLastNumber = number;
+
+      return std::nullopt;
+    }
+
+    auto& slot = mSlots[index];
+
+    auto& slotHeader = GetSlotHeader(*mpMemory, index);
+
+    auto isHeld = slot.mpIsHeld->load();
+
+    if (!isHeld)
+    {
+      slotHeader.mHoldCount.fetch_add(1);
+
+      if (slotHeader.mSequence.load() != number * 2)
+      {
+        slotHeader.mHoldCount.fetch_sub(1);
+
+        continue;
+      }
+    }
+
+    // read once, what is checked is what gets used
+    unsigned width = slotHeader.mWidth;
+
+    unsigned height = slotHeader.mHeight;
+
+    PixelFormat format;
+
+    auto encoding = slotHeader.mEncoding;
+
+    format.mSignificantBits = slotHeader.mSignificantBits;
+
+    if (!IsFrameValid(width, height, encoding, mSlotBytes))
+    {
+      if (!isHeld)
+      {
+        slotHeader.mHoldCount.fetch_sub(1, std::memory_order_release);
+      }
+
+      mLastNumber = number;
+
+      return std::nullopt;
+    }
+
+    format.mEncoding = static_cast<PixelEncoding>(encoding);
+
+    // a new image only when the size changes, before marking the slot held
+    // so the replaced image's deleter leaves it alone
+    if (
+      !slot.mpImage ||
+      slot.mpImage->GetWidth() != width ||
+      slot.mpImage->GetHeight() != height)
+    {
+      auto pData = reinterpret_cast<std::byte*>(
+        GetSlotData(*mpMemory, mSlotCount, mSlotBytes, index));
+
+      slot.mpImage = std::shared_ptr<const dl::image::Image>(
+        new dl::image::Image(
+          width,
+          height,
+          std::experimental::make_observer(pData)),
+        [pMemory = mpMemory, pIsHeld = slot.mpIsHeld, index] (
+          const dl::image::Image* pImage)
+        {
+          if (pIsHeld->exchange(false))
+          {
+            GetSlotHeader(*pMemory, index).mHoldCount.fetch_sub(
+              1,
+              std::memory_order_release);
+          }
+
+          delete pImage;
+        });
+    }
+
+    slot.mpIsHeld->store(true);
+
+    mLastNumber = number;
+
+    return Frame {slot.mpImage, format, number};
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+FrameRingFeed::FrameRingFeed(const std::string& name, FrameFunction onFrame)
+  : mReader(name),
+    mIsStopping(false),
+    mThread()
+{
+  mThread = std::thread([this, onFrame = std::move(onFrame)]
+  {
+    while (!mIsStopping)
+    {
+      if (auto frame = mReader.WaitForFrame(std::chrono::milliseconds(250)))
+      {
+        onFrame(*frame);
+      }
+    }
+  });
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+FrameRingFeed::~FrameRingFeed()
+{
+  mIsStopping = true;
+
+  mReader.Interrupt();
+
+  mThread.join();
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <GuiStuff/ImageScaler.hpp>
+
+#include <DanLib/Images/Image.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  class SharedMemory;
+
+  //----------------------------------------------------------------------------
+  // The producer end of a ring of frames in POSIX shared memory, so a
+  // capture process can hand frames to a viewer process without copying
+  // them.  Frames are written straight into a free slot, slots a reader
+  // still holds are skipped and when every slot is held the frame is
+  // dropped, the producer never waits on a reader.
+  //----------------------------------------------------------------------------
+  class FrameRingWriter
+  {
+    public:
+
+      // Creates shared memory object Name (a leading '/' and no others),
+      // replacing any left behind by an earlier producer.
+      FrameRingWriter(
+        const std::string& Name,
+        std::size_t SlotCount,
+        std::size_t MaxFrameBytes);
+
+      // Unlinks the object, attached readers keep their mapping.
+      ~FrameRingWriter();
+
+      FrameRingWriter(const FrameRingWriter&) = delete;
+
+      FrameRingWriter& operator = (const FrameRingWriter&) = delete;
+
+      // Claims a slot of MaxFrameBytes to write the next frame into, nullptr
+      // if readers hold them all.
+      uint8_t* BeginFrame();
+
+      // Publishes the slot claimed by BeginFrame and wakes the readers.
+      void EndFrame(unsigned Width, unsigned Height, const PixelFormat& Format);
+
+      // Copies a frame in, returns false if it was dropped.
+      bool Write(
+        const uint8_t* pPixels,
+        unsigned Width,
+        unsigned Height,
+        const PixelFormat& Format);
+
+      uint64_t GetPublishedCount() const;
+
+      uint64_t GetDroppedCount() const;
+
+    private:
+
+      std::string mName;
+
+      std::unique_ptr<SharedMemory> mpMemory;
+
+      // the layout the ring was made with, whatever is in its header since
+      std::size_t mSlotCount;
+
+      std::size_t mSlotBytes;
+
+      std::size_t mSlot;
+
+      std::size_t mNextSlot;
+
+      bool mIsWriting;
+
+      uint64_t mPublishedCount;
+
+      uint64_t mDroppedCount;
+  };
+
+  //----------------------------------------------------------------------------
+  // The viewer end.  Frames are handed out as images whose pixels are still
+  // in the ring, the slot stays held (and is skipped by the producer) until
+  // the image and every copy of it are released.  A reader of a producer
+  // that has restarted has to be opened again.
+  //----------------------------------------------------------------------------
+  class FrameRingReader
+  {
+    public:
+
+      struct Frame
+      {
+        std::shared_ptr<const dl::image::Image> mpImage;
+
+        PixelFormat mFormat;
+
+        uint64_t mNumber;
+      };
+
+      explicit FrameRingReader(const std::string& Name);
+
+      ~FrameRingReader();
+
+      FrameRingReader(const FrameRingReader&) = delete;
+
+      FrameRingReader& operator = (const FrameRingReader&) = delete;
+
+      // Waits up to Timeout for a frame newer than the last one returned.
+      // Only ever called from one thread at a time.
+      std::optional<Frame> WaitForFrame(std::chrono::milliseconds Timeout);
+
+      // Makes a WaitForFrame in progress on another thread return early.
+      void Interrupt();
+
+    private:
+
+      //------------------------------------------------------------------------
+      // The image handed out for a slot is made once and reused while its
+      // size stays the same.  Its deleter shares mpIsHeld, so a slot still
+      // in use when the reader goes away is let go by whoever releases it
+      // last.
+      //------------------------------------------------------------------------
+      struct Slot
+      {
+        std::shared_ptr<const dl::image::Image> mpImage;
+
+        std::shared_ptr<std::atomic<bool>> mpIsHeld;
+      };
+
+      std::optional<Frame> DoTakeLatest();
+
+      void DoReleaseUnusedSlots();
+
+    private:
+
+      std::shared_ptr<SharedMemory> mpMemory;
+
+      // the layout checked on opening, whatever is in the header since
+      std::size_t mSlotCount;
+
+      std::size_t mSlotBytes;
+
+      std::vector<Slot> mSlots;
+
+      uint64_t mLastNumber;
+
+      std::atomic<bool> mIsInterrupted;
+  };
+
+  //----------------------------------------------------------------------------
+  // A reader on a thread of its own passing every frame to OnFrame, until it
+  // is destroyed.
+  //----------------------------------------------------------------------------
+  class FrameRingFeed
+  {
+    public:
+
+      using FrameFunction = std::function<void(const FrameRingReader::Frame&)>;
+
+      // Throws if there is no ring Name.
+      FrameRingFeed(const std::string& Name, FrameFunction OnFrame);
+
+      ~FrameRingFeed();
+
+      FrameRingFeed(const FrameRingFeed&) = delete;
+
+      FrameRingFeed& operator = (const FrameRingFeed&) = delete;
+
+    private:
+
+      FrameRingReader mReader;
+
+      std::atomic<bool> mIsStopping;
+
+      std::thread mThread;
+  };
+}
@@ -1,121 +1,183 @@
 #pragma once
 
 #include <TypeTraits/TypeTraits.hpp>
+#include <GuiStuff/CellFormatter.hpp>
+#include <GuiStuff/FrameClock.hpp>
 #include <GuiStuff/Helpers.hpp>
+#include <GuiStuff/LatestValue.hpp>
+#include <GuiStuff/PacketGridTable.hpp>
+#include <GuiStuff/PacketRecorder.hpp>
+#include <GuiStuff/PacketSchema.hpp>
+#include <GuiStuff/Sparkline.hpp>
+#include <GuiStuff/UpdateStatistics.hpp>
 #include <wx/dataview.h>
 #include <wx/grid.h>
 #include <wx/frame.h>
 #include <wx/notebook.h>
 #include <wx/listctrl.h>
 #include <wx/sizer.h>
+#include <wx/stattext.h>
+#include <wx/timer.h>
 
 #include <boost/hana.hpp>
-#include <boost/type_index.hpp>
+#include <chrono>
+#include <cmath>
+#include <memory>
 #include <type_traits>
 #include <iostream>
 #include <locale>
+#include <thread>
 
 class wxWindow;
 
 namespace gs
 {
+  //----------------------------------------------------------------------------
+  // Immediate posts every Set to the gui thread.  Coalesced keeps only the
+  // latest packet of each type and displays it on the next refresh tick.
+  //----------------------------------------------------------------------------
+  enum class UpdatePolicy
+  {
+    Immediate,
+    Coalesced
+  };
+
+  //----------------------------------------------------------------------------
+  // Cells copies every value into the wxGrid as a string.  Packet gives each
+  // grid a virtual table that formats visible cells straight from the last
+  // packet received.  History keeps the last mHistoryDepth packets of each
+  // type, one row per packet.
+  //----------------------------------------------------------------------------
+  enum class GridStorage
+  {
+    Cells,
+    Packet,
+    History
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct GridDisplayerOptions
+  {
+    UpdatePolicy mUpdatePolicy = UpdatePolicy::Immediate;
+
+    std::chrono::milliseconds mRefreshPeriod = std::chrono::milliseconds(33);
+
+    GridStorage mStorage = GridStorage::Cells;
+
+    std::size_t mHistoryDepth = 100000;
+
+    bool mShowStatistics = false;
+
+    std::chrono::milliseconds mStatisticsPeriod = std::chrono::seconds(1);
+
+    // Samples of every numeric field kept for its sparkline, 0 leaves
+    // sparklines off and Set doesn't sample at all.
+    std::size_t mSparklineDepth = 0;
+  };
+
   namespace
   {
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
-    void ConvertCamelCaseToSpaces(std::string& name)
+    template <typename PacketType>
+    void AddGridLabels(wxGrid* pGrid)
     {
-      for (size_t i = 1; i < name.size(); ++i)
+      const auto& labels = schema::FieldLabels<PacketType>;
+
+      pGrid->CreateGrid(1, labels.size());
+      for (auto i = 0u; i < labels.size(); ++i)
       {
-        if (std::isupper(name[i]) || std::isdigit(name[i]))
-        {
-          name.insert(i, 1, ' ');
-          ++i;
-        }
+        pGrid->SetColLabelValue(i, labels[i].c_str());
+        pGrid->AutoSizeColLabelSize(i);
       }
     }
 
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
-    void RemoveNamespace(std::string& name)
+    template <typename PacketType>
+    void AddGridValues(
+      wxGrid* pGrid,
+      GridCellCache& cellCache,
+      const PacketType& packet)
     {
-      auto iName = name.rfind("::");
-
-      if (iName != std::string::npos)
+      namespace hana = boost::hana;
+      hana::for_each(packet, [pGrid, &cellCache, i = 0] (auto pair) mutable
       {
-        name = name.substr(iName + 2);
-      }
-
-      ConvertCamelCaseToSpaces(name);
+        cellCache.Update(pGrid, 0, i++, hana::second(pair));
+      });
     }
 
     //--------------------------------------------------------------------------
+    // Fields that aren't numbers are sampled as NaN, which sparklines skip.
     //--------------------------------------------------------------------------
-    template <typename PacketType>
-    void AddGridLabels(wxGrid* pGrid, PacketType packet)
+    template <typename FieldType>
+    double ToSample(const FieldType& value)
     {
-      namespace hana = boost::hana;
-      std::vector<std::string> labels;
-      hana::for_each(packet, [&labels](auto pair)
+      if constexpr (std::is_arithmetic_v<FieldType>)
       {
-        labels.emplace_back(hana::to<const char*>(hana::first(pair)));
-      });
-
-      pGrid->CreateGrid(1, labels.size());
-      for (auto i = 0u; i < labels.size(); ++i)
+        return static_cast<double>(value);
+      }
+      else
       {
-        //remove 'm' prefix
-        if (labels[i][0] == 'm')
-        {
-          labels[i] = labels[i].substr(1);
-        }
-
-        ConvertCamelCaseToSpaces(labels[i]);
-        pGrid->SetColLabelValue(i, labels[i]);
-        pGrid->AutoSizeColLabelSize(i);
+        return std::nan("");
       }
     }
 
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
-    template <typename PacketType>
-    void AddGridValues(wxGrid* pGrid, PacketType packet)
+    template <typename PacketType, std::size_t ... FieldIndices>
+    std::array<double, sizeof...(FieldIndices)> MakeSamples(
+      const PacketType& packet,
+      std::index_sequence<FieldIndices...>)
     {
       namespace hana = boost::hana;
-      std::vector<std::string> labels;
-      hana::for_each(packet, [&labels, pGrid, i = 0] (auto pair) mutable
-      {
-        pGrid->SetCellValue(0, i++, std::to_string(hana::second(pair)));
-      });
 
-      pGrid->AutoSizeColumns();
+      constexpr auto accessors = hana::accessors<PacketType>();
+
+      return {
+        ToSample(hana::second(hana::at_c<FieldIndices>(accessors))(packet))...};
+    }
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    template <typename PacketType, std::size_t ... FieldIndices>
+    std::vector<bool> MakeNumericFields(std::index_sequence<FieldIndices...>)
+    {
+      return {std::is_arithmetic_v<FieldType<PacketType, FieldIndices>>...};
     }
 
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
-    template<std::size_t Index = 0, typename GridArrayType, typename TupleType>
+    template<
+      std::size_t Index = 0,
+      typename GridArrayType,
+      typename TupleType,
+      typename TableFactoryType>
     typename std::enable_if_t<Index == std::tuple_size_v<TupleType>>
       AddPages(
         wxNotebook* pNotebook,
         GridArrayType& gridArray,
-        const TupleType& tuple)
+        const TupleType& tuple,
+        TableFactoryType&& makeTable)
     {
     }
 
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
-    template<std::size_t Index = 0, typename GridArrayType, typename TupleType>
+    template<
+      std::size_t Index = 0,
+      typename GridArrayType,
+      typename TupleType,
+      typename TableFactoryType>
     typename std::enable_if_t<Index != std::tuple_size_v<TupleType>>
       AddPages(
         wxNotebook* pNotebook,
         GridArrayType& gridArray,
-        const TupleType& tuple)
+        const TupleType& tuple,
+        TableFactoryType&& makeTable)
     {
-      using PacketType = decltype(std::get<Index>(tuple));
-
-      auto name = boost::typeindex::type_id<PacketType>().pretty_name();
-
-      RemoveNamespace(name);
+      using PacketType = std::tuple_element_t<Index, TupleType>;
 
       auto pPage = new wxPanel(pNotebook, wxID_ANY);
 
@@ -124,7 +186,19 @@ namespace gs
       gridArray[Index] = pGrid;
 
       // Grid
-      AddGridLabels(pGrid, std::get<Index>(tuple));
+      if (auto pTable = makeTable(std::integral_constant<std::size_t, Index>()))
+      {
+        pGrid->SetTable(pTable, true);
+
+        for (auto i = 0u; i < schema::FieldCount<PacketType>; ++i)
+        {
+          pGrid->AutoSizeColLabelSize(i);
+        }
+      }
+      else
+      {
+        AddGridLabels<PacketType>(pGrid);
+      }
 
       pGrid->EnableEditing(false);
       pGrid->EnableGridLines(true);
@@ -144,9 +218,10 @@ namespace gs
       // Cell Defaults
       pGrid->SetDefaultCellAlignment(wxALIGN_LEFT, wxALIGN_TOP);
 
-      auto pPageSizer = new wxBoxSizer(wxHORIZONTAL);
+      // sparklines are added below the grid
+      auto pPageSizer = new wxBoxSizer(wxVERTICAL);
 
-      auto Flags = wxSizerFlags(1).Center().Border(wxALL, 5);
+      auto Flags = wxSizerFlags(1).Expand().Border(wxALL, 5);
 
       pPageSizer->Add(pGrid, Flags);
 
@@ -154,38 +229,15 @@ namespace gs
       pPage->Layout();
       pPageSizer->Fit(pPage);
 
-      pNotebook->AddPage(pPage, name, false);
+      pNotebook->AddPage(pPage, schema::PageTitle<PacketType>.c_str(), false);
 
-      AddPages<Index + 1>(pNotebook, gridArray, tuple);
-    }
-
-    //--------------------------------------------------------------------------
-    //--------------------------------------------------------------------------
-    template<std::size_t Index = 0, typename T, typename TupleType>
-    typename std::enable_if_t<Index == std::tuple_size_v<TupleType>, size_t>
-      GetIndex(const TupleType& tuple)
-    {
-      throw std::logic_error("unable to get index of wxGrid");
-    }
-
-    //--------------------------------------------------------------------------
-    //--------------------------------------------------------------------------
-    template<std::size_t Index = 0, typename T, typename TupleType>
-    typename std::enable_if_t<Index != std::tuple_size_v<TupleType>, size_t>
-      GetIndex(const TupleType& tuple)
-    {
-      if (
-        std::is_same_v<
-          std::decay_t<decltype(std::get<Index>(tuple))>,
-          std::decay_t<T>>)
-      {
-        return Index;
-      }
-      return GetIndex<Index + 1, T, TupleType>(tuple);
+      AddPages<Index + 1>(pNotebook, gridArray, tuple, makeTable);
     }
   }
 
   //----------------------------------------------------------------------------
+  // Header only, but it repaints through FrameClock and draws Sparklines, so
+  // anything using it links GuiStuffLib and with it DanLib's Image.
   //----------------------------------------------------------------------------
   template <typename ... Args>
   class GridDisplayer : public wxPanel
@@ -194,9 +246,28 @@ namespace gs
 
       //------------------------------------------------------------------------
       //------------------------------------------------------------------------
-      GridDisplayer(wxWindow* pParent)
+      GridDisplayer(
+        wxWindow* pParent,
+        const GridDisplayerOptions& options = GridDisplayerOptions())
         : wxPanel(pParent, wxID_ANY),
-        mFields()
+        mFields(),
+        mCellCaches{GridCellCache(
+          options.mStorage == GridStorage::Cells ? schema::FieldCount<Args> : 0)...},
+        mLatestValues(),
+        mHistories(GetHistoryDepth<Args>(options)...),
+        mOptions(options),
+        mRefreshTimer(this, RefreshTimerId),
+        mStatistics(),
+        mpNotebook(nullptr),
+        mpStatisticsText(nullptr),
+        mStatisticsTimer(this, StatisticsTimerId),
+        mpRecorder(nullptr),
+        mRecorderEpoch(0),
+        mRecordingCounts{0, 0},
+        mSampleRings{MakeSampleRing<Args>(options)...},
+        mNumericFields{MakeNumericFields<Args>(
+          std::make_index_sequence<schema::FieldCount<Args>>())...},
+        mSparklines{std::vector<Sparkline*>(schema::FieldCount<Args>)...}
       {
         SetSizeHints(wxDefaultSize, wxDefaultSize);
 
@@ -207,14 +278,25 @@ namespace gs
           wxDefaultSize,
           wxTAB_TRAVERSAL);
 
-        auto pMainSizer = new wxBoxSizer(wxHORIZONTAL);
+        auto pMainSizer = new wxBoxSizer(wxVERTICAL);
 
-        auto pNotebook =
+        mpNotebook =
           new wxNotebook(pPanel, wxID_ANY, wxDefaultPosition, wxDefaultSize, 0);
 
-        AddPages(pNotebook, mGrids, mFields);
+        AddPages(
+          mpNotebook,
+          mGrids,
+          mFields,
+          [this] (auto index) { return MakeTable<decltype(index)::value>(); });
 
-        pMainSizer->Add(pNotebook, 1, wxEXPAND | wxALL, 5);
+        pMainSizer->Add(mpNotebook, 1, wxEXPAND | wxALL, 5);
+
+        if (mOptions.mShowStatistics)
+        {
+          mpStatisticsText = new wxStaticText(pPanel, wxID_ANY, "");
+
+          pMainSizer->Add(mpStatisticsText, 0, wxEXPAND | wxLEFT | wxRIGHT, 5);
+        }
 
         pPanel->SetSizer(pMainSizer);
         pPanel->Layout();
@@ -226,9 +308,62 @@ namespace gs
         SetSizer(pFrameSizer);
         pFrameSizer->Fit(this);
         Layout();
+
+        for (auto i = 0u; i < mGrids.size(); ++i)
+        {
+          mGrids[i]->GetGridWindow()->Bind(
+            wxEVT_PAINT,
+            [this, i] (wxPaintEvent& event)
+            {
+              mStatistics[i].OnPainted();
+
+              event.Skip();
+            });
+
+          if (mOptions.mSparklineDepth > 0)
+          {
+            mGrids[i]->Bind(
+              wxEVT_GRID_LABEL_LEFT_DCLICK,
+              [this, i] (wxGridEvent& event)
+              {
+                if (event.GetRow() < 0 && event.GetCol() >= 0)
+                {
+                  auto field = static_cast<std::size_t>(event.GetCol());
+
+                  DoShowSparkline(i, field, !mSparklines[i][field]);
+                }
+
+                event.Skip();
+              });
+          }
+        }
+
+        if (
+          mOptions.mUpdatePolicy == UpdatePolicy::Coalesced ||
+          mOptions.mSparklineDepth > 0)
+        {
+          Bind(
+            wxEVT_TIMER,
+            &GridDisplayer::OnRefreshTimer,
+            this,
+            RefreshTimerId);
+
+          mRefreshTimer.Start(mOptions.mRefreshPeriod.count());
+        }
+
+        Bind(
+          wxEVT_TIMER,
+          &GridDisplayer::OnStatisticsTimer,
+          this,
+          StatisticsTimerId);
+
+        mStatisticsTimer.Start(mOptions.mStatisticsPeriod.count());
       }
 
       //------------------------------------------------------------------------
+      // Any thread, never waits on the gui thread.  When coalescing, a packet
+      // set while another thread is setting one of the same type counts as
+      // superseded by it rather than waiting for it.
       //------------------------------------------------------------------------
       template <typename T>
       void Set(T t)
@@ -237,17 +372,347 @@ namespace gs
           dl::ContainsType<T, std::tuple<Args...>> {},
           "Set must be called with contained type");
 
-        gs::DoOnGuiThread([t, this] { AddGridValues(GetGrid<T>(), t); });
+        constexpr auto index = schema::IndexOf<T, std::tuple<Args...>>;
+
+        mStatistics[index].OnReceived();
+
+        if (mpRecorder.load(std::memory_order_relaxed))
+        {
+          Record(t);
+        }
+
+        if (mOptions.mStorage == GridStorage::History)
+        {
+          std::get<PacketHistory<T>>(mHistories).Push(t);
+        }
+
+        if (const auto& pSampleRing = mSampleRings[index])
+        {
+          auto samples = MakeSamples(
+            t,
+            std::make_index_sequence<schema::FieldCount<T>>());
+
+          pSampleRing->Push(samples.data());
+        }
+
+        if (mOptions.mUpdatePolicy == UpdatePolicy::Coalesced)
+        {
+          std::get<LatestValue<T>>(mLatestValues).Set(t);
+        }
+        else
+        {
+          gs::DoOnGuiThread([t, this]
+          {
+            Display<index>(t);
+          });
+        }
+      }
+
+      //------------------------------------------------------------------------
+      // Number of packets of type T that were overwritten by a newer one
+      // before they were displayed.  Only counted in coalesced mode.
+      //------------------------------------------------------------------------
+      template <typename T>
+      uint64_t GetSupersededCount() const
+      {
+        static_assert(
+          dl::ContainsType<T, std::tuple<Args...>> {},
+          "GetSupersededCount must be called with contained type");
+
+        return std::get<LatestValue<T>>(mLatestValues).GetSupersededCount();
+      }
+
+      //------------------------------------------------------------------------
+      // Every packet passed to Set is also written to pRecorder until this is
+      // called again with another recorder or nullptr.  Returns once no Set
+      // is still writing to the previous recorder, which may only be
+      // destroyed after that.  One thread at a time.
+      //
+      // Sets count themselves in under the epoch they started in, so only
+      // the ones that began before the swap are waited for, however many
+      // keep coming after it.
+      //------------------------------------------------------------------------
+      void SetRecorder(PacketRecorder<Args...>* pRecorder)
+      {
+        mpRecorder.store(pRecorder);
+
+        auto epoch = mRecorderEpoch.fetch_add(1) & 1;
+
+        while (mRecordingCounts[epoch].load() != 0)
+        {
+          std::this_thread::yield();
+        }
+      }
+
+      //------------------------------------------------------------------------
+      // Rates and latency percentiles as of the last statistics period, the
+      // same numbers the statistics strip shows.
+      //------------------------------------------------------------------------
+      template <typename T>
+      UpdateStatisticsSnapshot GetStatistics() const
+      {
+        static_assert(
+          dl::ContainsType<T, std::tuple<Args...>> {},
+          "GetStatistics must be called with contained type");
+
+        return mStatistics[schema::IndexOf<T, std::tuple<Args...>>].GetSnapshot();
+      }
+
+      //------------------------------------------------------------------------
+      // Shows or hides a strip chart of the last mSparklineDepth values of
+      // one field of T, numbered as its grid's columns, under that grid.
+      // Double clicking the column label toggles it too.  Only numeric fields
+      // have one, and only when mSparklineDepth isn't 0.  Gui thread only.
+      //------------------------------------------------------------------------
+      template <typename T>
+      void ShowSparkline(std::size_t field, bool isShown = true)
+      {
+        static_assert(
+          dl::ContainsType<T, std::tuple<Args...>> {},
+          "ShowSparkline must be called with contained type");
+
+        DoShowSparkline(
+          schema::IndexOf<T, std::tuple<Args...>>,
+          field,
+          isShown);
       }
 
     private:
 
+      enum
+      {
+        RefreshTimerId = wxID_HIGHEST + 1,
+        StatisticsTimerId
+      };
+
       //------------------------------------------------------------------------
       //------------------------------------------------------------------------
       template <typename T>
-      wxGrid* GetGrid()
+      static std::size_t GetHistoryDepth(const GridDisplayerOptions& options)
       {
-        return mGrids[GetIndex<0, T, std::tuple<Args...>>(mFields)];
+        return
+          options.mStorage == GridStorage::History ? options.mHistoryDepth : 0;
+      }
+
+      //------------------------------------------------------------------------
+      // Counted in under an epoch still current once counted, the recorder
+      // is loaded after that, so SetRecorder either waits for this call or
+      // it already sees the new recorder.  Only a swap landing between the
+      // two loads of the epoch makes it count in again.
+      //------------------------------------------------------------------------
+      template <typename T>
+      void Record(const T& t)
+      {
+        auto epoch = mRecorderEpoch.load();
+
+        while (true)
+        {
+          ++mRecordingCounts[epoch & 1];
+
+          auto current = mRecorderEpoch.load();
+
+          if (current == epoch)
+          {
+            break;
+          }
+
+          --mRecordingCounts[epoch & 1];
+
+          epoch = current;
+        }
+
+        if (auto pRecorder = mpRecorder.load())
+        {
+          pRecorder->Record(t);
+        }
+
+        --mRecordingCounts[epoch & 1];
+      }
+
+      //------------------------------------------------------------------------
+      // nullptr leaves the grid owning its cells.
+      //------------------------------------------------------------------------
+      template <std::size_t Index>
+      wxGridTableBase* MakeTable()
+      {
+        using PacketType = std::tuple_element_t<Index, std::tuple<Args...>>;
+
+        switch (mOptions.mStorage)
+        {
+          case GridStorage::Packet:
+            return new PacketGridTable<PacketType>(std::get<Index>(mFields));
+          case GridStorage::History:
+            return new HistoryGridTable<PacketType>(std::get<Index>(mHistories));
+          case GridStorage::Cells:
+            break;
+        }
+        return nullptr;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <typename T>
+      static std::shared_ptr<SampleRing> MakeSampleRing(
+        const GridDisplayerOptions& options)
+      {
+        if (options.mSparklineDepth == 0)
+        {
+          return nullptr;
+        }
+
+        return std::make_shared<SampleRing>(
+          schema::FieldCount<T>,
+          options.mSparklineDepth);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void DoShowSparkline(std::size_t page, std::size_t field, bool isShown)
+      {
+        if (
+          !mSampleRings[page] ||
+          field >= mNumericFields[page].size() ||
+          !mNumericFields[page][field])
+        {
+          return;
+        }
+
+        auto& pSparkline = mSparklines[page][field];
+
+        if (isShown == (pSparkline != nullptr))
+        {
+          return;
+        }
+
+        auto pPage = mGrids[page]->GetParent();
+
+        if (isShown)
+        {
+          pSparkline = new Sparkline(
+            pPage,
+            mSampleRings[page],
+            field,
+            mGrids[page]->GetColLabelValue(field));
+
+          pPage->GetSizer()->Add(
+            pSparkline,
+            0,
+            wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM,
+            5);
+        }
+        else
+        {
+          pSparkline->Destroy();
+
+          pSparkline = nullptr;
+        }
+
+        pPage->Layout();
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void OnRefreshTimer(wxTimerEvent&)
+      {
+        if (mOptions.mUpdatePolicy == UpdatePolicy::Coalesced)
+        {
+          DrainLatestValues(std::index_sequence_for<Args...>());
+        }
+
+        for (auto& sparklines : mSparklines)
+        {
+          for (auto pSparkline : sparklines)
+          {
+            if (pSparkline)
+            {
+              pSparkline->Synchronize();
+            }
+          }
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void OnStatisticsTimer(wxTimerEvent&)
+      {
+        SampleStatistics(std::index_sequence_for<Args...>());
+
+        if (!mpStatisticsText)
+        {
+          return;
+        }
+
+        auto selection = mpNotebook->GetSelection();
+
+        if (selection < 0 || static_cast<std::size_t>(selection) >= mGrids.size())
+        {
+          return;
+        }
+
+        auto snapshot = mStatistics[selection].GetSnapshot();
+
+        mpStatisticsText->SetLabel(wxString::Format(
+          "received %.0f/s   displayed %.0f/s   coalesced %llu   "
+          "latency p50 %.1f ms   p99 %.1f ms",
+          snapshot.mReceivedRate,
+          snapshot.mDisplayedRate,
+          static_cast<unsigned long long>(snapshot.mCoalescedCount),
+          snapshot.mLatencyP50.count() / 1e6,
+          snapshot.mLatencyP99.count() / 1e6));
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t ... Indices>
+      void SampleStatistics(std::index_sequence<Indices...>)
+      {
+        (mStatistics[Indices].Sample(
+          std::get<Indices>(mLatestValues).GetSupersededCount()), ...);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t ... Indices>
+      void DrainLatestValues(std::index_sequence<Indices...>)
+      {
+        (DrainLatestValue<Indices>(), ...);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t Index>
+      void DrainLatestValue()
+      {
+        if (auto pPacket = std::get<Index>(mLatestValues).Take())
+        {
+          Display<Index>(*pPacket);
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t Index, typename T>
+      void Display(const T& packet)
+      {
+        mStatistics[Index].OnDisplayed();
+
+        switch (mOptions.mStorage)
+        {
+          case GridStorage::Packet:
+            std::get<Index>(mFields) = packet;
+
+            gs::FrameClock::GetInstance().Invalidate(
+              mGrids[Index]->GetGridWindow());
+            break;
+          case GridStorage::History:
+            // already pushed on the producer thread
+            static_cast<HistoryGridTable<T>*>(
+              mGrids[Index]->GetTable())->Synchronize();
+            break;
+          case GridStorage::Cells:
+            AddGridValues(mGrids[Index], mCellCaches[Index], packet);
+            break;
+        }
       }
 
     private:
@@ -255,6 +720,40 @@ namespace gs
       std::tuple<Args...> mFields;
 
       std::array<wxGrid*, std::tuple_size_v<std::tuple<Args...>>> mGrids;
+
+      std::array<GridCellCache, sizeof...(Args)> mCellCaches;
+
+      std::tuple<LatestValue<Args>...> mLatestValues;
+
+      std::tuple<PacketHistory<Args>...> mHistories;
+
+      GridDisplayerOptions mOptions;
+
+      wxTimer mRefreshTimer;
+
+      std::array<UpdateStatistics, sizeof...(Args)> mStatistics;
+
+      wxNotebook* mpNotebook;
+
+      wxStaticText* mpStatisticsText;
+
+      wxTimer mStatisticsTimer;
+
+      std::atomic<PacketRecorder<Args...>*> mpRecorder;
+
+      // bumped by every SetRecorder
+      std::atomic<uint32_t> mRecorderEpoch;
+
+      // Sets writing to a recorder right now, by the parity of their epoch
+      std::array<std::atomic<uint32_t>, 2> mRecordingCounts;
+
+      // none when mSparklineDepth is 0
+      std::array<std::shared_ptr<SampleRing>, sizeof...(Args)> mSampleRings;
+
+      std::array<std::vector<bool>, sizeof...(Args)> mNumericFields;
+
+      // per field, nullptr while its sparkline is hidden
+      std::array<std::vector<Sparkline*>, sizeof...(Args)> mSparklines;
     };
   }
 
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <wx/app.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct GuiDispatcherStatistics
+  {
+    uint64_t mQueueDepth;
+
+    uint64_t mExecutedCount;
+
+    uint64_t mWakeupCount;
+
+    std::chrono::nanoseconds mLastDelay;
+
+    std::chrono::nanoseconds mMaxDelay;
+  };
+
+  //----------------------------------------------------------------------------
+  // Collects closures from any number of threads in a lock free intrusive
+  // queue and runs them on the gui thread in batches, so that wx only sees one
+  // CallAfter per event loop pass instead of one per closure.
+  //----------------------------------------------------------------------------
+  class GuiDispatcher
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      static GuiDispatcher& GetInstance()
+      {
+        static GuiDispatcher dispatcher;
+
+        return dispatcher;
+      }
+
+      GuiDispatcher(const GuiDispatcher&) = delete;
+
+      GuiDispatcher& operator = (const GuiDispatcher&) = delete;
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      ~GuiDispatcher()
+      {
+        while (auto pNode = Pop())
+        {
+          delete pNode;
+        }
+      }
+
+      //------------------------------------------------------------------------
+      // Dropped, and destroyed on the calling thread, once shut down.
+      //------------------------------------------------------------------------
+      void Post(std::function<void()> function)
+      {
+        if (mIsShutDown.load(std::memory_order_acquire))
+        {
+          return;
+        }
+
+        auto pNode = new Node;
+
+        pNode->mFunction = std::move(function);
+
+        pNode->mEnqueueTime = std::chrono::steady_clock::now();
+
+        Push(pNode);
+
+        mQueueDepth.fetch_add(1, std::memory_order_relaxed);
+
+        RequestWakeup();
+      }
+
+      //------------------------------------------------------------------------
+      // Gui thread, done by the WorkerPool's wxModule as the app exits once
+      // the workers have posted their last results.  Closures still queued
+      // hold bitmaps and windows, so they are destroyed here while wx is up,
+      // without being run.
+      //------------------------------------------------------------------------
+      void Shutdown()
+      {
+        mIsShutDown.store(true, std::memory_order_release);
+
+        while (auto pNode = Pop())
+        {
+          mQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+
+          delete pNode;
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      GuiDispatcherStatistics GetStatistics() const
+      {
+        return {
+          mQueueDepth.load(std::memory_order_relaxed),
+          mExecutedCount.load(std::memory_order_relaxed),
+          mWakeupCount.load(std::memory_order_relaxed),
+          std::chrono::nanoseconds(mLastDelay.load(std::memory_order_relaxed)),
+          std::chrono::nanoseconds(mMaxDelay.load(std::memory_order_relaxed))};
+      }
+
+    private:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      struct Node
+      {
+        std::atomic<Node*> mpNext = nullptr;
+
+        std::function<void()> mFunction;
+
+        std::chrono::steady_clock::time_point mEnqueueTime;
+      };
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      GuiDispatcher()
+        : mpHead(&mStub),
+          mpTail(&mStub),
+          mStub(),
+          mIsWakeupPending(false),
+          mIsShutDown(false),
+          mQueueDepth(0),
+          mExecutedCount(0),
+          mWakeupCount(0),
+          mLastDelay(0),
+          mMaxDelay(0)
+      {
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void RequestWakeup()
+      {
+        if (!mIsWakeupPending.exchange(true, std::memory_order_acq_rel))
+        {
+          if (wxTheApp)
+          {
+            wxTheApp->CallAfter([this] { Drain(); });
+          }
+          else
+          {
+            mIsWakeupPending.store(false, std::memory_order_release);
+          }
+        }
+      }
+
+      //------------------------------------------------------------------------
+      // Runs on the gui thread.  Only the closures queued before the batch
+      // started are run so that closures posting more work can't starve the
+      // event loop.
+      //------------------------------------------------------------------------
+      void Drain()
+      {
+        mWakeupCount.fetch_add(1, std::memory_order_relaxed);
+
+        mIsWakeupPending.store(false, std::memory_order_seq_cst);
+
+        if (mIsShutDown.load(std::memory_order_acquire))
+        {
+          return;
+        }
+
+        auto batchSize = mQueueDepth.load(std::memory_order_acquire);
+
+        for (; batchSize > 0; --batchSize)
+        {
+          auto pNode = Pop();
+
+          if (!pNode)
+          {
+            break;
+          }
+
+          mQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+
+          auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - pNode->mEnqueueTime).count();
+
+          mLastDelay.store(delay, std::memory_order_relaxed);
+
+          if (delay > mMaxDelay.load(std::memory_order_relaxed))
+          {
+            mMaxDelay.store(delay, std::memory_order_relaxed);
+          }
+
+          pNode->mFunction();
+
+          delete pNode;
+
+          mExecutedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Either the batch was cut short or a producer was half way through a
+        // push, in both cases come back on the next pass.
+        if (mQueueDepth.load(std::memory_order_acquire) > 0)
+        {
+          RequestWakeup();
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void Push(Node* pNode)
+      {
+        pNode->mpNext.store(nullptr, std::memory_order_relaxed);
+
+        auto pPrevious = mpHead.exchange(pNode, std::memory_order_acq_rel);
+
+        pPrevious->mpNext.store(pNode, std::memory_order_release);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      Node* Pop()
+      {
+        auto pTail = mpTail;
+
+        auto pNext = pTail->mpNext.load(std::memory_order_acquire);
+
+        if (pTail == &mStub)
+        {
+          if (!pNext)
+          {
+            return nullptr;
+          }
+
+          mpTail = pNext;
+
+          pTail = pNext;
+
+          pNext = pNext->mpNext.load(std::memory_order_acquire);
+        }
+
+        if (pNext)
+        {
+          mpTail = pNext;
+
+          return pTail;
+        }
+
+        if (pTail != mpHead.load(std::memory_order_acquire))
+        {
+          return nullptr;
+        }
+
+        Push(&mStub);
+
+        pNext = pTail->mpNext.load(std::memory_order_acquire);
+
+        if (pNext)
+        {
+          mpTail = pNext;
+
+          return pTail;
+        }
+
+        return nullptr;
+      }
+
+    private:
+
+      alignas(64) std::atomic<Node*> mpHead;
+
+      alignas(64) Node* mpTail;
+
+      Node mStub;
+
+      alignas(64) std::atomic<bool> mIsWakeupPending;
+
+      std::atomic<bool> mIsShutDown;
+
+      std::atomic<uint64_t> mQueueDepth;
+
+      std::atomic<uint64_t> mExecutedCount;
+
+      std::atomic<uint64_t> mWakeupCount;
+
+      std::atomic<int64_t> mLastDelay;
+
+      std::atomic<int64_t> mMaxDelay;
+  };
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <GuiStuff/GuiDispatcher.hpp>
+
 #include <wx/app.h>
 #include <wx/window.h>
 #include <iostream>
@@ -10,8 +12,7 @@ namespace gs
   {
     if (wxTheApp)
     {
-      wxTheApp->GetTopWindow()->GetEventHandler()->CallAfter(
-        std::forward<T>(function));
+      GuiDispatcher::GetInstance().Post(std::forward<T>(function));
     }
   }
 }
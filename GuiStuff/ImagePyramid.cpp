@@ -0,0 +1,235 @@
+#include "ImagePyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using gs::ImagePyramid;
+using gs::PixelEncoding;
+
+//------------------------------------------------------------------------------
+// Levels stop once the image fits in a typical thumbnail.
+//------------------------------------------------------------------------------
+ImagePyramid::ImagePyramid(
+  const ImageView& source,
+  std::shared_ptr<const void> pOwner)
+  : mpOwner(std::move(pOwner)),
+    mLevels(1, source),
+    mLevelData(),
+    mBuildMutex(),
+    mBuiltLevelCount(1),
+    mRequestedLevelCount(1)
+{
+  auto width = source.mWidth;
+
+  auto height = source.mHeight;
+
+  while (std::max(width, height) > 64 && std::min(width, height) > 1)
+  {
+    width = (width + 1) / 2;
+
+    height = (height + 1) / 2;
+
+    mLevels.push_back({nullptr, width, height, std::size_t(width) * 3});
+  }
+
+  mLevelData.resize(mLevels.size());
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t ImagePyramid::GetLevelCount() const
+{
+  return mLevels.size();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t ImagePyramid::GetBuiltLevelCount() const
+{
+  return mBuiltLevelCount.load(std::memory_order_acquire);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+const gs::ImageView& ImagePyramid::GetLevel(std::size_t level) const
+{
+  return mLevels[level];
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t ImagePyramid::GetLevelFor(double step) const
+{
+  if (step < 2.0)
+  {
+    return 0;
+  }
+
+  auto level = static_cast<std::size_t>(std::floor(std::log2(step)));
+
+  return std::min(level, mLevels.size() - 1);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool ImagePyramid::Request(std::size_t levelCount)
+{
+  levelCount = std::min(levelCount, mLevels.size());
+
+  auto requested = mRequestedLevelCount.load(std::memory_order_relaxed);
+
+  while (requested < levelCount)
+  {
+    if (mRequestedLevelCount.compare_exchange_weak(requested, levelCount))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Each level is published as soon as it is done so readers can use it while
+// coarser ones are still being built.
+//------------------------------------------------------------------------------
+void ImagePyramid::Build(std::size_t levelCount)
+{
+  levelCount = std::min(levelCount, mLevels.size());
+
+  std::lock_guard lock(mBuildMutex);
+
+  for (
+    auto level = mBuiltLevelCount.load(std::memory_order_relaxed);
+    level < levelCount;
+    ++level)
+  {
+    auto& data = mLevelData[level];
+
+    data.resize(mLevels[level].mStride * mLevels[level].mHeight);
+
+    mLevels[level].mpData = data.data();
+
+    DoDownsample(mLevels[level - 1], mLevels[level], data.data());
+
+    mBuiltLevelCount.store(level + 1, std::memory_order_release);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool ImagePyramid::IsBuiltFor(const ScaleMapping& mapping) const
+{
+  return
+    GetLevelFor(std::min(mapping.mStepX, mapping.mStepY)) <
+    GetBuiltLevelCount();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool ImagePyramid::Scale(
+  wxBitmap& bitmap,
+  ScaleFilter filter,
+  const ScaleMapping& mapping) const
+{
+  return Scale(bitmap, wxRect(bitmap.GetSize()), filter, mapping);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool ImagePyramid::Scale(
+  wxBitmap& bitmap,
+  const wxRect& area,
+  ScaleFilter filter,
+  const ScaleMapping& mapping) const
+{
+  auto level = std::min(
+    GetLevelFor(std::min(mapping.mStepX, mapping.mStepY)),
+    GetBuiltLevelCount() - 1);
+
+  return ScaleImage(
+    mLevels[level],
+    bitmap,
+    area,
+    filter,
+    DoGetLevelMapping(level, mapping));
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::ScaleMapping ImagePyramid::DoGetLevelMapping(
+  std::size_t level,
+  const ScaleMapping& mapping) const
+{
+  auto scaleX =
+    static_cast<double>(mLevels[level].mWidth) / mLevels[0].mWidth;
+
+  auto scaleY =
+    static_cast<double>(mLevels[level].mHeight) / mLevels[0].mHeight;
+
+  return {
+    mapping.mX * scaleX,
+    mapping.mY * scaleY,
+    mapping.mStepX * scaleX,
+    mapping.mStepY * scaleY};
+}
+
+//------------------------------------------------------------------------------
+// 2x2 box filter, an odd last row or column is averaged with itself.  A
+// source in another format (only ever level 0) is converted two rows at a
+// time on the way.
+//------------------------------------------------------------------------------
+void ImagePyramid::DoDownsample(
+  const ImageView& source,
+  const ImageView& level,
+  uint8_t* pData)
+{
+  auto isConverted = source.mFormat.mEncoding != PixelEncoding::Rgb8;
+
+  std::size_t rowBytes = std::size_t(source.mWidth) * 3;
+
+  std::vector<uint8_t> convertedRows(isConverted ? rowBytes * 2 : 0);
+
+  for (unsigned y = 0; y < level.mHeight; ++y)
+  {
+    auto pRow0 = source.mpData + 2 * y * source.mStride;
+
+    auto pRow1 =
+      2 * y + 1 < source.mHeight ? pRow0 + source.mStride : pRow0;
+
+    if (isConverted)
+    {
+      ConvertRow(source, 2 * y, 0, source.mWidth, convertedRows.data());
+
+      pRow0 = pRow1 = convertedRows.data();
+
+      if (2 * y + 1 < source.mHeight)
+      {
+        pRow1 = pRow0 + rowBytes;
+
+        ConvertRow(
+          source,
+          2 * y + 1,
+          0,
+          source.mWidth,
+          convertedRows.data() + rowBytes);
+      }
+    }
+
+    auto pRow = pData + y * level.mStride;
+
+    for (unsigned x = 0; x < level.mWidth; ++x)
+    {
+      auto x0 = 2 * x * 3;
+
+      auto x1 = 2 * x + 1 < source.mWidth ? x0 + 3 : x0;
+
+      for (unsigned channel = 0; channel < 3; ++channel)
+      {
+        pRow[x * 3 + channel] = static_cast<uint8_t>(
+          (pRow0[x0 + channel] + pRow0[x1 + channel] +
+           pRow1[x0 + channel] + pRow1[x1 + channel] + 2) >> 2);
+      }
+    }
+  }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <GuiStuff/ImageScaler.hpp>
+
+#include <wx/bitmap.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // Mip levels of an image, each a 2x2 box filtered half of the one above.
+  // Level 0 is the source itself, in whatever format, kept alive by pOwner.
+  // The other levels are RGB, built on demand by Build (normally on the
+  // worker pool) and can be read from any thread once GetBuiltLevelCount
+  // covers them.
+  //----------------------------------------------------------------------------
+  class ImagePyramid
+  {
+    public:
+
+      ImagePyramid(const ImageView& Source, std::shared_ptr<const void> pOwner);
+
+      ImagePyramid(const ImagePyramid&) = delete;
+
+      ImagePyramid& operator = (const ImagePyramid&) = delete;
+
+      std::size_t GetLevelCount() const;
+
+      std::size_t GetBuiltLevelCount() const;
+
+      const ImageView& GetLevel(std::size_t Level) const;
+
+      // The coarsest level that still has at least one pixel per destination
+      // pixel for a mapping step of Step source pixels.
+      std::size_t GetLevelFor(double Step) const;
+
+      // Whether the level Mapping calls for is built, Scale otherwise falls
+      // back to a finer one and reads that many more source pixels.
+      bool IsBuiltFor(const ScaleMapping& Mapping) const;
+
+      // Returns true for the first caller asking for more than has been
+      // requested so far, that caller should see that Build gets called.
+      bool Request(std::size_t LevelCount);
+
+      void Build(std::size_t LevelCount);
+
+      // Scales from the best level built so far, Mapping is in level 0
+      // pixels.
+      bool Scale(
+        wxBitmap& Bitmap,
+        ScaleFilter Filter,
+        const ScaleMapping& Mapping) const;
+
+      // Only into Area of the bitmap, Mapping is relative to its top left.
+      bool Scale(
+        wxBitmap& Bitmap,
+        const wxRect& Area,
+        ScaleFilter Filter,
+        const ScaleMapping& Mapping) const;
+
+    private:
+
+      static void DoDownsample(
+        const ImageView& Source,
+        const ImageView& Level,
+        uint8_t* pData);
+
+      ScaleMapping DoGetLevelMapping(
+        std::size_t Level,
+        const ScaleMapping& Mapping) const;
+
+    private:
+
+      std::shared_ptr<const void> mpOwner;
+
+      std::vector<ImageView> mLevels;
+
+      std::vector<std::vector<uint8_t>> mLevelData;
+
+      std::mutex mBuildMutex;
+
+      std::atomic<std::size_t> mBuiltLevelCount;
+
+      std::atomic<std::size_t> mRequestedLevelCount;
+  };
+}
@@ -0,0 +1,2202 @@
+#include "ImageScaler.hpp"
+
+#include <wx/rawbmp.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GUISTUFF_X86_SIMD
+#endif
+
+using gs::PixelLayout;
+using gs::ImageView;
+using gs::PixelEncoding;
+using gs::ScaleMapping;
+using gs::ScaleFilter;
+
+namespace
+{
+  enum class SimdLevel
+  {
+    None,
+    Sse41,
+    Avx2
+  };
+
+  //----------------------------------------------------------------------------
+  // Source column of every destination column as a byte offset into a row.
+  // For bilinear also the column to blend with and its weight out of 256.
+  //----------------------------------------------------------------------------
+  struct ColumnMap
+  {
+    std::vector<int32_t> mOffsets;
+
+    std::vector<int32_t> mNextOffsets;
+
+    std::vector<uint16_t> mWeights;
+  };
+
+  //----------------------------------------------------------------------------
+  // pshufb masks taking four gathered RGBx source pixels to four destination
+  // pixels, repeated for both 128 bit lanes.
+  //----------------------------------------------------------------------------
+  struct ShuffleMasks
+  {
+    alignas(32) std::array<uint8_t, 32> mShuffle;
+
+    alignas(32) std::array<uint8_t, 32> mAlpha;
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  SimdLevel GetSimdLevel()
+  {
+#ifdef GUISTUFF_X86_SIMD
+    static const auto simdLevel = []
+    {
+      __builtin_cpu_init();
+
+      if (__builtin_cpu_supports("avx2"))
+      {
+        return SimdLevel::Avx2;
+      }
+      if (__builtin_cpu_supports("sse4.1"))
+      {
+        return SimdLevel::Sse41;
+      }
+      return SimdLevel::None;
+    }();
+
+    return simdLevel;
+#else
+    return SimdLevel::None;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  bool IsSimdLayout(const PixelLayout& layout)
+  {
+    return layout.mBytesPerPixel == 3 || layout.mBytesPerPixel == 4;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  ShuffleMasks MakeShuffleMasks(const PixelLayout& layout)
+  {
+    ShuffleMasks masks;
+
+    masks.mShuffle.fill(0x80);
+
+    masks.mAlpha.fill(0);
+
+    for (unsigned lane = 0; lane < 2; ++lane)
+    {
+      for (unsigned iPixel = 0; iPixel < 4; ++iPixel)
+      {
+        for (int channel = 0; channel < int(layout.mBytesPerPixel); ++channel)
+        {
+          auto index = lane * 16 + iPixel * layout.mBytesPerPixel + channel;
+
+          if (channel == layout.mRed)
+          {
+            masks.mShuffle[index] = iPixel * 4;
+          }
+          else if (channel == layout.mGreen)
+          {
+            masks.mShuffle[index] = iPixel * 4 + 1;
+          }
+          else if (channel == layout.mBlue)
+          {
+            masks.mShuffle[index] = iPixel * 4 + 2;
+          }
+          else if (channel == layout.mAlpha)
+          {
+            masks.mAlpha[index] = 0xff;
+          }
+        }
+      }
+    }
+    return masks;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  inline void WritePixel(
+    uint8_t* pPixel,
+    uint8_t red,
+    uint8_t green,
+    uint8_t blue,
+    const PixelLayout& layout)
+  {
+    pPixel[layout.mRed] = red;
+
+    pPixel[layout.mGreen] = green;
+
+    pPixel[layout.mBlue] = blue;
+
+    if (layout.mAlpha >= 0)
+    {
+      pPixel[layout.mAlpha] = 0xff;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Source pixel under the centre of destination pixel x.
+  //----------------------------------------------------------------------------
+  unsigned MapNearest(
+    unsigned sourceSize,
+    double origin,
+    double step,
+    unsigned x)
+  {
+    auto position = std::floor(origin + (x + 0.5) * step);
+
+    return static_cast<unsigned>(
+      std::clamp(position, 0.0, static_cast<double>(sourceSize - 1)));
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void MapNearestColumns(
+    unsigned sourceWidth,
+    double origin,
+    double step,
+    unsigned width,
+    ColumnMap& columnMap)
+  {
+    columnMap.mOffsets.resize(width);
+
+    for (unsigned x = 0; x < width; ++x)
+    {
+      columnMap.mOffsets[x] =
+        static_cast<int32_t>(MapNearest(sourceWidth, origin, step, x) * 3);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // The two source pixels either side of the centre of destination pixel x
+  // and the weight of the second out of 256.
+  //----------------------------------------------------------------------------
+  void MapBilinear(
+    unsigned sourceSize,
+    double origin,
+    double step,
+    unsigned x,
+    unsigned& first,
+    unsigned& second,
+    uint16_t& weight)
+  {
+    auto position = std::clamp(
+      origin + (x + 0.5) * step - 0.5,
+      0.0,
+      static_cast<double>(sourceSize - 1));
+
+    auto floor = std::floor(position);
+
+    first = static_cast<unsigned>(floor);
+
+    weight = static_cast<uint16_t>(
+      std::min(std::lround((position - floor) * 256.0), 255L));
+
+    if (first + 1 >= sourceSize)
+    {
+      first = sourceSize - 1;
+
+      weight = 0;
+    }
+
+    second = std::min(first + 1, sourceSize - 1);
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void MapBilinearColumns(
+    unsigned sourceWidth,
+    double origin,
+    double step,
+    unsigned width,
+    ColumnMap& columnMap)
+  {
+    columnMap.mOffsets.resize(width);
+
+    columnMap.mNextOffsets.resize(width);
+
+    columnMap.mWeights.resize(width);
+
+    for (unsigned x = 0; x < width; ++x)
+    {
+      unsigned first, second;
+
+      MapBilinear(
+        sourceWidth,
+        origin,
+        step,
+        x,
+        first,
+        second,
+        columnMap.mWeights[x]);
+
+      columnMap.mOffsets[x] = static_cast<int32_t>(first * 3);
+
+      columnMap.mNextOffsets[x] = static_cast<int32_t>(second * 3);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Returns how many leading columns may read four bytes from their source
+  // pixel without running off the end of the source row.
+  //----------------------------------------------------------------------------
+  unsigned GetGatherCount(
+    const std::vector<int32_t>& offsets,
+    unsigned sourceWidth)
+  {
+    auto rowBytes = static_cast<int32_t>(sourceWidth * 3);
+
+    auto iEnd = std::partition_point(
+      offsets.begin(),
+      offsets.end(),
+      [rowBytes] (int32_t offset) { return offset + 4 <= rowBytes; });
+
+    return static_cast<unsigned>(iEnd - offsets.begin());
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void NearestRowScalar(
+    const uint8_t* pSource,
+    const int32_t* pOffsets,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination,
+    const PixelLayout& layout)
+  {
+    for (auto x = begin; x < end; ++x)
+    {
+      auto pPixel = pSource + pOffsets[x];
+
+      WritePixel(
+        pDestination + x * layout.mBytesPerPixel,
+        pPixel[0],
+        pPixel[1],
+        pPixel[2],
+        layout);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void BilinearRowScalar(
+    const uint8_t* pSource,
+    const ColumnMap& columnMap,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination,
+    const PixelLayout& layout)
+  {
+    for (auto x = begin; x < end; ++x)
+    {
+      auto pPixel0 = pSource + columnMap.mOffsets[x];
+
+      auto pPixel1 = pSource + columnMap.mNextOffsets[x];
+
+      auto weight1 = columnMap.mWeights[x];
+
+      auto weight0 = 256 - weight1;
+
+      WritePixel(
+        pDestination + x * layout.mBytesPerPixel,
+        (pPixel0[0] * weight0 + pPixel1[0] * weight1 + 128) >> 8,
+        (pPixel0[1] * weight0 + pPixel1[1] * weight1 + 128) >> 8,
+        (pPixel0[2] * weight0 + pPixel1[2] * weight1 + 128) >> 8,
+        layout);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void BlendRowsScalar(
+    const uint8_t* pRow0,
+    const uint8_t* pRow1,
+    uint16_t weight,
+    std::size_t begin,
+    std::size_t end,
+    uint8_t* pBlended)
+  {
+    auto weight0 = 256 - weight;
+
+    for (auto i = begin; i < end; ++i)
+    {
+      pBlended[i] = (pRow0[i] * weight0 + pRow1[i] * weight + 128) >> 8;
+    }
+  }
+
+#ifdef GUISTUFF_X86_SIMD
+  //----------------------------------------------------------------------------
+  // Each store writes 16 bytes but only advances by four pixels, the overlap
+  // is rewritten by the next store.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  unsigned NearestRowSse41(
+    const uint8_t* pSource,
+    const int32_t* pOffsets,
+    unsigned gatherCount,
+    uint8_t* pDestination,
+    std::size_t rowBytes,
+    unsigned bytesPerPixel,
+    const ShuffleMasks& masks)
+  {
+    auto shuffle = _mm_load_si128(
+      reinterpret_cast<const __m128i*>(masks.mShuffle.data()));
+
+    auto alpha = _mm_load_si128(
+      reinterpret_cast<const __m128i*>(masks.mAlpha.data()));
+
+    unsigned x = 0;
+
+    for (; x + 4 <= gatherCount && x * bytesPerPixel + 16 <= rowBytes; x += 4)
+    {
+      std::array<int32_t, 4> pixels;
+
+      for (unsigned i = 0; i < 4; ++i)
+      {
+        std::memcpy(&pixels[i], pSource + pOffsets[x + i], 4);
+      }
+
+      auto value = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(pixels.data()));
+
+      value = _mm_or_si128(_mm_shuffle_epi8(value, shuffle), alpha);
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pDestination + x * bytesPerPixel),
+        value);
+    }
+    return x;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  __attribute__((target("avx2")))
+  unsigned NearestRowAvx2(
+    const uint8_t* pSource,
+    const int32_t* pOffsets,
+    unsigned gatherCount,
+    uint8_t* pDestination,
+    std::size_t rowBytes,
+    unsigned bytesPerPixel,
+    const ShuffleMasks& masks)
+  {
+    auto shuffle = _mm256_load_si256(
+      reinterpret_cast<const __m256i*>(masks.mShuffle.data()));
+
+    auto alpha = _mm256_load_si256(
+      reinterpret_cast<const __m256i*>(masks.mAlpha.data()));
+
+    auto laneBytes = 4 * bytesPerPixel;
+
+    unsigned x = 0;
+
+    for (;
+      x + 8 <= gatherCount && x * bytesPerPixel + laneBytes + 16 <= rowBytes;
+      x += 8)
+    {
+      auto offsets = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(pOffsets + x));
+
+      auto value = _mm256_i32gather_epi32(
+        reinterpret_cast<const int*>(pSource),
+        offsets,
+        1);
+
+      value = _mm256_or_si256(_mm256_shuffle_epi8(value, shuffle), alpha);
+
+      auto pPixel = pDestination + x * bytesPerPixel;
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pPixel),
+        _mm256_castsi256_si128(value));
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pPixel + laneBytes),
+        _mm256_extracti128_si256(value, 1));
+    }
+    return x;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  std::size_t BlendRowsSse41(
+    const uint8_t* pRow0,
+    const uint8_t* pRow1,
+    uint16_t weight,
+    std::size_t size,
+    uint8_t* pBlended)
+  {
+    auto weight0 = _mm_set1_epi16(256 - weight);
+
+    auto weight1 = _mm_set1_epi16(weight);
+
+    auto round = _mm_set1_epi16(128);
+
+    auto zero = _mm_setzero_si128();
+
+    std::size_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+      auto row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0 + i));
+
+      auto row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + i));
+
+      auto low = _mm_srli_epi16(
+        _mm_add_epi16(
+          _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(row0, zero), weight0),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(row1, zero), weight1)),
+          round),
+        8);
+
+      auto high = _mm_srli_epi16(
+        _mm_add_epi16(
+          _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(row0, zero), weight0),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(row1, zero), weight1)),
+          round),
+        8);
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pBlended + i),
+        _mm_packus_epi16(low, high));
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  // unpack and pack both work within 128 bit lanes so the byte order comes
+  // out unchanged.
+  //----------------------------------------------------------------------------
+  __attribute__((target("avx2")))
+  std::size_t BlendRowsAvx2(
+    const uint8_t* pRow0,
+    const uint8_t* pRow1,
+    uint16_t weight,
+    std::size_t size,
+    uint8_t* pBlended)
+  {
+    auto weight0 = _mm256_set1_epi16(256 - weight);
+
+    auto weight1 = _mm256_set1_epi16(weight);
+
+    auto round = _mm256_set1_epi16(128);
+
+    auto zero = _mm256_setzero_si256();
+
+    std::size_t i = 0;
+
+    for (; i + 32 <= size; i += 32)
+    {
+      auto row0 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(pRow0 + i));
+
+      auto row1 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(pRow1 + i));
+
+      auto low = _mm256_srli_epi16(
+        _mm256_add_epi16(
+          _mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(row0, zero), weight0),
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(row1, zero), weight1)),
+          round),
+        8);
+
+      auto high = _mm256_srli_epi16(
+        _mm256_add_epi16(
+          _mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(row0, zero), weight0),
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(row1, zero), weight1)),
+          round),
+        8);
+
+      _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(pBlended + i),
+        _mm256_packus_epi16(low, high));
+    }
+    return i;
+  }
+  //----------------------------------------------------------------------------
+  // Four pixels at a time: both neighbours are gathered as RGBx, blended in
+  // 16 bits with each pixel's weight repeated over its four channels, then
+  // shuffled into the destination layout like the nearest path.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  unsigned BilinearRowSse41(
+    const uint8_t* pSource,
+    const ColumnMap& columnMap,
+    unsigned gatherCount,
+    uint8_t* pDestination,
+    std::size_t rowBytes,
+    unsigned bytesPerPixel,
+    const ShuffleMasks& masks)
+  {
+    auto shuffle = _mm_load_si128(
+      reinterpret_cast<const __m128i*>(masks.mShuffle.data()));
+
+    auto alpha = _mm_load_si128(
+      reinterpret_cast<const __m128i*>(masks.mAlpha.data()));
+
+    auto full = _mm_set1_epi16(256);
+
+    auto round = _mm_set1_epi16(128);
+
+    auto zero = _mm_setzero_si128();
+
+    unsigned x = 0;
+
+    for (; x + 4 <= gatherCount && x * bytesPerPixel + 16 <= rowBytes; x += 4)
+    {
+      std::array<int32_t, 4> pixels0, pixels1;
+
+      for (unsigned i = 0; i < 4; ++i)
+      {
+        std::memcpy(&pixels0[i], pSource + columnMap.mOffsets[x + i], 4);
+
+        std::memcpy(&pixels1[i], pSource + columnMap.mNextOffsets[x + i], 4);
+      }
+
+      auto value0 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(pixels0.data()));
+
+      auto value1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(pixels1.data()));
+
+      auto weights = _mm_cvtepu16_epi32(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(columnMap.mWeights.data() + x)));
+
+      weights = _mm_or_si128(weights, _mm_slli_epi32(weights, 16));
+
+      auto weightsLow = _mm_unpacklo_epi32(weights, weights);
+
+      auto weightsHigh = _mm_unpackhi_epi32(weights, weights);
+
+      auto low = _mm_srli_epi16(
+        _mm_add_epi16(
+          _mm_add_epi16(
+            _mm_mullo_epi16(
+              _mm_unpacklo_epi8(value0, zero),
+              _mm_sub_epi16(full, weightsLow)),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(value1, zero), weightsLow)),
+          round),
+        8);
+
+      auto high = _mm_srli_epi16(
+        _mm_add_epi16(
+          _mm_add_epi16(
+            _mm_mullo_epi16(
+              _mm_unpackhi_epi8(value0, zero),
+              _mm_sub_epi16(full, weightsHigh)),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(value1, zero), weightsHigh)),
+          round),
+        8);
+
+      auto value = _mm_or_si128(
+        _mm_shuffle_epi8(_mm_packus_epi16(low, high), shuffle),
+        alpha);
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pDestination + x * bytesPerPixel),
+        value);
+    }
+    return x;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  __attribute__((target("avx2")))
+  unsigned BilinearRowAvx2(
+    const uint8_t* pSource,
+    const ColumnMap& columnMap,
+    unsigned gatherCount,
+    uint8_t* pDestination,
+    std::size_t rowBytes,
+    unsigned bytesPerPixel,
+    const ShuffleMasks& masks)
+  {
+    auto shuffle = _mm256_load_si256(
+      reinterpret_cast<const __m256i*>(masks.mShuffle.data()));
+
+    auto alpha = _mm256_load_si256(
+      reinterpret_cast<const __m256i*>(masks.mAlpha.data()));
+
+    auto full = _mm256_set1_epi16(256);
+
+    auto round = _mm256_set1_epi16(128);
+
+    auto zero = _mm256_setzero_si256();
+
+    auto pBase = reinterpret_cast<const int*>(pSource);
+
+    auto laneBytes = 4 * bytesPerPixel;
+
+    unsigned x = 0;
+
+    for (;
+      x + 8 <= gatherCount && x * bytesPerPixel + laneBytes + 16 <= rowBytes;
+      x += 8)
+    {
+      auto value0 = _mm256_i32gather_epi32(
+        pBase,
+        _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(columnMap.mOffsets.data() + x)),
+        1);
+
+      auto value1 = _mm256_i32gather_epi32(
+        pBase,
+        _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(columnMap.mNextOffsets.data() + x)),
+        1);
+
+      auto weights = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(columnMap.mWeights.data() + x)));
+
+      weights = _mm256_or_si256(weights, _mm256_slli_epi32(weights, 16));
+
+      auto weightsLow = _mm256_unpacklo_epi32(weights, weights);
+
+      auto weightsHigh = _mm256_unpackhi_epi32(weights, weights);
+
+      auto low = _mm256_srli_epi16(
+        _mm256_add_epi16(
+          _mm256_add_epi16(
+            _mm256_mullo_epi16(
+              _mm256_unpacklo_epi8(value0, zero),
+              _mm256_sub_epi16(full, weightsLow)),
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(value1, zero), weightsLow)),
+          round),
+        8);
+
+      auto high = _mm256_srli_epi16(
+        _mm256_add_epi16(
+          _mm256_add_epi16(
+            _mm256_mullo_epi16(
+              _mm256_unpackhi_epi8(value0, zero),
+              _mm256_sub_epi16(full, weightsHigh)),
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(value1, zero), weightsHigh)),
+          round),
+        8);
+
+      auto value = _mm256_or_si256(
+        _mm256_shuffle_epi8(_mm256_packus_epi16(low, high), shuffle),
+        alpha);
+
+      auto pPixel = pDestination + x * bytesPerPixel;
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pPixel),
+        _mm256_castsi256_si128(value));
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pPixel + laneBytes),
+        _mm256_extracti128_si256(value, 1));
+    }
+    return x;
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Where the channels of a pixel of a source in a non mosaic encoding are.
+  //----------------------------------------------------------------------------
+  PixelLayout GetSourceLayout(PixelEncoding encoding)
+  {
+    switch (encoding)
+    {
+      case PixelEncoding::Bgr8:
+        return {3, 2, 1, 0, -1};
+      case PixelEncoding::Rgba8:
+        return {4, 0, 1, 2, 3};
+      case PixelEncoding::Bgra8:
+        return {4, 2, 1, 0, 3};
+      default:
+        return {3, 0, 1, 2, -1};
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Reflects an index just outside [0, size) back inside without changing
+  // its parity, so a Bayer site's mirror is the same colour.
+  //----------------------------------------------------------------------------
+  unsigned Reflect(int index, unsigned size)
+  {
+    if (index < 0)
+    {
+      return std::min(1u, size - 1);
+    }
+    if (index >= static_cast<int>(size))
+    {
+      return size >= 2 ? size - 2 : 0;
+    }
+    return static_cast<unsigned>(index);
+  }
+
+  //----------------------------------------------------------------------------
+  // All the conversion kernels write columns [begin, end) of a row as packed
+  // RGB starting at pDestination, the SIMD ones return where they stopped.
+  //----------------------------------------------------------------------------
+  void SwizzleRowScalar(
+    const uint8_t* pRow,
+    const PixelLayout& layout,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    for (auto x = begin; x < end; ++x)
+    {
+      auto pPixel = pRow + x * layout.mBytesPerPixel;
+
+      auto pRgb = pDestination + (x - begin) * 3;
+
+      pRgb[0] = pPixel[layout.mRed];
+
+      pRgb[1] = pPixel[layout.mGreen];
+
+      pRgb[2] = pPixel[layout.mBlue];
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void ExpandMono8Scalar(
+    const uint8_t* pRow,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    for (auto x = begin; x < end; ++x)
+    {
+      auto pRgb = pDestination + (x - begin) * 3;
+
+      pRgb[0] = pRgb[1] = pRgb[2] = pRow[x];
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void ExpandMono16Scalar(
+    const uint8_t* pRow,
+    unsigned shift,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    for (auto x = begin; x < end; ++x)
+    {
+      unsigned value = pRow[2 * x] | (pRow[2 * x + 1] << 8);
+
+      auto pRgb = pDestination + (x - begin) * 3;
+
+      pRgb[0] = pRgb[1] = pRgb[2] =
+        static_cast<uint8_t>(std::min(value >> shift, 255u));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Bilinear demosaic of an RGGB row given the rows either side.  A site's
+  // own colour is kept, the others are the mean of the nearest sites of
+  // that colour: left and right, above and below, the four across or the
+  // four diagonal.
+  //----------------------------------------------------------------------------
+  void DemosaicRowScalar(
+    const uint8_t* pAbove,
+    const uint8_t* pRow,
+    const uint8_t* pBelow,
+    unsigned width,
+    bool isRedRow,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    for (auto x = begin; x < end; ++x)
+    {
+      auto left = Reflect(static_cast<int>(x) - 1, width);
+
+      auto right = Reflect(static_cast<int>(x) + 1, width);
+
+      unsigned centre = pRow[x];
+
+      unsigned sides = pRow[left] + pRow[right];
+
+      unsigned upDown = pAbove[x] + pBelow[x];
+
+      unsigned horizontal = (sides + 1) >> 1;
+
+      unsigned vertical = (upDown + 1) >> 1;
+
+      unsigned cross = (sides + upDown + 2) >> 2;
+
+      unsigned diagonal =
+        (pAbove[left] + pAbove[right] + pBelow[left] + pBelow[right] + 2) >> 2;
+
+      auto pRgb = pDestination + (x - begin) * 3;
+
+      auto isEven = x % 2 == 0;
+
+      if (isRedRow)
+      {
+        pRgb[0] = isEven ? centre : horizontal;
+
+        pRgb[1] = isEven ? cross : centre;
+
+        pRgb[2] = isEven ? diagonal : vertical;
+      }
+      else
+      {
+        pRgb[0] = isEven ? vertical : diagonal;
+
+        pRgb[1] = isEven ? centre : cross;
+
+        pRgb[2] = isEven ? horizontal : centre;
+      }
+    }
+  }
+
+#ifdef GUISTUFF_X86_SIMD
+  //----------------------------------------------------------------------------
+  // Four pixels a step, each store writes 16 bytes but advances by 12.  The
+  // expansions are bound by memory so have no AVX2 version.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  unsigned SwizzleRowSse41(
+    const uint8_t* pRow,
+    const PixelLayout& layout,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    alignas(16) std::array<uint8_t, 16> mask;
+
+    mask.fill(0x80);
+
+    for (unsigned iPixel = 0; iPixel < 4; ++iPixel)
+    {
+      auto pixel = iPixel * layout.mBytesPerPixel;
+
+      mask[iPixel * 3] = static_cast<uint8_t>(pixel + layout.mRed);
+
+      mask[iPixel * 3 + 1] = static_cast<uint8_t>(pixel + layout.mGreen);
+
+      mask[iPixel * 3 + 2] = static_cast<uint8_t>(pixel + layout.mBlue);
+    }
+
+    auto shuffle =
+      _mm_load_si128(reinterpret_cast<const __m128i*>(mask.data()));
+
+    auto x = begin;
+
+    // six pixels of room covers both the 16 byte load and store
+    for (; x + 6 <= end; x += 4)
+    {
+      auto pixels = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(pRow + x * layout.mBytesPerPixel));
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pDestination + (x - begin) * 3),
+        _mm_shuffle_epi8(pixels, shuffle));
+    }
+    return x;
+  }
+
+  //----------------------------------------------------------------------------
+  // Writes 16 grey pixels as 48 bytes of RGB.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  void StoreGreySse41(__m128i grey, uint8_t* pDestination)
+  {
+    auto pOut = reinterpret_cast<__m128i*>(pDestination);
+
+    _mm_storeu_si128(
+      pOut,
+      _mm_shuffle_epi8(
+        grey,
+        _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5)));
+
+    _mm_storeu_si128(
+      pOut + 1,
+      _mm_shuffle_epi8(
+        grey,
+        _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10)));
+
+    _mm_storeu_si128(
+      pOut + 2,
+      _mm_shuffle_epi8(
+        grey,
+        _mm_setr_epi8(
+          10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15)));
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  unsigned ExpandMono8Sse41(
+    const uint8_t* pRow,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    auto x = begin;
+
+    for (; x + 16 <= end; x += 16)
+    {
+      StoreGreySse41(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow + x)),
+        pDestination + (x - begin) * 3);
+    }
+    return x;
+  }
+
+  //----------------------------------------------------------------------------
+  // The unsigned min keeps values with bits above the significant ones from
+  // wrapping in the signed pack.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  unsigned ExpandMono16Sse41(
+    const uint8_t* pRow,
+    unsigned shift,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    auto shiftCount = _mm_cvtsi32_si128(static_cast<int>(shift));
+
+    auto maximum = _mm_set1_epi16(255);
+
+    auto x = begin;
+
+    for (; x + 16 <= end; x += 16)
+    {
+      auto pPixels = reinterpret_cast<const __m128i*>(pRow + 2 * x);
+
+      auto low = _mm_min_epu16(
+        _mm_srl_epi16(_mm_loadu_si128(pPixels), shiftCount),
+        maximum);
+
+      auto high = _mm_min_epu16(
+        _mm_srl_epi16(_mm_loadu_si128(pPixels + 1), shiftCount),
+        maximum);
+
+      StoreGreySse41(
+        _mm_packus_epi16(low, high),
+        pDestination + (x - begin) * 3);
+    }
+    return x;
+  }
+
+  //----------------------------------------------------------------------------
+  // pshufb masks interleaving eight red and green bytes (packed in one
+  // register) and eight blue bytes into 24 bytes of RGB.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  void GetInterleaveMasksSse41(__m128i masks[4])
+  {
+    masks[0] = _mm_setr_epi8(
+      0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+
+    masks[1] = _mm_setr_epi8(
+      -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+
+    masks[2] = _mm_setr_epi8(
+      13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    masks[3] = _mm_setr_epi8(
+      -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+  }
+
+  //----------------------------------------------------------------------------
+  // Eight pixels a step, from the first even column with a left neighbour
+  // while the right neighbours are inside the row.  Lanes alternate between
+  // the two site colours of the row so blends pick each lane's formula.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  unsigned DemosaicRowSse41(
+    const uint8_t* pAbove,
+    const uint8_t* pRow,
+    const uint8_t* pBelow,
+    unsigned width,
+    bool isRedRow,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    __m128i masks[4];
+
+    GetInterleaveMasksSse41(masks);
+
+    auto one = _mm_set1_epi16(1);
+
+    auto two = _mm_set1_epi16(2);
+
+    auto x = begin;
+
+    for (; x + 8 <= end && x + 9 <= width; x += 8)
+    {
+      auto load = [x] (const uint8_t* p, int offset)
+      {
+        return reinterpret_cast<const __m128i*>(p + x + offset);
+      };
+
+      auto aboveLeft = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pAbove, -1)));
+
+      auto above = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pAbove, 0)));
+
+      auto aboveRight = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pAbove, 1)));
+
+      auto left = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pRow, -1)));
+
+      auto centre = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pRow, 0)));
+
+      auto right = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pRow, 1)));
+
+      auto belowLeft = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pBelow, -1)));
+
+      auto below = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pBelow, 0)));
+
+      auto belowRight = _mm_cvtepu8_epi16(_mm_loadl_epi64(load(pBelow, 1)));
+
+      auto sides = _mm_add_epi16(left, right);
+
+      auto upDown = _mm_add_epi16(above, below);
+
+      auto horizontal = _mm_srli_epi16(_mm_add_epi16(sides, one), 1);
+
+      auto vertical = _mm_srli_epi16(_mm_add_epi16(upDown, one), 1);
+
+      auto cross = _mm_srli_epi16(
+        _mm_add_epi16(_mm_add_epi16(sides, upDown), two),
+        2);
+
+      auto diagonal = _mm_srli_epi16(
+        _mm_add_epi16(
+          _mm_add_epi16(
+            _mm_add_epi16(aboveLeft, aboveRight),
+            _mm_add_epi16(belowLeft, belowRight)),
+          two),
+        2);
+
+      __m128i red, green, blue;
+
+      if (isRedRow)
+      {
+        red = _mm_blend_epi16(centre, horizontal, 0xaa);
+
+        green = _mm_blend_epi16(cross, centre, 0xaa);
+
+        blue = _mm_blend_epi16(diagonal, vertical, 0xaa);
+      }
+      else
+      {
+        red = _mm_blend_epi16(vertical, diagonal, 0xaa);
+
+        green = _mm_blend_epi16(centre, cross, 0xaa);
+
+        blue = _mm_blend_epi16(horizontal, centre, 0xaa);
+      }
+
+      auto redGreen = _mm_packus_epi16(red, green);
+
+      auto blues = _mm_packus_epi16(blue, blue);
+
+      auto pRgb = pDestination + (x - begin) * 3;
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pRgb),
+        _mm_or_si128(
+          _mm_shuffle_epi8(redGreen, masks[0]),
+          _mm_shuffle_epi8(blues, masks[1])));
+
+      _mm_storel_epi64(
+        reinterpret_cast<__m128i*>(pRgb + 16),
+        _mm_or_si128(
+          _mm_shuffle_epi8(redGreen, masks[2]),
+          _mm_shuffle_epi8(blues, masks[3])));
+    }
+    return x;
+  }
+
+  //----------------------------------------------------------------------------
+  // Same as the SSE4.1 version with sixteen pixels a step.  The packs work
+  // within each 128 bit lane, so each lane interleaves its own eight pixels
+  // with the same masks.
+  //----------------------------------------------------------------------------
+  __attribute__((target("avx2")))
+  unsigned DemosaicRowAvx2(
+    const uint8_t* pAbove,
+    const uint8_t* pRow,
+    const uint8_t* pBelow,
+    unsigned width,
+    bool isRedRow,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination)
+  {
+    __m128i laneMasks[4];
+
+    GetInterleaveMasksSse41(laneMasks);
+
+    __m256i masks[4];
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+      masks[i] = _mm256_broadcastsi128_si256(laneMasks[i]);
+    }
+
+    auto one = _mm256_set1_epi16(1);
+
+    auto two = _mm256_set1_epi16(2);
+
+    auto x = begin;
+
+    for (; x + 16 <= end && x + 17 <= width; x += 16)
+    {
+      auto load = [x] (const uint8_t* p, int offset)
+      {
+        return reinterpret_cast<const __m128i*>(p + x + offset);
+      };
+
+      auto aboveLeft = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pAbove, -1)));
+
+      auto above = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pAbove, 0)));
+
+      auto aboveRight = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pAbove, 1)));
+
+      auto left = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pRow, -1)));
+
+      auto centre = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pRow, 0)));
+
+      auto right = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pRow, 1)));
+
+      auto belowLeft = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pBelow, -1)));
+
+      auto below = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pBelow, 0)));
+
+      auto belowRight = _mm256_cvtepu8_epi16(_mm_loadu_si128(load(pBelow, 1)));
+
+      auto sides = _mm256_add_epi16(left, right);
+
+      auto upDown = _mm256_add_epi16(above, below);
+
+      auto horizontal = _mm256_srli_epi16(_mm256_add_epi16(sides, one), 1);
+
+      auto vertical = _mm256_srli_epi16(_mm256_add_epi16(upDown, one), 1);
+
+      auto cross = _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(sides, upDown), two),
+        2);
+
+      auto diagonal = _mm256_srli_epi16(
+        _mm256_add_epi16(
+          _mm256_add_epi16(
+            _mm256_add_epi16(aboveLeft, aboveRight),
+            _mm256_add_epi16(belowLeft, belowRight)),
+          two),
+        2);
+
+      __m256i red, green, blue;
+
+      if (isRedRow)
+      {
+        red = _mm256_blend_epi16(centre, horizontal, 0xaa);
+
+        green = _mm256_blend_epi16(cross, centre, 0xaa);
+
+        blue = _mm256_blend_epi16(diagonal, vertical, 0xaa);
+      }
+      else
+      {
+        red = _mm256_blend_epi16(vertical, diagonal, 0xaa);
+
+        green = _mm256_blend_epi16(centre, cross, 0xaa);
+
+        blue = _mm256_blend_epi16(horizontal, centre, 0xaa);
+      }
+
+      auto redGreen = _mm256_packus_epi16(red, green);
+
+      auto blues = _mm256_packus_epi16(blue, blue);
+
+      auto first = _mm256_or_si256(
+        _mm256_shuffle_epi8(redGreen, masks[0]),
+        _mm256_shuffle_epi8(blues, masks[1]));
+
+      auto second = _mm256_or_si256(
+        _mm256_shuffle_epi8(redGreen, masks[2]),
+        _mm256_shuffle_epi8(blues, masks[3]));
+
+      auto pRgb = pDestination + (x - begin) * 3;
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pRgb),
+        _mm256_castsi256_si128(first));
+
+      _mm_storel_epi64(
+        reinterpret_cast<__m128i*>(pRgb + 16),
+        _mm256_castsi256_si128(second));
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(pRgb + 24),
+        _mm256_extracti128_si256(first, 1));
+
+      _mm_storel_epi64(
+        reinterpret_cast<__m128i*>(pRgb + 40),
+        _mm256_extracti128_si256(second, 1));
+    }
+    return x;
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Edges go through the scalar path, which reflects missing neighbours.
+  //----------------------------------------------------------------------------
+  void DemosaicRow(
+    const ImageView& source,
+    unsigned row,
+    unsigned begin,
+    unsigned end,
+    uint8_t* pDestination,
+    [[maybe_unused]] SimdLevel simdLevel)
+  {
+    auto getRow = [&source] (int y)
+    {
+      return source.mpData + Reflect(y, source.mHeight) * source.mStride;
+    };
+
+    auto pAbove = getRow(static_cast<int>(row) - 1);
+
+    auto pRow = getRow(static_cast<int>(row));
+
+    auto pBelow = getRow(static_cast<int>(row) + 1);
+
+    auto isRedRow = row % 2 == 0;
+
+    // the vector loops need an even start with a column to its left
+    auto x = std::min(end, std::max(2u, begin + begin % 2));
+
+    DemosaicRowScalar(
+      pAbove,
+      pRow,
+      pBelow,
+      source.mWidth,
+      isRedRow,
+      begin,
+      x,
+      pDestination);
+
+#ifdef GUISTUFF_X86_SIMD
+    // AVX2 leaves up to 15 columns the SSE4.1 loop can still take some of
+    if (simdLevel == SimdLevel::Avx2)
+    {
+      x = DemosaicRowAvx2(
+        pAbove,
+        pRow,
+        pBelow,
+        source.mWidth,
+        isRedRow,
+        x,
+        end,
+        pDestination + (x - begin) * 3);
+    }
+    if (simdLevel != SimdLevel::None)
+    {
+      x = DemosaicRowSse41(
+        pAbove,
+        pRow,
+        pBelow,
+        source.mWidth,
+        isRedRow,
+        x,
+        end,
+        pDestination + (x - begin) * 3);
+    }
+#endif
+
+    DemosaicRowScalar(
+      pAbove,
+      pRow,
+      pBelow,
+      source.mWidth,
+      isRedRow,
+      x,
+      end,
+      pDestination + (x - begin) * 3);
+  }
+
+  //----------------------------------------------------------------------------
+  // Hands the kernels source rows as packed RGB, columns [first, last) only
+  // with GetFirstColumn at offset 0.  Rgb8 rows are read in place, anything
+  // else is converted into one of two thread local rows so a bilinear pass
+  // can hold the pair it blends and repeated rows aren't converted again.
+  //----------------------------------------------------------------------------
+  class SourceRows
+  {
+    public:
+
+      SourceRows(const ImageView& source, unsigned first, unsigned last)
+        : mSource(source),
+          mFirst(first),
+          mLast(last),
+          mIsConverted(source.mFormat.mEncoding != PixelEncoding::Rgb8),
+          mBuffers(DoGetBuffers()),
+          mRows{cNoRow, cNoRow},
+          mNewest(0)
+      {
+        if (mIsConverted)
+        {
+          for (auto& buffer : mBuffers)
+          {
+            buffer.resize(std::size_t(mLast - mFirst) * 3);
+          }
+        }
+      }
+
+      unsigned GetFirstColumn() const
+      {
+        return mFirst;
+      }
+
+      unsigned GetWidth() const
+      {
+        return mLast - mFirst;
+      }
+
+      const uint8_t* Get(unsigned row)
+      {
+        if (!mIsConverted)
+        {
+          return mSource.mpData + row * mSource.mStride + mFirst * 3;
+        }
+
+        if (mRows[mNewest] != row)
+        {
+          // the other row is either the one wanted or the older one
+          mNewest = 1 - mNewest;
+
+          if (mRows[mNewest] != row)
+          {
+            gs::ConvertRow(
+              mSource,
+              row,
+              mFirst,
+              mLast,
+              mBuffers[mNewest].data());
+
+            mRows[mNewest] = row;
+          }
+        }
+        return mBuffers[mNewest].data();
+      }
+
+    private:
+
+      static std::array<std::vector<uint8_t>, 2>& DoGetBuffers()
+      {
+        thread_local std::array<std::vector<uint8_t>, 2> buffers;
+
+        return buffers;
+      }
+
+      static constexpr unsigned cNoRow = ~0u;
+
+      const ImageView& mSource;
+
+      unsigned mFirst;
+
+      unsigned mLast;
+
+      bool mIsConverted;
+
+      std::array<std::vector<uint8_t>, 2>& mBuffers;
+
+      std::array<unsigned, 2> mRows;
+
+      unsigned mNewest;
+  };
+
+  //----------------------------------------------------------------------------
+  // Makes column offsets relative to the first column SourceRows hands out.
+  //----------------------------------------------------------------------------
+  void RebaseColumns(std::vector<int32_t>& offsets, unsigned firstColumn)
+  {
+    auto firstByte = static_cast<int32_t>(firstColumn * 3);
+
+    for (auto& offset : offsets)
+    {
+      offset -= firstByte;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void ScaleNearest(
+    const ImageView& source,
+    uint8_t* pDestination,
+    unsigned width,
+    unsigned height,
+    std::ptrdiff_t stride,
+    const PixelLayout& layout,
+    const ScaleMapping& mapping,
+    SimdLevel simdLevel)
+  {
+    thread_local ColumnMap columnMap;
+
+    MapNearestColumns(
+      source.mWidth,
+      mapping.mX,
+      mapping.mStepX,
+      width,
+      columnMap);
+
+    SourceRows rows(
+      source,
+      columnMap.mOffsets.front() / 3,
+      columnMap.mOffsets.back() / 3 + 1);
+
+    RebaseColumns(columnMap.mOffsets, rows.GetFirstColumn());
+
+    [[maybe_unused]] auto gatherCount =
+      GetGatherCount(columnMap.mOffsets, rows.GetWidth());
+
+    ShuffleMasks masks;
+
+    if (simdLevel != SimdLevel::None)
+    {
+      masks = MakeShuffleMasks(layout);
+    }
+
+    [[maybe_unused]] std::size_t rowBytes =
+      std::size_t(width) * layout.mBytesPerPixel;
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+      auto sourceY = MapNearest(source.mHeight, mapping.mY, mapping.mStepY, y);
+
+      auto pSourceRow = rows.Get(sourceY);
+
+      auto pRow = pDestination + y * stride;
+
+      unsigned x = 0;
+
+#ifdef GUISTUFF_X86_SIMD
+      if (simdLevel == SimdLevel::Avx2)
+      {
+        x = NearestRowAvx2(
+          pSourceRow,
+          columnMap.mOffsets.data(),
+          gatherCount,
+          pRow,
+          rowBytes,
+          layout.mBytesPerPixel,
+          masks);
+      }
+      else if (simdLevel == SimdLevel::Sse41)
+      {
+        x = NearestRowSse41(
+          pSourceRow,
+          columnMap.mOffsets.data(),
+          gatherCount,
+          pRow,
+          rowBytes,
+          layout.mBytesPerPixel,
+          masks);
+      }
+#endif
+
+      NearestRowScalar(
+        pSourceRow,
+        columnMap.mOffsets.data(),
+        x,
+        width,
+        pRow,
+        layout);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Separable: the two source rows are blended into a scratch row, then each
+  // destination pixel blends two columns of the scratch row.
+  //----------------------------------------------------------------------------
+  void ScaleBilinear(
+    const ImageView& source,
+    uint8_t* pDestination,
+    unsigned width,
+    unsigned height,
+    std::ptrdiff_t stride,
+    const PixelLayout& layout,
+    const ScaleMapping& mapping,
+    SimdLevel simdLevel)
+  {
+    thread_local ColumnMap columnMap;
+
+    thread_local std::vector<uint8_t> blendedRow;
+
+    MapBilinearColumns(
+      source.mWidth,
+      mapping.mX,
+      mapping.mStepX,
+      width,
+      columnMap);
+
+    SourceRows rows(
+      source,
+      columnMap.mOffsets.front() / 3,
+      columnMap.mNextOffsets.back() / 3 + 1);
+
+    RebaseColumns(columnMap.mOffsets, rows.GetFirstColumn());
+
+    RebaseColumns(columnMap.mNextOffsets, rows.GetFirstColumn());
+
+    [[maybe_unused]] auto gatherCount =
+      GetGatherCount(columnMap.mNextOffsets, rows.GetWidth());
+
+    ShuffleMasks masks;
+
+    if (simdLevel != SimdLevel::None)
+    {
+      masks = MakeShuffleMasks(layout);
+    }
+
+    [[maybe_unused]] std::size_t rowBytes =
+      std::size_t(width) * layout.mBytesPerPixel;
+
+    // only the columns some destination pixel reads are blended
+    std::size_t sourceRowBytes = std::size_t(rows.GetWidth()) * 3;
+
+    blendedRow.resize(sourceRowBytes);
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+      unsigned first, second;
+
+      uint16_t weight;
+
+      MapBilinear(
+        source.mHeight,
+        mapping.mY,
+        mapping.mStepY,
+        y,
+        first,
+        second,
+        weight);
+
+      auto pRow0 = rows.Get(first);
+
+      const uint8_t* pBlended = pRow0;
+
+      if (weight != 0)
+      {
+        auto pRow1 = rows.Get(second);
+
+        std::size_t i = 0;
+
+#ifdef GUISTUFF_X86_SIMD
+        if (simdLevel == SimdLevel::Avx2)
+        {
+          i = BlendRowsAvx2(
+            pRow0,
+            pRow1,
+            weight,
+            sourceRowBytes,
+            blendedRow.data());
+        }
+        else if (simdLevel == SimdLevel::Sse41)
+        {
+          i = BlendRowsSse41(
+            pRow0,
+            pRow1,
+            weight,
+            sourceRowBytes,
+            blendedRow.data());
+        }
+#endif
+
+        BlendRowsScalar(
+          pRow0,
+          pRow1,
+          weight,
+          i,
+          sourceRowBytes,
+          blendedRow.data());
+
+        pBlended = blendedRow.data();
+      }
+
+      auto pRow = pDestination + y * stride;
+
+      unsigned x = 0;
+
+#ifdef GUISTUFF_X86_SIMD
+      if (simdLevel == SimdLevel::Avx2)
+      {
+        x = BilinearRowAvx2(
+          pBlended,
+          columnMap,
+          gatherCount,
+          pRow,
+          rowBytes,
+          layout.mBytesPerPixel,
+          masks);
+      }
+      else if (simdLevel == SimdLevel::Sse41)
+      {
+        x = BilinearRowSse41(
+          pBlended,
+          columnMap,
+          gatherCount,
+          pRow,
+          rowBytes,
+          layout.mBytesPerPixel,
+          masks);
+      }
+#endif
+
+      BilinearRowScalar(pBlended, columnMap, x, width, pRow, layout);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Source pixels [first, last) covered by destination pixel x, never empty.
+  //----------------------------------------------------------------------------
+  void MapBox(
+    unsigned sourceSize,
+    double origin,
+    double step,
+    unsigned x,
+    unsigned& first,
+    unsigned& last)
+  {
+    auto maximum = static_cast<double>(sourceSize - 1);
+
+    first = static_cast<unsigned>(
+      std::clamp(std::floor(origin + x * step), 0.0, maximum));
+
+    last = static_cast<unsigned>(
+      std::clamp(std::floor(origin + (x + 1) * step), 0.0, maximum + 1));
+
+    last = std::max(last, first + 1);
+  }
+
+  // 257 rows of 255 still fit in the 16 bit column sums.
+  constexpr unsigned cBoxRowsPerPass = 257;
+
+  //----------------------------------------------------------------------------
+  // Adds a row of bytes into 16 bit sums, returns how many were done.
+  //----------------------------------------------------------------------------
+#ifdef GUISTUFF_X86_SIMD
+  __attribute__((target("sse4.1")))
+  std::size_t AccumulateRowSse41(
+    const uint8_t* pRow,
+    std::size_t size,
+    uint16_t* pSums)
+  {
+    auto zero = _mm_setzero_si128();
+
+    std::size_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+      auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow + i));
+
+      auto pLow = reinterpret_cast<__m128i*>(pSums + i);
+
+      auto pHigh = reinterpret_cast<__m128i*>(pSums + i + 8);
+
+      _mm_storeu_si128(
+        pLow,
+        _mm_add_epi16(_mm_loadu_si128(pLow), _mm_unpacklo_epi8(bytes, zero)));
+
+      _mm_storeu_si128(
+        pHigh,
+        _mm_add_epi16(_mm_loadu_si128(pHigh), _mm_unpackhi_epi8(bytes, zero)));
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  __attribute__((target("avx2")))
+  std::size_t AccumulateRowAvx2(
+    const uint8_t* pRow,
+    std::size_t size,
+    uint16_t* pSums)
+  {
+    std::size_t i = 0;
+
+    for (; i + 32 <= size; i += 32)
+    {
+      auto low = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow + i)));
+
+      auto high = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow + i + 16)));
+
+      auto pLow = reinterpret_cast<__m256i*>(pSums + i);
+
+      auto pHigh = reinterpret_cast<__m256i*>(pSums + i + 16);
+
+      _mm256_storeu_si256(
+        pLow,
+        _mm256_add_epi16(_mm256_loadu_si256(pLow), low));
+
+      _mm256_storeu_si256(
+        pHigh,
+        _mm256_add_epi16(_mm256_loadu_si256(pHigh), high));
+    }
+    return i;
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Averages every source pixel under each destination pixel.  Up to
+  // cBoxRowsPerPass rows under a destination row are added into 16 bit
+  // per column sums, then each destination pixel adds up its columns.
+  // Footprints of neighbouring destination pixels don't overlap when
+  // shrinking so each source pixel is read once, straight out of the
+  // source.
+  //----------------------------------------------------------------------------
+  void ScaleBox(
+    const ImageView& source,
+    uint8_t* pDestination,
+    unsigned width,
+    unsigned height,
+    std::ptrdiff_t stride,
+    const PixelLayout& layout,
+    const ScaleMapping& mapping,
+    [[maybe_unused]] SimdLevel simdLevel)
+  {
+    thread_local std::vector<unsigned> columns;
+
+    thread_local std::vector<uint16_t> columnSums;
+
+    thread_local std::vector<uint64_t> pixelSums;
+
+    columns.resize(std::size_t(width) * 2);
+
+    for (unsigned x = 0; x < width; ++x)
+    {
+      MapBox(
+        source.mWidth,
+        mapping.mX,
+        mapping.mStepX,
+        x,
+        columns[2 * x],
+        columns[2 * x + 1]);
+    }
+
+    // only the columns some destination pixel covers are summed
+    std::size_t firstByte = std::size_t(columns.front()) * 3;
+
+    std::size_t lastByte = std::size_t(columns.back()) * 3;
+
+    SourceRows rows(source, columns.front(), columns.back());
+
+    columnSums.resize(std::size_t(source.mWidth) * 3);
+
+    pixelSums.resize(std::size_t(width) * 3);
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+      unsigned firstRow, lastRow;
+
+      MapBox(source.mHeight, mapping.mY, mapping.mStepY, y, firstRow, lastRow);
+
+      std::fill(pixelSums.begin(), pixelSums.end(), 0);
+
+      for (auto passRow = firstRow; passRow < lastRow;)
+      {
+        auto passEnd = std::min(lastRow, passRow + cBoxRowsPerPass);
+
+        auto pSums = columnSums.data() + firstByte;
+
+        auto size = lastByte - firstByte;
+
+        std::fill(pSums, pSums + size, 0);
+
+        for (; passRow < passEnd; ++passRow)
+        {
+          auto pSourceRow = rows.Get(passRow);
+
+          std::size_t i = 0;
+
+#ifdef GUISTUFF_X86_SIMD
+          if (simdLevel == SimdLevel::Avx2)
+          {
+            i = AccumulateRowAvx2(pSourceRow, size, pSums);
+          }
+          else if (simdLevel == SimdLevel::Sse41)
+          {
+            i = AccumulateRowSse41(pSourceRow, size, pSums);
+          }
+#endif
+
+          for (; i < size; ++i)
+          {
+            pSums[i] += pSourceRow[i];
+          }
+        }
+
+        for (unsigned x = 0; x < width; ++x)
+        {
+          auto pPixelSum = &pixelSums[x * 3];
+
+          for (
+            auto i = columns[2 * x] * 3;
+            i < columns[2 * x + 1] * 3;
+            i += 3)
+          {
+            pPixelSum[0] += columnSums[i];
+
+            pPixelSum[1] += columnSums[i + 1];
+
+            pPixelSum[2] += columnSums[i + 2];
+          }
+        }
+      }
+
+      auto pRow = pDestination + y * stride;
+
+      for (unsigned x = 0; x < width; ++x)
+      {
+        uint64_t count =
+          uint64_t(columns[2 * x + 1] - columns[2 * x]) * (lastRow - firstRow);
+
+        auto pPixelSum = &pixelSums[x * 3];
+
+        WritePixel(
+          pRow + x * layout.mBytesPerPixel,
+          static_cast<uint8_t>((pPixelSum[0] + count / 2) / count),
+          static_cast<uint8_t>((pPixelSum[1] + count / 2) / count),
+          static_cast<uint8_t>((pPixelSum[2] + count / 2) / count),
+          layout);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned gs::GetBytesPerPixel(const PixelFormat& format)
+{
+  switch (format.mEncoding)
+  {
+    case PixelEncoding::Mono8:
+    case PixelEncoding::BayerRg8:
+      return 1;
+    case PixelEncoding::Mono16:
+      return 2;
+    default:
+      return GetSourceLayout(format.mEncoding).mBytesPerPixel;
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void gs::ConvertRow(
+  const ImageView& source,
+  unsigned row,
+  unsigned first,
+  unsigned last,
+  uint8_t* pDestination)
+{
+  if (first >= last)
+  {
+    return;
+  }
+
+  auto simdLevel = GetSimdLevel();
+
+  auto pRow = source.mpData + row * source.mStride;
+
+  auto x = first;
+
+  switch (source.mFormat.mEncoding)
+  {
+    case PixelEncoding::Rgb8:
+      std::memcpy(
+        pDestination,
+        pRow + first * 3,
+        std::size_t(last - first) * 3);
+      break;
+
+    case PixelEncoding::Mono8:
+#ifdef GUISTUFF_X86_SIMD
+      if (simdLevel != SimdLevel::None)
+      {
+        x = ExpandMono8Sse41(pRow, first, last, pDestination);
+      }
+#endif
+      ExpandMono8Scalar(pRow, x, last, pDestination + (x - first) * 3);
+      break;
+
+    case PixelEncoding::Mono16:
+    {
+      auto shift = std::clamp(source.mFormat.mSignificantBits, 8u, 16u) - 8;
+
+#ifdef GUISTUFF_X86_SIMD
+      if (simdLevel != SimdLevel::None)
+      {
+        x = ExpandMono16Sse41(pRow, shift, first, last, pDestination);
+      }
+#endif
+      ExpandMono16Scalar(
+        pRow,
+        shift,
+        x,
+        last,
+        pDestination + (x - first) * 3);
+      break;
+    }
+
+    case PixelEncoding::BayerRg8:
+      DemosaicRow(source, row, first, last, pDestination, simdLevel);
+      break;
+
+    default:
+    {
+      auto layout = GetSourceLayout(source.mFormat.mEncoding);
+
+#ifdef GUISTUFF_X86_SIMD
+      if (simdLevel != SimdLevel::None)
+      {
+        x = SwizzleRowSse41(pRow, layout, first, last, pDestination);
+      }
+#endif
+      SwizzleRowScalar(pRow, layout, x, last, pDestination + (x - first) * 3);
+      break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void gs::ScaleImage(
+  const ImageView& source,
+  uint8_t* pDestination,
+  unsigned width,
+  unsigned height,
+  std::ptrdiff_t stride,
+  const PixelLayout& layout,
+  ScaleFilter filter)
+{
+  if (width == 0 || height == 0)
+  {
+    return;
+  }
+
+  ScaleImage(
+    source,
+    pDestination,
+    width,
+    height,
+    stride,
+    layout,
+    filter,
+    {
+      0.0,
+      0.0,
+      static_cast<double>(source.mWidth) / width,
+      static_cast<double>(source.mHeight) / height});
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void gs::ScaleImage(
+  const ImageView& source,
+  uint8_t* pDestination,
+  unsigned width,
+  unsigned height,
+  std::ptrdiff_t stride,
+  const PixelLayout& layout,
+  ScaleFilter filter,
+  const ScaleMapping& mapping)
+{
+  if (
+    width == 0 || height == 0 || source.mWidth == 0 || source.mHeight == 0)
+  {
+    return;
+  }
+
+  auto simdLevel = IsSimdLayout(layout) ? GetSimdLevel() : SimdLevel::None;
+
+  if (filter == ScaleFilter::Box)
+  {
+    ScaleBox(
+      source,
+      pDestination,
+      width,
+      height,
+      stride,
+      layout,
+      mapping,
+      GetSimdLevel());
+  }
+  else if (filter == ScaleFilter::Bilinear)
+  {
+    ScaleBilinear(
+      source,
+      pDestination,
+      width,
+      height,
+      stride,
+      layout,
+      mapping,
+      simdLevel);
+  }
+  else
+  {
+    ScaleNearest(
+      source,
+      pDestination,
+      width,
+      height,
+      stride,
+      layout,
+      mapping,
+      simdLevel);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool gs::ScaleImage(
+  const ImageView& source,
+  wxBitmap& bitmap,
+  ScaleFilter filter)
+{
+  auto size = bitmap.GetSize();
+
+  if (size.GetWidth() <= 0 || size.GetHeight() <= 0)
+  {
+    return false;
+  }
+
+  return ScaleImage(
+    source,
+    bitmap,
+    filter,
+    {
+      0.0,
+      0.0,
+      static_cast<double>(source.mWidth) / size.GetWidth(),
+      static_cast<double>(source.mHeight) / size.GetHeight()});
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool gs::ScaleImage(
+  const ImageView& source,
+  wxBitmap& bitmap,
+  ScaleFilter filter,
+  const ScaleMapping& mapping)
+{
+  return ScaleImage(source, bitmap, wxRect(bitmap.GetSize()), filter, mapping);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool gs::ScaleImage(
+  const ImageView& source,
+  wxBitmap& bitmap,
+  const wxRect& area,
+  ScaleFilter filter,
+  const ScaleMapping& mapping)
+{
+  wxNativePixelData data(bitmap);
+
+  if (!data)
+  {
+    return false;
+  }
+
+  auto clipped = area.Intersect(wxRect(data.GetSize()));
+
+  if (clipped.IsEmpty())
+  {
+    return true;
+  }
+
+  auto layout = MakePixelLayout<wxNativePixelFormat>();
+
+  wxNativePixelData::Iterator pixels(data);
+
+  ScaleImage(
+    source,
+    reinterpret_cast<uint8_t*>(pixels.m_ptr) +
+      clipped.GetY() * data.GetRowStride() +
+      clipped.GetX() * std::ptrdiff_t(layout.mBytesPerPixel),
+    clipped.GetWidth(),
+    clipped.GetHeight(),
+    data.GetRowStride(),
+    layout,
+    filter,
+    {
+      mapping.mX + (clipped.GetX() - area.GetX()) * mapping.mStepX,
+      mapping.mY + (clipped.GetY() - area.GetY()) * mapping.mStepY,
+      mapping.mStepX,
+      mapping.mStepY});
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Rows are visited away from the direction of travel so none is overwritten
+// before it has been moved.
+//------------------------------------------------------------------------------
+bool gs::ShiftBitmap(wxBitmap& bitmap, const wxPoint& offset)
+{
+  wxNativePixelData data(bitmap);
+
+  if (!data)
+  {
+    return false;
+  }
+
+  auto width = data.GetWidth();
+
+  auto height = data.GetHeight();
+
+  if (std::abs(offset.x) >= width || std::abs(offset.y) >= height)
+  {
+    return true;
+  }
+
+  std::ptrdiff_t bytesPerPixel = wxNativePixelFormat::BitsPerPixel / 8;
+
+  auto stride = data.GetRowStride();
+
+  wxNativePixelData::Iterator pixels(data);
+
+  auto pData = reinterpret_cast<uint8_t*>(pixels.m_ptr);
+
+  auto rowBytes = (width - std::abs(offset.x)) * bytesPerPixel;
+
+  auto destinationX = std::max(offset.x, 0) * bytesPerPixel;
+
+  auto sourceX = std::max(-offset.x, 0) * bytesPerPixel;
+
+  auto rowCount = height - std::abs(offset.y);
+
+  for (int i = 0; i < rowCount; ++i)
+  {
+    auto y = offset.y > 0 ? height - 1 - i : i;
+
+    std::memmove(
+      pData + y * stride + destinationX,
+      pData + (y - offset.y) * stride + sourceX,
+      rowBytes);
+  }
+
+  return true;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <wx/bitmap.h>
+#include <wx/gdicmn.h>
+
+#include <cstddef>
+#include <cstdint>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  // Box averages everything under a destination pixel, for thumbnails and
+  // other big reductions where the others would alias.
+  enum class ScaleFilter
+  {
+    Nearest,
+    Bilinear,
+    Box
+  };
+
+  //----------------------------------------------------------------------------
+  // Byte position of each channel within a destination pixel, -1 for a
+  // channel the format doesn't have.
+  //----------------------------------------------------------------------------
+  struct PixelLayout
+  {
+    unsigned mBytesPerPixel;
+
+    int mRed;
+
+    int mGreen;
+
+    int mBlue;
+
+    int mAlpha;
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename NativeFormat>
+  constexpr PixelLayout MakePixelLayout()
+  {
+    return {
+      NativeFormat::BitsPerPixel / 8,
+      NativeFormat::RED,
+      NativeFormat::GREEN,
+      NativeFormat::BLUE,
+      NativeFormat::ALPHA};
+  }
+
+  //----------------------------------------------------------------------------
+  // How a source image's pixels are stored.  Mono16 is little endian,
+  // BayerRg8 is one byte a site in an RGGB mosaic (the top left pixel red).
+  //----------------------------------------------------------------------------
+  enum class PixelEncoding
+  {
+    Rgb8,
+    Bgr8,
+    Rgba8,
+    Bgra8,
+    Mono8,
+    Mono16,
+    BayerRg8
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct PixelFormat
+  {
+    PixelEncoding mEncoding = PixelEncoding::Rgb8;
+
+    // Mono16 only, the low bits in use, so 12 for a 12 bit camera.
+    unsigned mSignificantBits = 16;
+  };
+
+  unsigned GetBytesPerPixel(const PixelFormat& Format);
+
+  //----------------------------------------------------------------------------
+  // Pointing mpData into a larger image and keeping its stride gives a sub
+  // image.  Anything other than Rgb8 is converted as it is scaled, only the
+  // source rows and columns the destination shows are ever converted.
+  //----------------------------------------------------------------------------
+  struct ImageView
+  {
+    const uint8_t* mpData;
+
+    unsigned mWidth;
+
+    unsigned mHeight;
+
+    std::size_t mStride;
+
+    PixelFormat mFormat = {};
+  };
+
+  //----------------------------------------------------------------------------
+  // Destination pixel (x, y) shows the source point
+  // (mX + (x + 0.5) * mStepX, mY + (y + 0.5) * mStepY), so a viewport of an
+  // image zoomed by z starting at canvas point p is {p.x / z, p.y / z, 1 / z,
+  // 1 / z}.
+  //----------------------------------------------------------------------------
+  struct ScaleMapping
+  {
+    double mX;
+
+    double mY;
+
+    double mStepX;
+
+    double mStepY;
+  };
+
+  //----------------------------------------------------------------------------
+  // Writes columns [First, Last) of Row of Source as packed RGB, Bayer
+  // mosaics are demosaiced bilinearly.  Uses the same SIMD paths as scaling.
+  //----------------------------------------------------------------------------
+  void ConvertRow(
+    const ImageView& Source,
+    unsigned Row,
+    unsigned First,
+    unsigned Last,
+    uint8_t* pDestination);
+
+  //----------------------------------------------------------------------------
+  // Scales Source to Width x Height and writes it in Layout in the same pass.
+  // Stride may be negative for bottom up bitmaps.  Uses AVX2 or SSE4.1 when
+  // the cpu has them and never allocates once the calling thread has seen a
+  // destination this wide.
+  //----------------------------------------------------------------------------
+  void ScaleImage(
+    const ImageView& Source,
+    uint8_t* pDestination,
+    unsigned Width,
+    unsigned Height,
+    std::ptrdiff_t Stride,
+    const PixelLayout& Layout,
+    ScaleFilter Filter);
+
+  //----------------------------------------------------------------------------
+  // Same but with an arbitrary mapping, source pixels outside the image
+  // repeat its edge.
+  //----------------------------------------------------------------------------
+  void ScaleImage(
+    const ImageView& Source,
+    uint8_t* pDestination,
+    unsigned Width,
+    unsigned Height,
+    std::ptrdiff_t Stride,
+    const PixelLayout& Layout,
+    ScaleFilter Filter,
+    const ScaleMapping& Mapping);
+
+  //----------------------------------------------------------------------------
+  // Scales Source into the pixels of an existing bitmap through
+  // wxNativePixelData.  The bitmap must not be in use by any other thread.
+  //----------------------------------------------------------------------------
+  bool ScaleImage(
+    const ImageView& Source,
+    wxBitmap& Bitmap,
+    ScaleFilter Filter);
+
+  bool ScaleImage(
+    const ImageView& Source,
+    wxBitmap& Bitmap,
+    ScaleFilter Filter,
+    const ScaleMapping& Mapping);
+
+  //----------------------------------------------------------------------------
+  // Only writes Area of the bitmap, Mapping is relative to its top left.
+  //----------------------------------------------------------------------------
+  bool ScaleImage(
+    const ImageView& Source,
+    wxBitmap& Bitmap,
+    const wxRect& Area,
+    ScaleFilter Filter,
+    const ScaleMapping& Mapping);
+
+  //----------------------------------------------------------------------------
+  // Moves the pixels of Bitmap by Offset in place, the pixels it uncovers
+  // keep whatever they held.  Lets a viewport that panned keep the part
+  // still on screen and scale only the strips that came into view.
+  //----------------------------------------------------------------------------
+  bool ShiftBitmap(wxBitmap& Bitmap, const wxPoint& Offset);
+}
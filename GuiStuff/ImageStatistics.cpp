@@ -0,0 +1,614 @@
+#include "ImageStatistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GUISTUFF_X86_SIMD
+#endif
+
+using gs::ImageStatistics;
+using gs::ImageView;
+using gs::RegionStatistics;
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  bool HasSse41()
+  {
+#ifdef GUISTUFF_X86_SIMD
+    static const auto hasSse41 = []
+    {
+      __builtin_cpu_init();
+
+      return __builtin_cpu_supports("sse4.1") != 0;
+    }();
+
+    return hasSse41;
+#else
+    return false;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  // Count must not be 0.
+  //----------------------------------------------------------------------------
+  unsigned DoGetLevel(unsigned count)
+  {
+    return 31 - __builtin_clz(count);
+  }
+
+#ifdef GUISTUFF_X86_SIMD
+  //----------------------------------------------------------------------------
+  // Adds RowCount rows of 16 packed RGB pixels to the totals of each channel.
+  // The running totals are kept per byte position of the 48 byte rows, so
+  // nothing is shuffled until the three channels are picked out of them at
+  // the end.  The 16 bit sums can't overflow for up to 257 rows.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.1")))
+  void AccumulateSse41(
+    const uint8_t* pPixels,
+    std::size_t stride,
+    unsigned rowCount,
+    std::array<uint64_t, 3>& sums,
+    std::array<uint64_t, 3>& squares,
+    std::array<uint8_t, 3>& minimum,
+    std::array<uint8_t, 3>& maximum)
+  {
+    auto zero = _mm_setzero_si128();
+
+    __m128i minimumLanes[3];
+
+    __m128i maximumLanes[3];
+
+    __m128i sumLanes[6];
+
+    __m128i squareLanes[12];
+
+    for (unsigned part = 0; part < 3; ++part)
+    {
+      minimumLanes[part] = _mm_set1_epi8(-1);
+
+      maximumLanes[part] = zero;
+    }
+
+    for (auto& lanes : sumLanes)
+    {
+      lanes = zero;
+    }
+
+    for (auto& lanes : squareLanes)
+    {
+      lanes = zero;
+    }
+
+    for (unsigned row = 0; row < rowCount; ++row)
+    {
+      auto pRow = reinterpret_cast<const __m128i*>(pPixels + row * stride);
+
+      for (unsigned part = 0; part < 3; ++part)
+      {
+        auto pixels = _mm_loadu_si128(pRow + part);
+
+        minimumLanes[part] = _mm_min_epu8(minimumLanes[part], pixels);
+
+        maximumLanes[part] = _mm_max_epu8(maximumLanes[part], pixels);
+
+        auto low = _mm_unpacklo_epi8(pixels, zero);
+
+        auto high = _mm_unpackhi_epi8(pixels, zero);
+
+        sumLanes[part * 2] = _mm_add_epi16(sumLanes[part * 2], low);
+
+        sumLanes[part * 2 + 1] = _mm_add_epi16(sumLanes[part * 2 + 1], high);
+
+        auto lowSquares = _mm_mullo_epi16(low, low);
+
+        auto highSquares = _mm_mullo_epi16(high, high);
+
+        auto pSquares = squareLanes + part * 4;
+
+        pSquares[0] =
+          _mm_add_epi32(pSquares[0], _mm_unpacklo_epi16(lowSquares, zero));
+
+        pSquares[1] =
+          _mm_add_epi32(pSquares[1], _mm_unpackhi_epi16(lowSquares, zero));
+
+        pSquares[2] =
+          _mm_add_epi32(pSquares[2], _mm_unpacklo_epi16(highSquares, zero));
+
+        pSquares[3] =
+          _mm_add_epi32(pSquares[3], _mm_unpackhi_epi16(highSquares, zero));
+      }
+    }
+
+    alignas(16) std::array<uint8_t, 48> minimumBytes;
+
+    alignas(16) std::array<uint8_t, 48> maximumBytes;
+
+    alignas(16) std::array<uint16_t, 48> sumWords;
+
+    alignas(16) std::array<uint32_t, 48> squareWords;
+
+    for (unsigned part = 0; part < 3; ++part)
+    {
+      _mm_store_si128(
+        reinterpret_cast<__m128i*>(minimumBytes.data()) + part,
+        minimumLanes[part]);
+
+      _mm_store_si128(
+        reinterpret_cast<__m128i*>(maximumBytes.data()) + part,
+        maximumLanes[part]);
+    }
+
+    for (unsigned index = 0; index < 6; ++index)
+    {
+      _mm_store_si128(
+        reinterpret_cast<__m128i*>(sumWords.data()) + index,
+        sumLanes[index]);
+    }
+
+    for (unsigned index = 0; index < 12; ++index)
+    {
+      _mm_store_si128(
+        reinterpret_cast<__m128i*>(squareWords.data()) + index,
+        squareLanes[index]);
+    }
+
+    for (unsigned byte = 0; byte < 48; ++byte)
+    {
+      auto channel = byte % 3;
+
+      minimum[channel] = std::min(minimum[channel], minimumBytes[byte]);
+
+      maximum[channel] = std::max(maximum[channel], maximumBytes[byte]);
+
+      sums[channel] += sumWords[byte];
+
+      squares[channel] += squareWords[byte];
+    }
+  }
+#endif
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+ImageStatistics::ImageStatistics(const ImageView& image)
+  : mWidth(image.mWidth),
+    mHeight(image.mHeight),
+    mColumnCount((image.mWidth + mBlockSize - 1) / mBlockSize),
+    mRowCount((image.mHeight + mBlockSize - 1) / mBlockSize),
+    mSums(),
+    mSquares(),
+    mBins(),
+    mExtremes(),
+    mLevelOffsets(),
+    mRowLevelCount(0),
+    mColumnLevelCount(0),
+    mHistograms()
+{
+  if (mColumnCount != 0 && mRowCount != 0)
+  {
+    Measure(image);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned ImageStatistics::GetWidth() const
+{
+  return mWidth;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned ImageStatistics::GetHeight() const
+{
+  return mHeight;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+const std::array<uint32_t, 256>& ImageStatistics::GetHistogram(
+  std::size_t channel) const
+{
+  return mHistograms[channel];
+}
+
+//------------------------------------------------------------------------------
+// Block row by block row: the rows of one are converted to RGB together,
+// then each block is measured while it is in cache, full blocks through
+// SSE4.1.  The histograms don't vectorise and are counted alongside.
+//------------------------------------------------------------------------------
+void ImageStatistics::Measure(const ImageView& image)
+{
+  auto cornerCount = std::size_t(mRowCount + 1) * (mColumnCount + 1);
+
+  mSums.assign(cornerCount * 3, 0);
+
+  mSquares.assign(cornerCount * 3, 0);
+
+  mBins.assign(cornerCount * 3 * mBinCount, 0);
+
+  mRowLevelCount = DoGetLevel(mRowCount) + 1;
+
+  mColumnLevelCount = DoGetLevel(mColumnCount) + 1;
+
+  std::size_t extremesCount = 0;
+
+  for (unsigned rowLevel = 0; rowLevel < mRowLevelCount; ++rowLevel)
+  {
+    for (
+      unsigned columnLevel = 0;
+      columnLevel < mColumnLevelCount;
+      ++columnLevel)
+    {
+      mLevelOffsets.push_back(extremesCount);
+
+      extremesCount +=
+        std::size_t(mRowCount - (1u << rowLevel) + 1) *
+        (mColumnCount - (1u << columnLevel) + 1);
+    }
+  }
+
+  mExtremes.resize(extremesCount);
+
+  auto isSimd = HasSse41();
+
+  auto rowBytes = std::size_t(mWidth) * 3;
+
+  std::vector<uint8_t> pixels(rowBytes * mBlockSize);
+
+  std::vector<Block> blocks(mColumnCount);
+
+  for (unsigned blockRow = 0; blockRow < mRowCount; ++blockRow)
+  {
+    auto firstRow = blockRow * mBlockSize;
+
+    auto rowCount = std::min(mBlockSize, mHeight - firstRow);
+
+    for (unsigned row = 0; row < rowCount; ++row)
+    {
+      gs::ConvertRow(
+        image,
+        firstRow + row,
+        0,
+        mWidth,
+        pixels.data() + row * rowBytes);
+    }
+
+    for (unsigned column = 0; column < mColumnCount; ++column)
+    {
+      auto first = column * mBlockSize;
+
+      auto count = std::min(mBlockSize, mWidth - first);
+
+      auto pPixels = pixels.data() + std::size_t(first) * 3;
+
+      auto& block = blocks[column];
+
+      block = Block {};
+
+      block.mExtremes.mMinimum.fill(255);
+
+      for (unsigned row = 0; row < rowCount; ++row)
+      {
+        auto pRow = pPixels + row * rowBytes;
+
+        for (unsigned byte = 0; byte < count * 3; byte += 3)
+        {
+          for (unsigned channel = 0; channel < 3; ++channel)
+          {
+            auto value = pRow[byte + channel];
+
+            ++mHistograms[channel][value];
+
+            ++block.mBins[channel][value / (256 / mBinCount)];
+          }
+        }
+      }
+
+#ifdef GUISTUFF_X86_SIMD
+      if (isSimd && count == mBlockSize)
+      {
+        AccumulateSse41(
+          pPixels,
+          rowBytes,
+          rowCount,
+          block.mSums,
+          block.mSquares,
+          block.mExtremes.mMinimum,
+          block.mExtremes.mMaximum);
+
+        continue;
+      }
+#endif
+
+      DoAccumulate(pPixels, rowBytes, count, rowCount, block);
+    }
+
+    AddBlockRow(blockRow, blocks);
+  }
+
+  BuildExtremes();
+}
+
+//------------------------------------------------------------------------------
+// Adds RowCount rows of Count packed RGB pixels to Block without SIMD.
+//------------------------------------------------------------------------------
+void ImageStatistics::DoAccumulate(
+  const uint8_t* pPixels,
+  std::size_t stride,
+  unsigned count,
+  unsigned rowCount,
+  Block& block)
+{
+  auto& extremes = block.mExtremes;
+
+  for (unsigned row = 0; row < rowCount; ++row)
+  {
+    auto pRow = pPixels + row * stride;
+
+    for (unsigned byte = 0; byte < count * 3; ++byte)
+    {
+      auto channel = byte % 3;
+
+      auto value = pRow[byte];
+
+      block.mSums[channel] += value;
+
+      block.mSquares[channel] += uint32_t(value) * value;
+
+      extremes.mMinimum[channel] = std::min(extremes.mMinimum[channel], value);
+
+      extremes.mMaximum[channel] = std::max(extremes.mMaximum[channel], value);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Each corner of the tables is the one above it plus the blocks of this row
+// to its left.
+//------------------------------------------------------------------------------
+void ImageStatistics::AddBlockRow(
+  unsigned row,
+  const std::vector<Block>& blocks)
+{
+  Block left {};
+
+  for (unsigned column = 0; column < mColumnCount; ++column)
+  {
+    const auto& block = blocks[column];
+
+    auto above = DoGetIntegralIndex(row, column + 1);
+
+    auto corner = DoGetIntegralIndex(row + 1, column + 1);
+
+    for (unsigned channel = 0; channel < 3; ++channel)
+    {
+      left.mSums[channel] += block.mSums[channel];
+
+      left.mSquares[channel] += block.mSquares[channel];
+
+      mSums[corner * 3 + channel] =
+        mSums[above * 3 + channel] + left.mSums[channel];
+
+      mSquares[corner * 3 + channel] =
+        mSquares[above * 3 + channel] + left.mSquares[channel];
+
+      for (unsigned bin = 0; bin < mBinCount; ++bin)
+      {
+        left.mBins[channel][bin] += block.mBins[channel][bin];
+
+        mBins[(corner * 3 + channel) * mBinCount + bin] =
+          mBins[(above * 3 + channel) * mBinCount + bin] +
+          left.mBins[channel][bin];
+      }
+    }
+
+    mExtremes[std::size_t(row) * mColumnCount + column] = block.mExtremes;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Level (r, c) from two halves of level (r - 1, c), or of (0, c - 1) along
+// the first row of levels.
+//------------------------------------------------------------------------------
+void ImageStatistics::BuildExtremes()
+{
+  for (unsigned rowLevel = 0; rowLevel < mRowLevelCount; ++rowLevel)
+  {
+    for (
+      unsigned columnLevel = 0;
+      columnLevel < mColumnLevelCount;
+      ++columnLevel)
+    {
+      if (rowLevel == 0 && columnLevel == 0)
+      {
+        continue;
+      }
+
+      auto rowCount = mRowCount - (1u << rowLevel) + 1;
+
+      auto columnCount = mColumnCount - (1u << columnLevel) + 1;
+
+      auto pLevel =
+        mExtremes.data() +
+        mLevelOffsets[rowLevel * mColumnLevelCount + columnLevel];
+
+      for (unsigned row = 0; row < rowCount; ++row)
+      {
+        for (unsigned column = 0; column < columnCount; ++column)
+        {
+          const auto& first =
+            rowLevel == 0 ?
+              DoGetExtremes(0, columnLevel - 1, row, column) :
+              DoGetExtremes(rowLevel - 1, columnLevel, row, column);
+
+          const auto& second =
+            rowLevel == 0 ?
+              DoGetExtremes(
+                0,
+                columnLevel - 1,
+                row,
+                column + (1u << (columnLevel - 1))) :
+              DoGetExtremes(
+                rowLevel - 1,
+                columnLevel,
+                row + (1u << (rowLevel - 1)),
+                column);
+
+          auto& extremes = pLevel[std::size_t(row) * columnCount + column];
+
+          for (unsigned channel = 0; channel < 3; ++channel)
+          {
+            extremes.mMinimum[channel] =
+              std::min(first.mMinimum[channel], second.mMinimum[channel]);
+
+            extremes.mMaximum[channel] =
+              std::max(first.mMaximum[channel], second.mMaximum[channel]);
+          }
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Sums from the four corners of the blocks' summed-area tables, extremes
+// from the four power of two runs of blocks that together cover them.
+//------------------------------------------------------------------------------
+RegionStatistics ImageStatistics::Get(const wxRect& region) const
+{
+  RegionStatistics statistics {};
+
+  auto clipped = region.Intersect(wxRect(0, 0, mWidth, mHeight));
+
+  if (clipped.IsEmpty())
+  {
+    return statistics;
+  }
+
+  unsigned firstColumn = clipped.GetLeft() / mBlockSize;
+
+  unsigned lastColumn = clipped.GetRight() / mBlockSize;
+
+  unsigned firstRow = clipped.GetTop() / mBlockSize;
+
+  unsigned lastRow = clipped.GetBottom() / mBlockSize;
+
+  auto left = firstColumn * mBlockSize;
+
+  auto top = firstRow * mBlockSize;
+
+  statistics.mRegion = wxRect(
+    left,
+    top,
+    std::min(mWidth, (lastColumn + 1) * mBlockSize) - left,
+    std::min(mHeight, (lastRow + 1) * mBlockSize) - top);
+
+  statistics.mPixelCount =
+    uint64_t(statistics.mRegion.GetWidth()) * statistics.mRegion.GetHeight();
+
+  auto topLeft = DoGetIntegralIndex(firstRow, firstColumn);
+
+  auto topRight = DoGetIntegralIndex(firstRow, lastColumn + 1);
+
+  auto bottomLeft = DoGetIntegralIndex(lastRow + 1, firstColumn);
+
+  auto bottomRight = DoGetIntegralIndex(lastRow + 1, lastColumn + 1);
+
+  auto rowLevel = DoGetLevel(lastRow - firstRow + 1);
+
+  auto columnLevel = DoGetLevel(lastColumn - firstColumn + 1);
+
+  auto secondRow = lastRow + 1 - (1u << rowLevel);
+
+  auto secondColumn = lastColumn + 1 - (1u << columnLevel);
+
+  const Extremes* runs[4] = {
+    &DoGetExtremes(rowLevel, columnLevel, firstRow, firstColumn),
+    &DoGetExtremes(rowLevel, columnLevel, firstRow, secondColumn),
+    &DoGetExtremes(rowLevel, columnLevel, secondRow, firstColumn),
+    &DoGetExtremes(rowLevel, columnLevel, secondRow, secondColumn)};
+
+  auto count = static_cast<double>(statistics.mPixelCount);
+
+  for (unsigned channel = 0; channel < 3; ++channel)
+  {
+    auto& channelStatistics = statistics.mChannels[channel];
+
+    auto getSum = [&](const std::vector<uint64_t>& table)
+    {
+      return
+        table[bottomRight * 3 + channel] -
+        table[topRight * 3 + channel] -
+        table[bottomLeft * 3 + channel] +
+        table[topLeft * 3 + channel];
+    };
+
+    auto mean = getSum(mSums) / count;
+
+    auto variance = getSum(mSquares) / count - mean * mean;
+
+    channelStatistics.mMean = mean;
+
+    channelStatistics.mStandardDeviation = std::sqrt(std::max(0.0, variance));
+
+    for (unsigned bin = 0; bin < mBinCount; ++bin)
+    {
+      auto getBin = [&](std::size_t corner)
+      {
+        return mBins[(corner * 3 + channel) * mBinCount + bin];
+      };
+
+      channelStatistics.mHistogram[bin] =
+        getBin(bottomRight) -
+        getBin(topRight) -
+        getBin(bottomLeft) +
+        getBin(topLeft);
+    }
+
+    channelStatistics.mMinimum = 255;
+
+    channelStatistics.mMaximum = 0;
+
+    for (const auto* pRun : runs)
+    {
+      channelStatistics.mMinimum =
+        std::min(channelStatistics.mMinimum, pRun->mMinimum[channel]);
+
+      channelStatistics.mMaximum =
+        std::max(channelStatistics.mMaximum, pRun->mMaximum[channel]);
+    }
+  }
+
+  return statistics;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t ImageStatistics::DoGetIntegralIndex(
+  unsigned row,
+  unsigned column) const
+{
+  return std::size_t(row) * (mColumnCount + 1) + column;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+const ImageStatistics::Extremes& ImageStatistics::DoGetExtremes(
+  unsigned rowLevel,
+  unsigned columnLevel,
+  unsigned row,
+  unsigned column) const
+{
+  auto columnCount = mColumnCount - (1u << columnLevel) + 1;
+
+  return mExtremes[
+    mLevelOffsets[rowLevel * mColumnLevelCount + columnLevel] +
+    std::size_t(row) * columnCount +
+    column];
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <GuiStuff/ImageScaler.hpp>
+
+#include <wx/gdicmn.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct ChannelStatistics
+  {
+    double mMean;
+
+    double mStandardDeviation;
+
+    uint8_t mMinimum;
+
+    uint8_t mMaximum;
+
+    // ImageStatistics::mBinCount bins evenly over 0 to 255
+    std::array<uint32_t, 16> mHistogram;
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct RegionStatistics
+  {
+    // what was measured, the asked for region grown out to whole blocks
+    wxRect mRegion;
+
+    // 0 when there was nothing to measure
+    uint64_t mPixelCount;
+
+    // red, green, blue, all three the same for mono images
+    std::array<ChannelStatistics, 3> mChannels;
+  };
+
+  //----------------------------------------------------------------------------
+  // Everything needed to answer statistics of any region of one frame in
+  // constant time, built in one pass over it that is meant for a worker
+  // thread.  The frame is split into mBlockSize square blocks whose sums, sums
+  // of squares and coarse histograms go into summed-area tables, and whose
+  // minimums and maximums go into a sparse table of every power of two run
+  // of blocks.  So a region is measured to whole blocks, costs a few dozen
+  // lookups whatever its size and never touches the frame's pixels again.
+  // About two bytes per pixel.  Immutable once built, share it freely.
+  //----------------------------------------------------------------------------
+  class ImageStatistics
+  {
+    public:
+
+      static constexpr unsigned mBlockSize = 16;
+
+      static constexpr unsigned mBinCount = 16;
+
+      // Any pixel format, measured as it would be displayed.  Uses SSE4.1
+      // when the cpu has it.
+      explicit ImageStatistics(const ImageView& Image);
+
+      unsigned GetWidth() const;
+
+      unsigned GetHeight() const;
+
+      // Of the blocks Region, in image pixels, touches.
+      RegionStatistics Get(const wxRect& Region) const;
+
+      // Of every pixel of the frame, one bin per level.
+      const std::array<uint32_t, 256>& GetHistogram(std::size_t Channel) const;
+
+    private:
+
+      struct Extremes
+      {
+        std::array<uint8_t, 3> mMinimum;
+
+        std::array<uint8_t, 3> mMaximum;
+      };
+
+      struct Block
+      {
+        std::array<uint64_t, 3> mSums;
+
+        std::array<uint64_t, 3> mSquares;
+
+        std::array<std::array<uint32_t, mBinCount>, 3> mBins;
+
+        Extremes mExtremes;
+      };
+
+      void Measure(const ImageView& Image);
+
+      static void DoAccumulate(
+        const uint8_t* pPixels,
+        std::size_t Stride,
+        unsigned Count,
+        unsigned RowCount,
+        Block& Block);
+
+      void AddBlockRow(unsigned Row, const std::vector<Block>& Blocks);
+
+      void BuildExtremes();
+
+      std::size_t DoGetIntegralIndex(unsigned Row, unsigned Column) const;
+
+      const Extremes& DoGetExtremes(
+        unsigned RowLevel,
+        unsigned ColumnLevel,
+        unsigned Row,
+        unsigned Column) const;
+
+    private:
+
+      unsigned mWidth;
+
+      unsigned mHeight;
+
+      // of blocks, the last ones may be partial
+      unsigned mColumnCount;
+
+      unsigned mRowCount;
+
+      // (mRowCount + 1) x (mColumnCount + 1) corners, three channels each
+      std::vector<uint64_t> mSums;
+
+      std::vector<uint64_t> mSquares;
+
+      // mBinCount per channel per corner
+      std::vector<uint32_t> mBins;
+
+      // Level (r, c) holds the extremes of the 2^r x 2^c blocks starting at
+      // every block they fit from, the levels one after another.
+      std::vector<Extremes> mExtremes;
+
+      std::vector<std::size_t> mLevelOffsets;
+
+      unsigned mRowLevelCount;
+
+      unsigned mColumnLevelCount;
+
+      std::array<std::array<uint32_t, 256>, 3> mHistograms;
+  };
+}
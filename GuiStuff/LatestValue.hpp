@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // Triple buffered mailbox that only ever holds the most recent value.
+  // Producers overwrite it without allocating and never wait, on the consumer
+  // or on each other, and a single consumer takes whatever is newest.  A
+  // producer that finds another one mid copy counts its value as superseded
+  // and returns: the two calls overlap, so either value may be taken as the
+  // newer, and the one being copied is left for the consumer.
+  //----------------------------------------------------------------------------
+  template <typename T>
+  class LatestValue
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      LatestValue()
+        : mBuffers(),
+          mMiddle(1),
+          mBack(0),
+          mIsWriting(),
+          mSupersededCount(0),
+          mFront(2)
+      {
+        mIsWriting.clear();
+      }
+
+      LatestValue(const LatestValue&) = delete;
+
+      LatestValue& operator = (const LatestValue&) = delete;
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void Set(const T& value)
+      {
+        if (mIsWriting.test_and_set(std::memory_order_acquire))
+        {
+          mSupersededCount.fetch_add(1, std::memory_order_relaxed);
+
+          return;
+        }
+
+        mBuffers[mBack] = value;
+
+        auto previous =
+          mMiddle.exchange(mBack | mDirtyFlag, std::memory_order_acq_rel);
+
+        mBack = previous & mIndexMask;
+
+        mIsWriting.clear(std::memory_order_release);
+
+        if (previous & mDirtyFlag)
+        {
+          mSupersededCount.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+
+      //------------------------------------------------------------------------
+      // Consumer side only.  Returns nullptr when nothing was written since the
+      // last call, otherwise the newest value which stays valid until the next
+      // call to Take.
+      //------------------------------------------------------------------------
+      const T* Take()
+      {
+        if (!(mMiddle.load(std::memory_order_relaxed) & mDirtyFlag))
+        {
+          return nullptr;
+        }
+
+        auto previous = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+
+        mFront = previous & mIndexMask;
+
+        return &mBuffers[mFront];
+      }
+
+      //------------------------------------------------------------------------
+      // Consumer side only.  The value most recently returned by Take.
+      //------------------------------------------------------------------------
+      const T& GetFront() const
+      {
+        return mBuffers[mFront];
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      bool IsDirty() const
+      {
+        return mMiddle.load(std::memory_order_relaxed) & mDirtyFlag;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      uint64_t GetSupersededCount() const
+      {
+        return mSupersededCount.load(std::memory_order_relaxed);
+      }
+
+    private:
+
+      static constexpr uint8_t mDirtyFlag = 0x4;
+
+      static constexpr uint8_t mIndexMask = 0x3;
+
+      std::array<T, 3> mBuffers;
+
+      alignas(64) std::atomic<uint8_t> mMiddle;
+
+      alignas(64) uint8_t mBack;
+
+      std::atomic_flag mIsWriting;
+
+      std::atomic<uint64_t> mSupersededCount;
+
+      alignas(64) uint8_t mFront;
+  };
+}
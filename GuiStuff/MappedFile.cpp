@@ -0,0 +1,137 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+
+using gs::MappedFile;
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  [[noreturn]] void ThrowSystemError(const std::string& What)
+  {
+    throw std::system_error(errno, std::generic_category(), What);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+MappedFile::MappedFile(const std::string& Filename, std::size_t Size)
+  : mFilename(Filename),
+    mFileDescriptor(-1),
+    mpData(nullptr),
+    mSize(Size)
+{
+  mFileDescriptor = open(Filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (mFileDescriptor < 0)
+  {
+    ThrowSystemError("unable to create " + Filename);
+  }
+
+  if (ftruncate(mFileDescriptor, Size) != 0)
+  {
+    close(mFileDescriptor);
+
+    ThrowSystemError("unable to resize " + Filename);
+  }
+
+  Map(PROT_READ | PROT_WRITE);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+MappedFile::MappedFile(const std::string& Filename)
+  : mFilename(Filename),
+    mFileDescriptor(-1),
+    mpData(nullptr),
+    mSize(0)
+{
+  mFileDescriptor = open(Filename.c_str(), O_RDONLY);
+
+  if (mFileDescriptor < 0)
+  {
+    ThrowSystemError("unable to open " + Filename);
+  }
+
+  struct stat Status;
+
+  if (fstat(mFileDescriptor, &Status) != 0)
+  {
+    close(mFileDescriptor);
+
+    ThrowSystemError("unable to stat " + Filename);
+  }
+
+  mSize = Status.st_size;
+
+  Map(PROT_READ);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+  if (mpData)
+  {
+    munmap(mpData, mSize);
+  }
+
+  if (mFileDescriptor >= 0)
+  {
+    close(mFileDescriptor);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MappedFile::Map(int Protection)
+{
+  if (mSize == 0)
+  {
+    return;
+  }
+
+  auto pData = mmap(nullptr, mSize, Protection, MAP_SHARED, mFileDescriptor, 0);
+
+  if (pData == MAP_FAILED)
+  {
+    close(mFileDescriptor);
+
+    ThrowSystemError("unable to map " + mFilename);
+  }
+
+  mpData = static_cast<std::byte*>(pData);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MappedFile::Close(std::size_t Size)
+{
+  if (mpData)
+  {
+    munmap(mpData, mSize);
+
+    mpData = nullptr;
+  }
+
+  if (mFileDescriptor >= 0)
+  {
+    if (ftruncate(mFileDescriptor, Size) != 0)
+    {
+      ThrowSystemError("unable to resize " + mFilename);
+    }
+
+    close(mFileDescriptor);
+
+    mFileDescriptor = -1;
+  }
+
+  mSize = 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  class MappedFile
+  {
+    public:
+
+      // Creates (or truncates) filename to size bytes and maps it read/write.
+      MappedFile(const std::string& Filename, std::size_t Size);
+
+      // Maps an existing file read only.
+      explicit MappedFile(const std::string& Filename);
+
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+
+      MappedFile& operator = (const MappedFile&) = delete;
+
+      std::byte* GetData() const
+      {
+        return mpData;
+      }
+
+      std::size_t GetSize() const
+      {
+        return mSize;
+      }
+
+      // Unmaps the file and cuts it down to Size bytes.
+      void Close(std::size_t Size);
+
+    private:
+
+      void Map(int Protection);
+
+    private:
+
+      std::string mFilename;
+
+      int mFileDescriptor;
+
+      std::byte* mpData;
+
+      std::size_t mSize;
+  };
+}
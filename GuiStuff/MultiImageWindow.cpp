@@ -0,0 +1,666 @@
+#include "MultiImageWindow.hpp"
+#include <GuiStuff/FrameClock.hpp>
+#include <GuiStuff/Helpers.hpp>
+#include <GuiStuff/WorkerPool.hpp>
+
+#include <wx/dcbuffer.h>
+#include <wx/region.h>
+
+#include <algorithm>
+#include <cmath>
+
+using gs::MultiImageWindow;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+MultiImageWindow::MultiImageWindow(wxWindow* pParent, std::size_t streamCount)
+  : wxWindow(pParent, wxID_ANY),
+    mTiles(),
+    mOrder(),
+    mLayout(Layout::Grid),
+    mColumnCount(0),
+    mScaleFilter(gs::ScaleFilter::Nearest),
+    mFullRateSize(320, 240),
+    mSmallTilePeriod(100),
+    mpLifetime(std::make_shared<int>(0)),
+    mPaceTimer(this, PaceTimerId),
+    mPaceTime(),
+    mIsCatchUpPending(false),
+    mPaintCount(0),
+    mFeeds(streamCount)
+{
+  for (std::size_t stream = 0; stream < streamCount; ++stream)
+  {
+    mTiles.push_back(std::make_unique<Tile>());
+
+    mOrder.push_back(stream);
+  }
+
+  ConnectWxStuff();
+
+  SetBackgroundStyle(wxBG_STYLE_PAINT);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::ConnectWxStuff()
+{
+  Bind(wxEVT_LEFT_DCLICK, &MultiImageWindow::OnLeftClickDoubleClick, this);
+  Bind(wxEVT_PAINT, &MultiImageWindow::OnPaint, this);
+  Bind(wxEVT_SIZE, &MultiImageWindow::OnResize, this);
+  Bind(wxEVT_TIMER, &MultiImageWindow::OnPaceTimer, this, PaceTimerId);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t MultiImageWindow::GetStreamCount() const
+{
+  return mTiles.size();
+}
+
+//------------------------------------------------------------------------------
+// Any thread.  Publishing never waits on the gui thread or the painter.
+//------------------------------------------------------------------------------
+void MultiImageWindow::SetImage(
+  std::size_t stream,
+  const std::shared_ptr<const dl::image::Image>& pImage,
+  const PixelFormat& format)
+{
+  mTiles.at(stream)->Publish(
+    pImage,
+    format,
+    mpLifetime,
+    [this, stream]
+    {
+      RequestTile(stream);
+    });
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::AttachImage(
+  std::size_t stream,
+  const std::string& ringName)
+{
+  auto& pFeed = mFeeds.at(stream);
+
+  pFeed.reset();
+
+  pFeed = std::make_unique<FrameRingFeed>(
+    ringName,
+    [this, stream] (const FrameRingReader::Frame& frame)
+    {
+      SetImage(stream, frame.mpImage, frame.mFormat);
+    });
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::SetLayout(Layout layout)
+{
+  mLayout = layout;
+
+  UpdateLayout();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::SetColumnCount(std::size_t columnCount)
+{
+  mColumnCount = columnCount;
+
+  UpdateLayout();
+}
+
+//------------------------------------------------------------------------------
+// The promoted stream swaps tiles with the old primary, the rest stay put.
+//------------------------------------------------------------------------------
+void MultiImageWindow::SetPrimary(std::size_t stream)
+{
+  auto iStream = std::find(mOrder.begin(), mOrder.end(), stream);
+
+  if (iStream == mOrder.end() || iStream == mOrder.begin())
+  {
+    return;
+  }
+
+  std::iter_swap(mOrder.begin(), iStream);
+
+  UpdateLayout();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t MultiImageWindow::GetPrimary() const
+{
+  return mOrder.empty() ? 0 : mOrder.front();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::ShowStream(std::size_t stream, bool isShown)
+{
+  auto& tile = *mTiles.at(stream);
+
+  if (tile.mIsShown != isShown)
+  {
+    tile.mIsShown = isShown;
+
+    UpdateLayout();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Applies from the next frame on.
+//------------------------------------------------------------------------------
+void MultiImageWindow::SetFramePeriod(
+  std::size_t stream,
+  std::chrono::milliseconds period)
+{
+  mTiles.at(stream)->mFramePeriod = period;
+}
+
+//------------------------------------------------------------------------------
+// Applies from the next frame on.
+//------------------------------------------------------------------------------
+void MultiImageWindow::SetDecimation(
+  const wxSize& fullRateSize,
+  std::chrono::milliseconds smallTilePeriod)
+{
+  mFullRateSize = fullRateSize;
+
+  mSmallTilePeriod = smallTilePeriod;
+}
+
+//------------------------------------------------------------------------------
+// Applies from the next frame or resize on.
+//------------------------------------------------------------------------------
+void MultiImageWindow::SetScaleFilter(ScaleFilter filter)
+{
+  mScaleFilter = filter;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+MultiImageWindow::FrameCounters MultiImageWindow::GetFrameCounters(
+  std::size_t stream) const
+{
+  auto& tile = *mTiles.at(stream);
+
+  return {
+    tile.mPublishedCount.load(),
+    tile.mDisplayedCount.load(),
+    tile.mFrames.GetSupersededCount()};
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t MultiImageWindow::GetPaintCount() const
+{
+  return mPaintCount;
+}
+
+//------------------------------------------------------------------------------
+// Bitmaps are drawn centred in their tiles, so one scaled for the previous
+// layout stays in place until its replacement is ready.
+//------------------------------------------------------------------------------
+void MultiImageWindow::OnPaint(wxPaintEvent& event)
+{
+  wxAutoBufferedPaintDC Dc(this);
+
+  if (mIsCatchUpPending)
+  {
+    mIsCatchUpPending = false;
+
+    RequestTiles();
+  }
+
+  auto damage = GetUpdateRegion();
+
+  Dc.SetPen(*wxTRANSPARENT_PEN);
+
+  Dc.SetBrush(wxBrush(GetBackgroundColour()));
+
+  for (wxRegionIterator iRect(damage); iRect; ++iRect)
+  {
+    Dc.DrawRectangle(iRect.GetRect());
+  }
+
+  for (const auto& pTile : mTiles)
+  {
+    auto& rect = pTile->mRect;
+
+    if (
+      !pTile->mpBitmap ||
+      rect.IsEmpty() ||
+      damage.Contains(rect) == wxOutRegion)
+    {
+      continue;
+    }
+
+    auto bitmapSize = pTile->mpBitmap->GetSize();
+
+    wxPoint location(
+      rect.GetX() + (rect.GetWidth() - bitmapSize.GetWidth()) / 2,
+      rect.GetY() + (rect.GetHeight() - bitmapSize.GetHeight()) / 2);
+
+    Dc.SetClippingRegion(rect);
+
+    Dc.DrawBitmap(*pTile->mpBitmap, location);
+
+    Dc.DestroyClippingRegion();
+  }
+
+  if (!mOrder.empty())
+  {
+    auto primaryRect = mTiles[mOrder.front()]->mRect;
+
+    if (!primaryRect.IsEmpty() && primaryRect.GetSize() != GetClientSize())
+    {
+      Dc.SetPen(wxPen(*wxYELLOW));
+
+      Dc.SetBrush(*wxTRANSPARENT_BRUSH);
+
+      Dc.DrawRectangle(primaryRect.Inflate(mTileGap / 2));
+    }
+  }
+
+  ++mPaintCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::OnResize(wxSizeEvent& event)
+{
+  UpdateLayout();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::OnLeftClickDoubleClick(wxMouseEvent& event)
+{
+  for (std::size_t stream = 0; stream < mTiles.size(); ++stream)
+  {
+    if (mTiles[stream]->mRect.Contains(event.GetPosition()))
+    {
+      SetPrimary(stream);
+
+      return;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Takes the frames of every tile that has come due.
+//------------------------------------------------------------------------------
+void MultiImageWindow::OnPaceTimer(wxTimerEvent& event)
+{
+  mPaceTime.reset();
+
+  for (std::size_t stream = 0; stream < mTiles.size(); ++stream)
+  {
+    if (mTiles[stream]->mFrames.IsDirty())
+    {
+      RequestTile(stream);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Gui thread.  Hands the shown streams their tiles in order and rescales
+// whichever changed size.
+//------------------------------------------------------------------------------
+void MultiImageWindow::UpdateLayout()
+{
+  std::vector<std::size_t> shown;
+
+  for (auto stream : mOrder)
+  {
+    auto& pTile = mTiles[stream];
+
+    pTile->mRect = wxRect();
+
+    if (pTile->mIsShown)
+    {
+      shown.push_back(stream);
+    }
+  }
+
+  auto rects = mLayout == Layout::Grid ?
+    DoGetGridRects(shown.size()) :
+    DoGetMosaicRects(shown.size());
+
+  for (std::size_t i = 0; i < shown.size(); ++i)
+  {
+    mTiles[shown[i]]->mRect = rects[i];
+  }
+
+  gs::FrameClock::GetInstance().Invalidate(this);
+
+  RequestTiles();
+}
+
+//------------------------------------------------------------------------------
+// Row by row, in columns of as near square tiles as the count allows.
+//------------------------------------------------------------------------------
+std::vector<wxRect> MultiImageWindow::DoGetGridRects(
+  std::size_t tileCount) const
+{
+  std::vector<wxRect> rects;
+
+  if (tileCount == 0)
+  {
+    return rects;
+  }
+
+  auto columnCount = mColumnCount;
+
+  if (columnCount == 0)
+  {
+    columnCount = static_cast<std::size_t>(
+      std::ceil(std::sqrt(static_cast<double>(tileCount))));
+  }
+
+  auto rowCount = (tileCount + columnCount - 1) / columnCount;
+
+  wxSize cellCount(columnCount, rowCount);
+
+  for (std::size_t i = 0; i < tileCount; ++i)
+  {
+    rects.push_back(
+      DoGetCellRect(
+        GetClientSize(),
+        cellCount,
+        wxRect(i % columnCount, i / columnCount, 1, 1)));
+  }
+  return rects;
+}
+
+//------------------------------------------------------------------------------
+// A square of N x N cells, the primary tile taking all but the last row and
+// column and the others going down the last column then along the last row.
+// N is the smallest that fits every tile, 2N - 1 of them around the primary.
+//------------------------------------------------------------------------------
+std::vector<wxRect> MultiImageWindow::DoGetMosaicRects(
+  std::size_t tileCount) const
+{
+  std::vector<wxRect> rects;
+
+  if (tileCount == 0)
+  {
+    return rects;
+  }
+
+  if (tileCount == 1)
+  {
+    rects.push_back(
+      DoGetCellRect(GetClientSize(), wxSize(1, 1), wxRect(0, 0, 1, 1)));
+
+    return rects;
+  }
+
+  int sideCount = std::max<std::size_t>(
+    {2, (tileCount + 1) / 2, mColumnCount});
+
+  wxSize cellCount(sideCount, sideCount);
+
+  rects.push_back(
+    DoGetCellRect(
+      GetClientSize(),
+      cellCount,
+      wxRect(0, 0, sideCount - 1, sideCount - 1)));
+
+  for (int row = 0; row < sideCount && rects.size() < tileCount; ++row)
+  {
+    rects.push_back(
+      DoGetCellRect(
+        GetClientSize(),
+        cellCount,
+        wxRect(sideCount - 1, row, 1, 1)));
+  }
+
+  for (
+    int column = 0;
+    column < sideCount - 1 && rects.size() < tileCount;
+    ++column)
+  {
+    rects.push_back(
+      DoGetCellRect(
+        GetClientSize(),
+        cellCount,
+        wxRect(column, sideCount - 1, 1, 1)));
+  }
+  return rects;
+}
+
+//------------------------------------------------------------------------------
+// The window area covered by Cells of a CellCount grid, less half the gap
+// between tiles on every side.
+//------------------------------------------------------------------------------
+wxRect MultiImageWindow::DoGetCellRect(
+  const wxSize& size,
+  const wxSize& cellCount,
+  const wxRect& cells)
+{
+  auto left = cells.GetLeft() * size.GetWidth() / cellCount.GetWidth();
+
+  auto top = cells.GetTop() * size.GetHeight() / cellCount.GetHeight();
+
+  auto right =
+    (cells.GetRight() + 1) * size.GetWidth() / cellCount.GetWidth();
+
+  auto bottom =
+    (cells.GetBottom() + 1) * size.GetHeight() / cellCount.GetHeight();
+
+  wxRect rect(left, top, right - left, bottom - top);
+
+  rect.Deflate(mTileGap / 2);
+
+  return rect;
+}
+
+//------------------------------------------------------------------------------
+// Gui thread.  As PictureInPictureWindow::RequestPrimaryImage, with a tile
+// taking its next frame only once its period has passed.  A frame that isn't
+// due yet is left for the pace timer, a hidden tile leaves its frames to be
+// superseded until it is shown again.
+//------------------------------------------------------------------------------
+void MultiImageWindow::RequestTile(std::size_t stream)
+{
+  auto& tile = *mTiles[stream];
+
+  if (tile.mJob.mIsRunning)
+  {
+    tile.mJob.mIsStale = true;
+
+    return;
+  }
+
+  tile.mJob.mIsStale = false;
+
+  if (tile.mRect.IsEmpty())
+  {
+    return;
+  }
+
+  if (!IsShownOnScreen())
+  {
+    mIsCatchUpPending = true;
+
+    return;
+  }
+
+  auto now = Clock::now();
+
+  auto isNewFrame = false;
+
+  if (now >= tile.mNextFrameTime)
+  {
+    isNewFrame = tile.TakeNewest();
+
+    if (isNewFrame)
+    {
+      tile.mNextFrameTime =
+        std::max(tile.mNextFrameTime + DoGetFramePeriod(tile), now);
+    }
+  }
+  else if (tile.mFrames.IsDirty())
+  {
+    StartPaceTimer(tile.mNextFrameTime);
+  }
+
+  auto& pImage = tile.mpImage;
+
+  if (!pImage)
+  {
+    if (tile.mpBitmap)
+    {
+      tile.mpBitmap.reset();
+
+      gs::FrameClock::GetInstance().Invalidate(this, tile.mRect);
+    }
+    return;
+  }
+
+  auto imageRect = DoGetImageRect(*pImage, tile.mRect);
+
+  if (
+    imageRect.IsEmpty() ||
+    (!isNewFrame &&
+      tile.mpBitmap &&
+      tile.mpBitmap->GetSize() == imageRect.GetSize() &&
+      tile.mpBitmapImage.lock() == pImage))
+  {
+    return;
+  }
+
+  auto pPyramid = tile.mpPyramid;
+
+  auto pBitmap = tile.mJob.GetBitmap(imageRect.GetSize());
+
+  ScaleMapping mapping {
+    0.0,
+    0.0,
+    static_cast<double>(pImage->GetWidth()) / imageRect.GetWidth(),
+    static_cast<double>(pImage->GetHeight()) / imageRect.GetHeight()};
+
+  auto filter = gs::FrameClock::GetInstance().GetScaleFilter(mScaleFilter);
+
+  tile.mJob.mIsRunning = true;
+
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  std::weak_ptr<const dl::image::Image> pFrame = pImage;
+
+  gs::WorkerPool::GetInstance().Post(
+    [
+      this, pLifetime, stream, pPyramid, pBitmap, filter, mapping, pFrame,
+      isNewFrame] () mutable
+    {
+      ScaleJob::Scale(*pPyramid, *pBitmap, filter, mapping);
+
+      // the bitmap has to be released on the gui thread
+      gs::DoOnGuiThread(
+        [this, pLifetime, stream, pBitmap = std::move(pBitmap), pFrame,
+         isNewFrame]
+        {
+          if (pLifetime.expired())
+          {
+            return;
+          }
+
+          auto& tile = *mTiles[stream];
+
+          tile.mJob.mIsRunning = false;
+
+          if (isNewFrame)
+          {
+            ++tile.mDisplayedCount;
+          }
+
+          tile.mJob.mpSpareBitmap = std::move(tile.mpBitmap);
+
+          tile.mpBitmap = pBitmap;
+
+          tile.mpBitmapImage = pFrame;
+
+          gs::FrameClock::GetInstance().Invalidate(this, tile.mRect);
+
+          if (tile.mJob.mIsStale || tile.mFrames.IsDirty())
+          {
+            RequestTile(stream);
+          }
+        });
+    });
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void MultiImageWindow::RequestTiles()
+{
+  for (std::size_t stream = 0; stream < mTiles.size(); ++stream)
+  {
+    RequestTile(stream);
+  }
+}
+
+//------------------------------------------------------------------------------
+// The tile's own period, stretched to the small tile period for a tile too
+// small for anyone to follow it at full rate.
+//------------------------------------------------------------------------------
+std::chrono::milliseconds MultiImageWindow::DoGetFramePeriod(
+  const Tile& tile) const
+{
+  if (
+    tile.mRect.GetWidth() < mFullRateSize.GetWidth() ||
+    tile.mRect.GetHeight() < mFullRateSize.GetHeight())
+  {
+    return std::max(tile.mFramePeriod, mSmallTilePeriod);
+  }
+  return tile.mFramePeriod;
+}
+
+//------------------------------------------------------------------------------
+// Gui thread.  Moves the timer earlier if Time comes before it goes off.
+//------------------------------------------------------------------------------
+void MultiImageWindow::StartPaceTimer(Clock::time_point time)
+{
+  if (mPaceTime && *mPaceTime <= time)
+  {
+    return;
+  }
+
+  mPaceTime = time;
+
+  auto delay = std::chrono::ceil<std::chrono::milliseconds>(
+    time - Clock::now());
+
+  mPaceTimer.StartOnce(std::max(1, static_cast<int>(delay.count())));
+}
+
+//------------------------------------------------------------------------------
+// The image fitted into the tile keeping its aspect ratio, centred.
+//------------------------------------------------------------------------------
+wxRect MultiImageWindow::DoGetImageRect(
+  const dl::image::Image& image,
+  const wxRect& tileRect)
+{
+  if (tileRect.IsEmpty() || image.GetWidth() == 0 || image.GetHeight() == 0)
+  {
+    return wxRect();
+  }
+
+  auto scale = std::min(
+    static_cast<double>(tileRect.GetWidth()) / image.GetWidth(),
+    static_cast<double>(tileRect.GetHeight()) / image.GetHeight());
+
+  wxSize size(
+    std::max(1L, std::lround(image.GetWidth() * scale)),
+    std::max(1L, std::lround(image.GetHeight() * scale)));
+
+  return wxRect(
+    tileRect.GetX() + (tileRect.GetWidth() - size.GetWidth()) / 2,
+    tileRect.GetY() + (tileRect.GetHeight() - size.GetHeight()) / 2,
+    size.GetWidth(),
+    size.GetHeight());
+}
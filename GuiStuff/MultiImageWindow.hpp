@@ -0,0 +1,202 @@
+#pragma once
+
+#include <GuiStuff/FrameFeed.hpp>
+#include <GuiStuff/FrameRing.hpp>
+#include <GuiStuff/ImagePyramid.hpp>
+#include <GuiStuff/ImageScaler.hpp>
+
+#include <DanLib/Images/Image.hpp>
+
+#include <wx/bitmap.h>
+#include <wx/gdicmn.h>
+#include <wx/timer.h>
+#include <wx/window.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // Shows any number of image streams side by side, as an even grid or as a
+  // mosaic of one large primary tile bordered by small ones.  Every tile is
+  // scaled on the shared worker pool to just its size on screen, at its own
+  // frame rate: streams that are hidden aren't scaled at all and tiles
+  // smaller than the full rate size are only updated every small tile
+  // period, however fast their frames arrive.
+  //----------------------------------------------------------------------------
+  class MultiImageWindow : public wxWindow
+  {
+    public:
+
+      enum class Layout
+      {
+        Grid,
+        Mosaic
+      };
+
+      struct FrameCounters
+      {
+        uint64_t mPublishedCount;
+
+        uint64_t mDisplayedCount;
+
+        // superseded before they were shown, decimated frames included
+        uint64_t mSkippedCount;
+      };
+
+      MultiImageWindow(wxWindow* pParent, std::size_t StreamCount);
+
+      std::size_t GetStreamCount() const;
+
+      // Any thread.
+      void SetImage(
+        std::size_t Stream,
+        const std::shared_ptr<const dl::image::Image>& pImage,
+        const PixelFormat& Format = {});
+
+      // Shows the frames a producer process publishes to frame ring
+      // RingName, see PictureInPictureWindow::AttachImage1.
+      void AttachImage(std::size_t Stream, const std::string& RingName);
+
+      void SetLayout(Layout Layout);
+
+      // Columns of the grid, or tiles along a side of the mosaic, 0 to fit
+      // the streams shown (the default).
+      void SetColumnCount(std::size_t ColumnCount);
+
+      // The primary stream is the first tile of the grid and the large one
+      // of the mosaic.  Double clicking a tile promotes it.
+      void SetPrimary(std::size_t Stream);
+
+      std::size_t GetPrimary() const;
+
+      // A hidden stream keeps taking frames but gives its tile up and is
+      // never scaled.
+      void ShowStream(std::size_t Stream, bool IsShown = true);
+
+      // Shows at most one frame of Stream per Period, 0 for every frame.
+      void SetFramePeriod(std::size_t Stream, std::chrono::milliseconds Period);
+
+      // Tiles narrower or shorter than FullRateSize show at most one frame
+      // per SmallTilePeriod, 320x240 and 100 ms by default.
+      void SetDecimation(
+        const wxSize& FullRateSize,
+        std::chrono::milliseconds SmallTilePeriod);
+
+      void SetScaleFilter(ScaleFilter Filter);
+
+      FrameCounters GetFrameCounters(std::size_t Stream) const;
+
+      uint64_t GetPaintCount() const;
+
+    private:
+
+      using Clock = std::chrono::steady_clock;
+
+      enum
+      {
+        PaceTimerId = wxID_HIGHEST + 1
+      };
+
+      //------------------------------------------------------------------------
+      // Gui thread only past the feed.  A frame not yet due stays in
+      // mFrames, so frames arriving faster than the tile's period just
+      // supersede each other.  One scaling job per tile at a time.
+      //------------------------------------------------------------------------
+      struct Tile : FrameFeed
+      {
+        bool mIsShown = true;
+
+        // empty while hidden
+        wxRect mRect;
+
+        ScaleJob mJob;
+
+        std::shared_ptr<wxBitmap> mpBitmap;
+
+        // the frame mpBitmap shows
+        std::weak_ptr<const dl::image::Image> mpBitmapImage;
+
+        std::chrono::milliseconds mFramePeriod {0};
+
+        Clock::time_point mNextFrameTime;
+      };
+
+      void ConnectWxStuff();
+
+      void OnPaint(wxPaintEvent& Event);
+
+      void OnResize(wxSizeEvent& Event);
+
+      void OnLeftClickDoubleClick(wxMouseEvent& Event);
+
+      void OnPaceTimer(wxTimerEvent& Event);
+
+      void UpdateLayout();
+
+      std::vector<wxRect> DoGetGridRects(std::size_t TileCount) const;
+
+      std::vector<wxRect> DoGetMosaicRects(std::size_t TileCount) const;
+
+      static wxRect DoGetCellRect(
+        const wxSize& Size,
+        const wxSize& CellCount,
+        const wxRect& Cells);
+
+      void RequestTile(std::size_t Stream);
+
+      void RequestTiles();
+
+      std::chrono::milliseconds DoGetFramePeriod(const Tile& Tile) const;
+
+      void StartPaceTimer(Clock::time_point Time);
+
+      static wxRect DoGetImageRect(
+        const dl::image::Image& Image,
+        const wxRect& TileRect);
+
+    private:
+
+      std::vector<std::unique_ptr<Tile>> mTiles;
+
+      // the streams in tile order, primary first
+      std::vector<std::size_t> mOrder;
+
+      Layout mLayout;
+
+      std::size_t mColumnCount;
+
+      ScaleFilter mScaleFilter;
+
+      wxSize mFullRateSize;
+
+      std::chrono::milliseconds mSmallTilePeriod;
+
+      // worker results check this is still alive before touching the window
+      std::shared_ptr<void> mpLifetime;
+
+      // one timer for every tile with a frame not yet due
+      wxTimer mPaceTimer;
+
+      std::optional<Clock::time_point> mPaceTime;
+
+      // frames arrived while the window was hidden
+      bool mIsCatchUpPending;
+
+      uint64_t mPaintCount;
+
+      // last, so the feeds stop before anything they feed goes away
+      std::vector<std::unique_ptr<FrameRingFeed>> mFeeds;
+
+      static constexpr int mTileGap = 2;
+  };
+}
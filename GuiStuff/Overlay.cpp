@@ -0,0 +1,542 @@
+#include "Overlay.hpp"
+
+#include <wx/brush.h>
+#include <wx/pen.h>
+
+#include <algorithm>
+#include <cmath>
+
+using gs::Overlay;
+using gs::OverlayLayers;
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Whether Bounds, grown by RightMargin to the right and BottomMargin below,
+  // touch Visible.
+  //----------------------------------------------------------------------------
+  bool DoIntersects(
+    const Overlay::Bounds& bounds,
+    const Overlay::Bounds& visible,
+    float rightMargin,
+    float bottomMargin)
+  {
+    return
+      bounds.mLeft < visible.mRight &&
+      bounds.mRight + rightMargin >= visible.mLeft &&
+      bounds.mTop < visible.mBottom &&
+      bounds.mBottom + bottomMargin >= visible.mTop;
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+Overlay::Overlay()
+  : mPrimitives(),
+    mBounds(),
+    mCoordinates(),
+    mText(),
+    mTotalBounds {0.0f, 0.0f, 0.0f, 0.0f},
+    mHasLabels(false)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void Overlay::AddRect(
+  double x,
+  double y,
+  double width,
+  double height,
+  const wxColour& colour)
+{
+  Bounds bounds {
+    static_cast<float>(std::min(x, x + width)),
+    static_cast<float>(std::min(y, y + height)),
+    static_cast<float>(std::max(x, x + width)),
+    static_cast<float>(std::max(y, y + height))};
+
+  auto first = static_cast<uint32_t>(mCoordinates.size());
+
+  mCoordinates.insert(
+    mCoordinates.end(),
+    {bounds.mLeft, bounds.mTop, bounds.mRight, bounds.mBottom});
+
+  Add({Kind::Rect, DoPackColour(colour), first, 2, 0}, bounds);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void Overlay::AddPolyline(
+  const float* pCoordinates,
+  std::size_t pointCount,
+  const wxColour& colour)
+{
+  if (pointCount == 0)
+  {
+    return;
+  }
+
+  Bounds bounds {
+    pCoordinates[0],
+    pCoordinates[1],
+    pCoordinates[0],
+    pCoordinates[1]};
+
+  for (std::size_t point = 1; point < pointCount; ++point)
+  {
+    auto x = pCoordinates[point * 2];
+
+    auto y = pCoordinates[point * 2 + 1];
+
+    bounds.mLeft = std::min(bounds.mLeft, x);
+    bounds.mTop = std::min(bounds.mTop, y);
+    bounds.mRight = std::max(bounds.mRight, x);
+    bounds.mBottom = std::max(bounds.mBottom, y);
+  }
+
+  auto first = static_cast<uint32_t>(mCoordinates.size());
+
+  mCoordinates.insert(
+    mCoordinates.end(),
+    pCoordinates,
+    pCoordinates + pointCount * 2);
+
+  Add(
+    {
+      Kind::Polyline,
+      DoPackColour(colour),
+      first,
+      static_cast<uint32_t>(pointCount),
+      0},
+    bounds);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void Overlay::AddLabel(
+  double x,
+  double y,
+  const std::string& text,
+  const wxColour& colour)
+{
+  if (text.empty())
+  {
+    return;
+  }
+
+  auto anchorX = static_cast<float>(x);
+
+  auto anchorY = static_cast<float>(y);
+
+  auto first = static_cast<uint32_t>(mCoordinates.size());
+
+  mCoordinates.insert(mCoordinates.end(), {anchorX, anchorY});
+
+  auto textFirst = static_cast<uint32_t>(mText.size());
+
+  mText += text;
+
+  mHasLabels = true;
+
+  Add(
+    {
+      Kind::Label,
+      DoPackColour(colour),
+      first,
+      static_cast<uint32_t>(text.size()),
+      textFirst},
+    {anchorX, anchorY, anchorX, anchorY});
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void Overlay::Add(const Primitive& primitive, const Bounds& bounds)
+{
+  if (mPrimitives.empty())
+  {
+    mTotalBounds = bounds;
+  }
+  else
+  {
+    mTotalBounds.mLeft = std::min(mTotalBounds.mLeft, bounds.mLeft);
+    mTotalBounds.mTop = std::min(mTotalBounds.mTop, bounds.mTop);
+    mTotalBounds.mRight = std::max(mTotalBounds.mRight, bounds.mRight);
+    mTotalBounds.mBottom = std::max(mTotalBounds.mBottom, bounds.mBottom);
+  }
+
+  mPrimitives.push_back(primitive);
+
+  mBounds.push_back(bounds);
+}
+
+//------------------------------------------------------------------------------
+// Keeps the storage for the next batch.
+//------------------------------------------------------------------------------
+void Overlay::Clear()
+{
+  mPrimitives.clear();
+
+  mBounds.clear();
+
+  mCoordinates.clear();
+
+  mText.clear();
+
+  mTotalBounds = {0.0f, 0.0f, 0.0f, 0.0f};
+
+  mHasLabels = false;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t Overlay::GetPrimitiveCount() const
+{
+  return mPrimitives.size();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool Overlay::IsEmpty() const
+{
+  return mPrimitives.empty();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool Overlay::HasLabels() const
+{
+  return mHasLabels;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+const Overlay::Bounds& Overlay::GetBounds() const
+{
+  return mTotalBounds;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint32_t Overlay::DoPackColour(const wxColour& colour)
+{
+  return
+    uint32_t(colour.Red()) << 24 |
+    uint32_t(colour.Green()) << 16 |
+    uint32_t(colour.Blue()) << 8 |
+    uint32_t(colour.Alpha());
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+OverlayLayers::OverlayLayers()
+  : mLayers(),
+    mPoints(),
+    mDrawnCount(0),
+    mCulledCount(0)
+{
+}
+
+//------------------------------------------------------------------------------
+// Setting the overlay a layer already has repaints nothing.
+//------------------------------------------------------------------------------
+wxRect OverlayLayers::Set(
+  std::size_t layer,
+  std::shared_ptr<const Overlay> pOverlay,
+  double zoom,
+  const wxWindow& window)
+{
+  if (layer >= mLayers.size())
+  {
+    if (!pOverlay)
+    {
+      return wxRect();
+    }
+
+    mLayers.resize(layer + 1);
+  }
+
+  auto& current = mLayers[layer];
+
+  if (current.mpOverlay == pOverlay)
+  {
+    return wxRect();
+  }
+
+  wxRect damage;
+
+  if (current.mpOverlay)
+  {
+    damage = DoGetCanvasRect(current, zoom);
+  }
+
+  current = Layer {std::move(pOverlay), {}, wxSize(0, 0)};
+
+  if (current.mpOverlay)
+  {
+    DoMeasureLabels(current, window);
+
+    damage.Union(DoGetCanvasRect(current, zoom));
+  }
+
+  while (!mLayers.empty() && !mLayers.back().mpOverlay)
+  {
+    mLayers.pop_back();
+  }
+
+  return damage;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool OverlayLayers::IsEmpty() const
+{
+  return mLayers.empty();
+}
+
+//------------------------------------------------------------------------------
+// Culling is done in image pixels against Area taken back through Zoom, a
+// whole layer at once when none of it is in view, then primitive by
+// primitive.  Rects and polylines under a pixel across at Zoom are skipped,
+// and so are polyline points landing on the pixel of the one before, so a
+// long track zoomed out costs about its length on screen.  The pen only
+// changes with the colour.
+//------------------------------------------------------------------------------
+void OverlayLayers::Draw(wxDC& dc, const wxRect& area, double zoom)
+{
+  if (mLayers.empty() || area.IsEmpty())
+  {
+    return;
+  }
+
+  Overlay::Bounds visible {
+    static_cast<float>(area.GetLeft() / zoom),
+    static_cast<float>(area.GetTop() / zoom),
+    static_cast<float>((area.GetRight() + 1) / zoom),
+    static_cast<float>((area.GetBottom() + 1) / zoom)};
+
+  auto minimumSize = static_cast<float>(1.0 / zoom);
+
+  auto isColourSet = false;
+
+  uint32_t colour = 0;
+
+  dc.SetBrush(*wxTRANSPARENT_BRUSH);
+
+  for (const auto& layer : mLayers)
+  {
+    const auto* pOverlay = layer.mpOverlay.get();
+
+    if (!pOverlay || pOverlay->IsEmpty())
+    {
+      continue;
+    }
+
+    if (
+      !DoIntersects(
+        pOverlay->mTotalBounds,
+        visible,
+        static_cast<float>(layer.mLabelExtent.GetWidth() / zoom),
+        static_cast<float>(layer.mLabelExtent.GetHeight() / zoom)))
+    {
+      mCulledCount += pOverlay->mPrimitives.size();
+
+      continue;
+    }
+
+    std::size_t label = 0;
+
+    for (std::size_t index = 0; index < pOverlay->mPrimitives.size(); ++index)
+    {
+      const auto& primitive = pOverlay->mPrimitives[index];
+
+      const auto& bounds = pOverlay->mBounds[index];
+
+      auto isLabel = primitive.mKind == Overlay::Kind::Label;
+
+      auto extent = isLabel ? layer.mLabelExtents[label++] : wxSize(0, 0);
+
+      auto isTooSmall =
+        !isLabel &&
+        bounds.mRight - bounds.mLeft < minimumSize &&
+        bounds.mBottom - bounds.mTop < minimumSize;
+
+      if (
+        isTooSmall ||
+        !DoIntersects(
+          bounds,
+          visible,
+          static_cast<float>(extent.GetWidth() / zoom),
+          static_cast<float>(extent.GetHeight() / zoom)))
+      {
+        ++mCulledCount;
+
+        continue;
+      }
+
+      if (!isColourSet || primitive.mColour != colour)
+      {
+        colour = primitive.mColour;
+
+        isColourSet = true;
+
+        wxColour penColour(
+          colour >> 24,
+          (colour >> 16) & 0xff,
+          (colour >> 8) & 0xff,
+          colour & 0xff);
+
+        dc.SetPen(wxPen(penColour));
+
+        dc.SetTextForeground(penColour);
+      }
+
+      const auto* pCoordinates = &pOverlay->mCoordinates[primitive.mFirst];
+
+      switch (primitive.mKind)
+      {
+        case Overlay::Kind::Rect:
+        {
+          auto left = std::lround(pCoordinates[0] * zoom);
+
+          auto top = std::lround(pCoordinates[1] * zoom);
+
+          dc.DrawRectangle(
+            left,
+            top,
+            std::max(1L, std::lround(pCoordinates[2] * zoom) - left),
+            std::max(1L, std::lround(pCoordinates[3] * zoom) - top));
+
+          break;
+        }
+
+        case Overlay::Kind::Polyline:
+        {
+          DrawPolyline(dc, *pOverlay, primitive, zoom);
+
+          break;
+        }
+
+        case Overlay::Kind::Label:
+        {
+          dc.DrawText(
+            wxString::FromUTF8(
+              pOverlay->mText.data() + primitive.mTextFirst,
+              primitive.mCount),
+            std::lround(pCoordinates[0] * zoom),
+            std::lround(pCoordinates[1] * zoom));
+
+          break;
+        }
+      }
+
+      ++mDrawnCount;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void OverlayLayers::DrawPolyline(
+  wxDC& dc,
+  const Overlay& overlay,
+  const Overlay::Primitive& primitive,
+  double zoom)
+{
+  const auto* pCoordinates = &overlay.mCoordinates[primitive.mFirst];
+
+  mPoints.clear();
+
+  for (uint32_t point = 0; point < primitive.mCount; ++point)
+  {
+    wxPoint position(
+      std::lround(pCoordinates[point * 2] * zoom),
+      std::lround(pCoordinates[point * 2 + 1] * zoom));
+
+    if (mPoints.empty() || position != mPoints.back())
+    {
+      mPoints.push_back(position);
+    }
+  }
+
+  if (mPoints.size() == 1)
+  {
+    dc.DrawRectangle(mPoints[0].x, mPoints[0].y, 1, 1);
+  }
+  else
+  {
+    dc.DrawLines(static_cast<int>(mPoints.size()), mPoints.data());
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t OverlayLayers::GetDrawnCount() const
+{
+  return mDrawnCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t OverlayLayers::GetCulledCount() const
+{
+  return mCulledCount;
+}
+
+//------------------------------------------------------------------------------
+// Once per overlay set, so a label costs nothing to measure when drawn.
+//------------------------------------------------------------------------------
+void OverlayLayers::DoMeasureLabels(Layer& layer, const wxWindow& window)
+{
+  const auto& overlay = *layer.mpOverlay;
+
+  if (!overlay.HasLabels())
+  {
+    return;
+  }
+
+  for (const auto& primitive : overlay.mPrimitives)
+  {
+    if (primitive.mKind == Overlay::Kind::Label)
+    {
+      auto extent = window.GetTextExtent(
+        wxString::FromUTF8(
+          overlay.mText.data() + primitive.mTextFirst,
+          primitive.mCount));
+
+      layer.mLabelExtents.push_back(extent);
+
+      layer.mLabelExtent.IncTo(extent);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// A pixel of slack all round for the pen, labels reaching as far right and
+// down as the widest and tallest of them.
+//------------------------------------------------------------------------------
+wxRect OverlayLayers::DoGetCanvasRect(const Layer& layer, double zoom)
+{
+  const auto& overlay = *layer.mpOverlay;
+
+  if (overlay.IsEmpty())
+  {
+    return wxRect();
+  }
+
+  const auto& bounds = overlay.GetBounds();
+
+  auto left = static_cast<int>(std::floor(bounds.mLeft * zoom)) - 1;
+
+  auto top = static_cast<int>(std::floor(bounds.mTop * zoom)) - 1;
+
+  auto right =
+    static_cast<int>(std::ceil(bounds.mRight * zoom)) + 1 +
+    layer.mLabelExtent.GetWidth();
+
+  auto bottom =
+    static_cast<int>(std::ceil(bounds.mBottom * zoom)) + 1 +
+    layer.mLabelExtent.GetHeight();
+
+  return wxRect(left, top, right - left + 1, bottom - top + 1);
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <wx/colour.h>
+#include <wx/dc.h>
+#include <wx/gdicmn.h>
+#include <wx/window.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // A batch of annotations, in pixels of the image they are drawn over.
+  // Primitives are packed into a few flat buffers, their coordinates and
+  // bounds as floats and label text in one string, so thousands of them cost
+  // a handful of allocations.  Build one on any thread then hand it to a
+  // widget, which shares it from then on: it must not change after that.
+  //----------------------------------------------------------------------------
+  class Overlay
+  {
+    public:
+
+      struct Bounds
+      {
+        float mLeft;
+
+        float mTop;
+
+        float mRight;
+
+        float mBottom;
+      };
+
+      Overlay();
+
+      // An outline, Width by Height pixels from X, Y.
+      void AddRect(
+        double X,
+        double Y,
+        double Width,
+        double Height,
+        const wxColour& Colour);
+
+      // PointCount points, pCoordinates holding x, y of each in turn.
+      void AddPolyline(
+        const float* pCoordinates,
+        std::size_t PointCount,
+        const wxColour& Colour);
+
+      // Text with its top left corner at X, Y.  Labels keep their size on
+      // screen whatever the zoom.
+      void AddLabel(
+        double X,
+        double Y,
+        const std::string& Text,
+        const wxColour& Colour);
+
+      void Clear();
+
+      std::size_t GetPrimitiveCount() const;
+
+      bool IsEmpty() const;
+
+      bool HasLabels() const;
+
+      // Of every primitive, labels only by their anchor.
+      const Bounds& GetBounds() const;
+
+    private:
+
+      friend class OverlayLayers;
+
+      enum class Kind : uint8_t
+      {
+        Rect,
+        Polyline,
+        Label
+      };
+
+      //------------------------------------------------------------------------
+      // A rect is the two corners at mFirst of mCoordinates, a polyline its
+      // mCount points from there and a label its anchor there with mCount
+      // bytes of mText from mTextFirst.
+      //------------------------------------------------------------------------
+      struct Primitive
+      {
+        Kind mKind;
+
+        uint32_t mColour;
+
+        uint32_t mFirst;
+
+        uint32_t mCount;
+
+        uint32_t mTextFirst;
+      };
+
+      void Add(const Primitive& Primitive, const Bounds& Bounds);
+
+      static uint32_t DoPackColour(const wxColour& Colour);
+
+    private:
+
+      std::vector<Primitive> mPrimitives;
+
+      // one per primitive, for culling
+      std::vector<Bounds> mBounds;
+
+      std::vector<float> mCoordinates;
+
+      std::string mText;
+
+      Bounds mTotalBounds;
+
+      bool mHasLabels;
+  };
+
+  //----------------------------------------------------------------------------
+  // The overlays an image widget draws over its image, lowest layer first.
+  // Drawing happens in canvas coordinates, the image times the widget's zoom,
+  // and skips whatever falls outside the damaged area or is too small to
+  // see at that zoom, so an unchanged overlay costs nothing until its part
+  // of the canvas is repainted.  Gui thread only.
+  //----------------------------------------------------------------------------
+  class OverlayLayers
+  {
+    public:
+
+      OverlayLayers();
+
+      // Replaces Layer, nullptr removes it.  Returns the part of the canvas,
+      // at Zoom, to repaint for it: the old and the new overlay's bounds.
+      // Labels are measured in the font of Window, the one they are drawn
+      // in.
+      wxRect Set(
+        std::size_t Layer,
+        std::shared_ptr<const Overlay> pOverlay,
+        double Zoom,
+        const wxWindow& Window);
+
+      bool IsEmpty() const;
+
+      // Draws what lies in Area of the canvas at Zoom.
+      void Draw(wxDC& Dc, const wxRect& Area, double Zoom);
+
+      uint64_t GetDrawnCount() const;
+
+      uint64_t GetCulledCount() const;
+
+    private:
+
+      struct Layer
+      {
+        std::shared_ptr<const Overlay> mpOverlay;
+
+        // on screen size of each label, in the order they were added
+        std::vector<wxSize> mLabelExtents;
+
+        // the largest of mLabelExtents
+        wxSize mLabelExtent;
+      };
+
+      static void DoMeasureLabels(Layer& Layer, const wxWindow& Window);
+
+      static wxRect DoGetCanvasRect(const Layer& Layer, double Zoom);
+
+      void DrawPolyline(
+        wxDC& Dc,
+        const Overlay& Overlay,
+        const Overlay::Primitive& Primitive,
+        double Zoom);
+
+    private:
+
+      std::vector<Layer> mLayers;
+
+      // reused by every polyline drawn
+      std::vector<wxPoint> mPoints;
+
+      uint64_t mDrawnCount;
+
+      uint64_t mCulledCount;
+  };
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <GuiStuff/CellFormatter.hpp>
+#include <GuiStuff/FrameClock.hpp>
+#include <GuiStuff/PacketHistory.hpp>
+#include <GuiStuff/PacketSchema.hpp>
+
+#include <wx/grid.h>
+
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // Read only single row table that formats cells straight out of a packet
+  // owned by someone else.  wx only asks for cells it is about to draw, so
+  // fields that are scrolled out of view cost nothing.
+  //----------------------------------------------------------------------------
+  template <typename PacketType>
+  class PacketGridTable : public wxGridTableBase
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      explicit PacketGridTable(const PacketType& packet)
+        : wxGridTableBase(),
+          mPacket(packet),
+          mBuffer()
+      {
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      int GetNumberRows() override
+      {
+        return 1;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      int GetNumberCols() override
+      {
+        return schema::FieldCount<PacketType>;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      wxString GetValue(int, int col) override
+      {
+        auto text = FieldFormatter<PacketType>::Format(mPacket, col, mBuffer);
+
+        return wxString::FromAscii(text.data(), text.size());
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void SetValue(int, int, const wxString&) override
+      {
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      bool IsEmptyCell(int, int) override
+      {
+        return false;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      wxString GetColLabelValue(int col) override
+      {
+        return schema::FieldLabels<PacketType>[col].c_str();
+      }
+
+    private:
+
+      const PacketType& mPacket;
+
+      FormatBuffer mBuffer;
+  };
+
+  //----------------------------------------------------------------------------
+  // One row per packet held in a PacketHistory, oldest first.  The row count
+  // wx sees only changes in Synchronize so that it stays consistent with what
+  // the grid has been told.
+  //----------------------------------------------------------------------------
+  template <typename PacketType>
+  class HistoryGridTable : public wxGridTableBase
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      explicit HistoryGridTable(const PacketHistory<PacketType>& history)
+        : wxGridTableBase(),
+          mHistory(history),
+          mRowCount(0),
+          mBuffer()
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Gui thread only.  Tells the grid about rows pushed since the last call
+      // and repaints what is visible.
+      //------------------------------------------------------------------------
+      void Synchronize()
+      {
+        auto size = mHistory.GetSize();
+
+        if (size > mRowCount)
+        {
+          auto appendedCount = size - mRowCount;
+
+          mRowCount = size;
+
+          if (auto pGrid = GetView())
+          {
+            wxGridTableMessage message(
+              this,
+              wxGRIDTABLE_NOTIFY_ROWS_APPENDED,
+              appendedCount);
+
+            pGrid->ProcessTableMessage(message);
+          }
+        }
+
+        if (auto pGrid = GetView())
+        {
+          gs::FrameClock::GetInstance().Invalidate(pGrid->GetGridWindow());
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      int GetNumberRows() override
+      {
+        return mRowCount;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      int GetNumberCols() override
+      {
+        return schema::FieldCount<PacketType>;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      wxString GetValue(int row, int col) override
+      {
+        auto text = mHistory.Format(row, col, mBuffer);
+
+        return wxString::FromAscii(text.data(), text.size());
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void SetValue(int, int, const wxString&) override
+      {
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      bool IsEmptyCell(int, int) override
+      {
+        return false;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      wxString GetColLabelValue(int col) override
+      {
+        return schema::FieldLabels<PacketType>[col].c_str();
+      }
+
+    private:
+
+      const PacketHistory<PacketType>& mHistory;
+
+      std::size_t mRowCount;
+
+      FormatBuffer mBuffer;
+  };
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <GuiStuff/CellFormatter.hpp>
+#include <GuiStuff/PacketSchema.hpp>
+#include <GuiStuff/StampedSlots.hpp>
+
+#include <boost/hana.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename PacketType, std::size_t Index>
+  using FieldType = std::decay_t<decltype(
+    boost::hana::second(
+      boost::hana::at_c<Index>(boost::hana::accessors<PacketType>()))(
+        std::declval<const PacketType&>()))>;
+
+  //----------------------------------------------------------------------------
+  // The last Capacity packets of one type, stored one preallocated ring buffer
+  // per field.  Push is O(1), never allocates and never locks: slots are
+  // stamped as in StampedSlots, so the gui thread formatting cells never
+  // holds up a producer.  Rows are counted from the oldest packet still held.
+  //----------------------------------------------------------------------------
+  template <typename PacketType>
+  class PacketHistory
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      explicit PacketHistory(std::size_t capacity)
+        : mCapacity(capacity),
+          mSlots(capacity),
+          mColumns(MakeColumns(capacity, Indices()))
+      {
+      }
+
+      PacketHistory(const PacketHistory&) = delete;
+
+      PacketHistory& operator = (const PacketHistory&) = delete;
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void Push(const PacketType& packet)
+      {
+        if (mCapacity == 0)
+        {
+          return;
+        }
+
+        if (auto index = mSlots.BeginWrite())
+        {
+          Store(packet, mSlots.GetSlot(*index), Indices());
+
+          mSlots.EndWrite(*index);
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      std::size_t GetSize() const
+      {
+        return static_cast<std::size_t>(
+          std::min<uint64_t>(GetTotalCount(), mCapacity));
+      }
+
+      //------------------------------------------------------------------------
+      // Number of packets ever pushed, including ones that have been
+      // overwritten.
+      //------------------------------------------------------------------------
+      uint64_t GetTotalCount() const
+      {
+        return mCapacity == 0 ? 0 : mSlots.GetCount();
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      std::size_t GetCapacity() const
+      {
+        return mCapacity;
+      }
+
+      //------------------------------------------------------------------------
+      // Empty while the row's packet is still being written or once it has
+      // been overwritten.
+      //------------------------------------------------------------------------
+      std::string_view Format(
+        std::size_t row,
+        std::size_t column,
+        FormatBuffer& buffer) const
+      {
+        auto totalCount = GetTotalCount();
+
+        auto size = std::min<uint64_t>(totalCount, mCapacity);
+
+        if (row >= size)
+        {
+          return std::string_view();
+        }
+
+        return mFormatters[column](*this, totalCount - size + row, buffer);
+      }
+
+    private:
+
+      using Indices = std::make_index_sequence<schema::FieldCount<PacketType>>;
+
+      template <typename Sequence>
+      struct ColumnsImpl;
+
+      template <std::size_t ... FieldIndices>
+      struct ColumnsImpl<std::index_sequence<FieldIndices...>>
+      {
+        using Type =
+          std::tuple<
+            std::vector<std::atomic<FieldType<PacketType, FieldIndices>>>...>;
+      };
+
+      using Columns = typename ColumnsImpl<Indices>::Type;
+
+      using FormatFunction =
+        std::string_view (*)(const PacketHistory&, uint64_t, FormatBuffer&);
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t ... FieldIndices>
+      static Columns MakeColumns(
+        std::size_t capacity,
+        std::index_sequence<FieldIndices...>)
+      {
+        return Columns(
+          std::vector<std::atomic<FieldType<PacketType, FieldIndices>>>(
+            capacity)...);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t ... FieldIndices>
+      void Store(
+        const PacketType& packet,
+        std::size_t iSlot,
+        std::index_sequence<FieldIndices...>)
+      {
+        namespace hana = boost::hana;
+
+        constexpr auto accessors = hana::accessors<PacketType>();
+
+        (std::get<FieldIndices>(mColumns)[iSlot].store(
+          hana::second(hana::at_c<FieldIndices>(accessors))(packet),
+          std::memory_order_relaxed), ...);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t FieldIndex>
+      static std::string_view FormatField(
+        const PacketHistory& history,
+        uint64_t index,
+        FormatBuffer& buffer)
+      {
+        if (!history.mSlots.BeginRead(index))
+        {
+          return std::string_view();
+        }
+
+        const auto& column = std::get<FieldIndex>(history.mColumns);
+
+        auto value =
+          column[history.mSlots.GetSlot(index)].load(std::memory_order_relaxed);
+
+        if (!history.mSlots.EndRead(index))
+        {
+          return std::string_view();
+        }
+
+        return FormatValue(value, buffer);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t ... FieldIndices>
+      static constexpr auto MakeFormatters(std::index_sequence<FieldIndices...>)
+      {
+        return std::array<FormatFunction, sizeof...(FieldIndices)> {
+          &FormatField<FieldIndices>...};
+      }
+
+      static constexpr auto mFormatters = MakeFormatters(Indices());
+
+    private:
+
+      std::size_t mCapacity;
+
+      StampedSlots mSlots;
+
+      Columns mColumns;
+  };
+}
@@ -0,0 +1,492 @@
+#pragma once
+
+#include <GuiStuff/MappedFile.hpp>
+#include <GuiStuff/PacketSchema.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+//------------------------------------------------------------------------------
+// File layout, all little endian as written by the host:
+//
+//   RecordFileHeader
+//   uint32_t packet size for each type in the recorder's type list
+//   records starting at mDataOffset, each a RecordHeader followed by the raw
+//   packet, padded to 8 bytes
+//
+// mDataSize and mRecordCount are only filled in when the recorder closes the
+// file.  While they are 0 the records are found by walking their headers.
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct RecordFileHeader
+  {
+    static constexpr uint64_t mExpectedMagic = 0x3130434552534755; // "UGSREC01"
+
+    uint64_t mMagic;
+
+    uint32_t mTypeCount;
+
+    uint32_t mDataOffset;
+
+    uint64_t mDataSize;
+
+    uint64_t mRecordCount;
+  };
+
+  //----------------------------------------------------------------------------
+  // mType is the index in the type list plus one so that the zero filled tail
+  // of an unfinished file reads as the end of the records.
+  //----------------------------------------------------------------------------
+  struct RecordHeader
+  {
+    int64_t mTimestamp;
+
+    uint32_t mType;
+
+    uint32_t mSize;
+  };
+
+  namespace record
+  {
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    constexpr std::size_t AlignUp(std::size_t size, std::size_t alignment)
+    {
+      return (size + alignment - 1) / alignment * alignment;
+    }
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    template <typename T>
+    inline constexpr std::size_t RecordSize =
+      AlignUp(sizeof(RecordHeader) + sizeof(T), 8);
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    template <typename ... Args>
+    inline constexpr std::size_t DataOffset = AlignUp(
+      sizeof(RecordFileHeader) + sizeof(uint32_t) * sizeof...(Args),
+      64);
+  }
+
+  //----------------------------------------------------------------------------
+  // Appends every packet handed to Record to a memory mapped file.  Space is
+  // reserved with a single atomic add so any number of threads can record
+  // without locking or allocating; once the file is full further packets are
+  // counted as dropped.  Each record's header is written after its packet, so
+  // a file left by a process killed mid capture still replays up to the first
+  // record that was being written.  The file is complete once the recorder
+  // is closed, or destroyed, which closes it too but can't report failing
+  // to.
+  //----------------------------------------------------------------------------
+  template <typename ... Args>
+  class PacketRecorder
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      PacketRecorder(const std::string& filename, std::size_t capacity)
+        : mFile(filename, record::DataOffset<Args...> + capacity),
+          mpData(mFile.GetData() + record::DataOffset<Args...>),
+          mCapacity(capacity),
+          mStartTime(std::chrono::steady_clock::now()),
+          mWriteOffset(0),
+          mDataSize(capacity),
+          mRecordCount(0),
+          mDroppedCount(0),
+          mIsClosed(false)
+      {
+        static_assert(
+          (std::is_trivially_copyable_v<Args> && ...),
+          "only trivially copyable packets can be recorded");
+
+        RecordFileHeader header;
+
+        header.mMagic = RecordFileHeader::mExpectedMagic;
+
+        header.mTypeCount = sizeof...(Args);
+
+        header.mDataOffset = record::DataOffset<Args...>;
+
+        header.mDataSize = 0;
+
+        header.mRecordCount = 0;
+
+        std::memcpy(mFile.GetData(), &header, sizeof(header));
+
+        std::array<uint32_t, sizeof...(Args)> sizes {
+          static_cast<uint32_t>(sizeof(Args))...};
+
+        std::memcpy(
+          mFile.GetData() + sizeof(header),
+          sizes.data(),
+          sizeof(uint32_t) * sizes.size());
+      }
+
+      //------------------------------------------------------------------------
+      // An error closing the file is lost here, Close first to see it.
+      //------------------------------------------------------------------------
+      ~PacketRecorder()
+      {
+        try
+        {
+          Close();
+        }
+        catch (...)
+        {
+        }
+      }
+
+      PacketRecorder(const PacketRecorder&) = delete;
+
+      PacketRecorder& operator = (const PacketRecorder&) = delete;
+
+      //------------------------------------------------------------------------
+      // Fills in the file header and cuts the file down to what was recorded,
+      // throwing if that fails.  Nothing may be recorded once this is called,
+      // calling it again does nothing.
+      //------------------------------------------------------------------------
+      void Close()
+      {
+        if (mIsClosed)
+        {
+          return;
+        }
+
+        mIsClosed = true;
+
+        auto dataSize = std::min<uint64_t>(
+          mDataSize.load(),
+          std::min<uint64_t>(mWriteOffset.load(), mCapacity));
+
+        RecordFileHeader header;
+
+        std::memcpy(&header, mFile.GetData(), sizeof(header));
+
+        header.mDataSize = dataSize;
+
+        header.mRecordCount = mRecordCount.load();
+
+        std::memcpy(mFile.GetData(), &header, sizeof(header));
+
+        mFile.Close(record::DataOffset<Args...> + dataSize);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <typename T>
+      void Record(const T& packet)
+      {
+        constexpr auto index = schema::IndexOf<T, std::tuple<Args...>>;
+
+        static_assert(index < sizeof...(Args), "Record called with unknown type");
+
+        constexpr auto size = record::RecordSize<T>;
+
+        auto offset = mWriteOffset.fetch_add(size, std::memory_order_relaxed);
+
+        if (offset + size > mCapacity)
+        {
+          // remember where the file really ends, later reservations can only
+          // start further along
+          auto dataSize = mDataSize.load(std::memory_order_relaxed);
+
+          while (
+            offset < dataSize &&
+            !mDataSize.compare_exchange_weak(
+              dataSize,
+              offset,
+              std::memory_order_relaxed))
+          {
+          }
+
+          mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+
+          return;
+        }
+
+        RecordHeader header;
+
+        header.mTimestamp =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - mStartTime).count();
+
+        header.mType = index + 1;
+
+        header.mSize = sizeof(T);
+
+        std::memcpy(mpData + offset + sizeof(header), &packet, sizeof(T));
+
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::memcpy(mpData + offset, &header, sizeof(header));
+
+        mRecordCount.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      uint64_t GetRecordCount() const
+      {
+        return mRecordCount.load(std::memory_order_relaxed);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      uint64_t GetDroppedCount() const
+      {
+        return mDroppedCount.load(std::memory_order_relaxed);
+      }
+
+    private:
+
+      MappedFile mFile;
+
+      std::byte* mpData;
+
+      std::size_t mCapacity;
+
+      std::chrono::steady_clock::time_point mStartTime;
+
+      alignas(64) std::atomic<uint64_t> mWriteOffset;
+
+      std::atomic<uint64_t> mDataSize;
+
+      std::atomic<uint64_t> mRecordCount;
+
+      std::atomic<uint64_t> mDroppedCount;
+
+      bool mIsClosed;
+  };
+
+  //----------------------------------------------------------------------------
+  // Plays a file written by PacketRecorder<Args...> into anything with a
+  // Set<T>(T) for each type, typically a GridDisplayer<Args...>.  A speed of 1
+  // keeps the recorded timing, 2 plays twice as fast and 0 plays as fast as
+  // the sink will take the packets.  Playing stops at the first record that
+  // isn't one of Args or doesn't fit in the file, so a truncated or
+  // unfinished recording plays what it holds.
+  //----------------------------------------------------------------------------
+  template <typename ... Args>
+  class PacketReplayer
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      explicit PacketReplayer(const std::string& filename)
+        : mFile(filename),
+          mHeader(),
+          mIsStopped(false)
+      {
+        if (mFile.GetSize() < record::DataOffset<Args...>)
+        {
+          throw std::runtime_error(filename + " is not a packet recording");
+        }
+
+        std::memcpy(&mHeader, mFile.GetData(), sizeof(mHeader));
+
+        if (mHeader.mMagic != RecordFileHeader::mExpectedMagic)
+        {
+          throw std::runtime_error(filename + " is not a packet recording");
+        }
+
+        std::array<uint32_t, sizeof...(Args)> expectedSizes {
+          static_cast<uint32_t>(sizeof(Args))...};
+
+        std::array<uint32_t, sizeof...(Args)> sizes;
+
+        std::memcpy(
+          sizes.data(),
+          mFile.GetData() + sizeof(mHeader),
+          sizeof(uint32_t) * sizes.size());
+
+        if (
+          mHeader.mTypeCount != sizeof...(Args) ||
+          mHeader.mDataOffset != record::DataOffset<Args...> ||
+          sizes != expectedSizes)
+        {
+          throw std::runtime_error(
+            filename + " was recorded with different packet types");
+        }
+
+        auto available = mFile.GetSize() - mHeader.mDataOffset;
+
+        if (mHeader.mDataSize == 0 && mHeader.mRecordCount == 0)
+        {
+          // never closed, find where the records end
+          mHeader.mDataSize = available;
+
+          auto pData = mFile.GetData() + mHeader.mDataOffset;
+
+          uint64_t offset = 0;
+
+          while (auto recordSize = DoGetRecordSize(pData, offset))
+          {
+            offset += recordSize;
+
+            ++mHeader.mRecordCount;
+          }
+
+          mHeader.mDataSize = offset;
+        }
+        else if (mHeader.mDataSize > available)
+        {
+          mHeader.mDataSize = available;
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      uint64_t GetRecordCount() const
+      {
+        return mHeader.mRecordCount;
+      }
+
+      //------------------------------------------------------------------------
+      // Blocks until the whole file has been played or Stop is called.
+      // Returns the number of packets played.
+      //------------------------------------------------------------------------
+      template <typename SinkType>
+      uint64_t Replay(SinkType& sink, double speed = 1.0)
+      {
+        mIsStopped = false;
+
+        auto pData = mFile.GetData() + mHeader.mDataOffset;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        uint64_t playedCount = 0;
+
+        std::size_t offset = 0;
+
+        while (!mIsStopped.load(std::memory_order_relaxed))
+        {
+          auto recordSize = DoGetRecordSize(pData, offset);
+
+          if (recordSize == 0)
+          {
+            break;
+          }
+
+          RecordHeader header;
+
+          std::memcpy(&header, pData + offset, sizeof(header));
+
+          if (speed > 0.0)
+          {
+            std::this_thread::sleep_until(
+              startTime +
+              std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::nano>(
+                  header.mTimestamp / speed)));
+          }
+
+          auto pPacket = pData + offset + sizeof(header);
+
+          Dispatch(
+            sink,
+            header.mType - 1,
+            pPacket,
+            std::index_sequence_for<Args...>());
+
+          offset += recordSize;
+
+          ++playedCount;
+        }
+
+        return playedCount;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void Stop()
+      {
+        mIsStopped = true;
+      }
+
+    private:
+
+      //------------------------------------------------------------------------
+      // Of the record at offset of pData, 0 when there is no whole record of
+      // one of Args there within mDataSize.
+      //------------------------------------------------------------------------
+      std::size_t DoGetRecordSize(const std::byte* pData, uint64_t offset) const
+      {
+        static constexpr std::array<std::size_t, sizeof...(Args)> packetSizes {
+          sizeof(Args)...};
+
+        static constexpr std::array<std::size_t, sizeof...(Args)> recordSizes {
+          record::RecordSize<Args>...};
+
+        if (
+          offset > mHeader.mDataSize ||
+          mHeader.mDataSize - offset < sizeof(RecordHeader))
+        {
+          return 0;
+        }
+
+        RecordHeader header;
+
+        std::memcpy(&header, pData + offset, sizeof(header));
+
+        if (
+          header.mType == 0 ||
+          header.mType > sizeof...(Args) ||
+          header.mSize != packetSizes[header.mType - 1] ||
+          mHeader.mDataSize - offset < recordSizes[header.mType - 1])
+        {
+          return 0;
+        }
+
+        return recordSizes[header.mType - 1];
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <typename SinkType, std::size_t ... Indices>
+      static void Dispatch(
+        SinkType& sink,
+        std::size_t type,
+        const std::byte* pPacket,
+        std::index_sequence<Indices...>)
+      {
+        ((type == Indices ? (Load<Indices>(sink, pPacket), 0) : 0), ...);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      template <std::size_t Index, typename SinkType>
+      static void Load(SinkType& sink, const std::byte* pPacket)
+      {
+        using PacketType = std::tuple_element_t<Index, std::tuple<Args...>>;
+
+        PacketType packet;
+
+        std::memcpy(&packet, pPacket, sizeof(packet));
+
+        sink.Set(packet);
+      }
+
+    private:
+
+      MappedFile mFile;
+
+      RecordFileHeader mHeader;
+
+      std::atomic<bool> mIsStopped;
+  };
+}
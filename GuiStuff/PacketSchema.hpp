@@ -0,0 +1,208 @@
+#pragma once
+
+#include <boost/hana.hpp>
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+//------------------------------------------------------------------------------
+// Everything GridDisplayer needs to know about a packet type that can be
+// worked out by the compiler: where the type lives in the displayer tuple,
+// the page title and the column labels.
+//------------------------------------------------------------------------------
+namespace gs::schema
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <std::size_t Capacity>
+  struct FixedString
+  {
+    std::array<char, Capacity + 1> mData {};
+
+    std::size_t mSize = 0;
+
+    constexpr std::string_view GetView() const
+    {
+      return std::string_view(mData.data(), mSize);
+    }
+
+    constexpr const char* c_str() const
+    {
+      return mData.data();
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  constexpr bool IsUpperOrDigit(char c)
+  {
+    return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <std::size_t Capacity>
+  constexpr FixedString<Capacity> ConvertCamelCaseToSpaces(std::string_view name)
+  {
+    FixedString<Capacity> result;
+
+    for (std::size_t i = 0; i < name.size(); ++i)
+    {
+      if (i > 0 && IsUpperOrDigit(name[i]))
+      {
+        result.mData[result.mSize++] = ' ';
+      }
+
+      result.mData[result.mSize++] = name[i];
+    }
+
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename T>
+  constexpr std::string_view GetPrettyFunction()
+  {
+    return __PRETTY_FUNCTION__;
+  }
+
+  //----------------------------------------------------------------------------
+  // gcc: "... GetPrettyFunction() [with T = ns::Type; ...]"
+  // clang: "... GetPrettyFunction() [T = ns::Type]"
+  //----------------------------------------------------------------------------
+  template <typename T>
+  constexpr std::string_view GetTypeName()
+  {
+    constexpr std::string_view prettyFunction = GetPrettyFunction<T>();
+
+    constexpr auto begin = prettyFunction.find("T = ") + 4;
+
+    constexpr auto end = prettyFunction.find_first_of(";]", begin);
+
+    return prettyFunction.substr(begin, end - begin);
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename T>
+  constexpr std::string_view GetTypeNameWithoutNamespace()
+  {
+    constexpr auto name = GetTypeName<T>();
+
+    constexpr auto iName = name.rfind("::");
+
+    if constexpr (iName != std::string_view::npos)
+    {
+      return name.substr(iName + 2);
+    }
+    else
+    {
+      return name;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename T>
+  inline constexpr auto PageTitle =
+    ConvertCamelCaseToSpaces<2 * GetTypeNameWithoutNamespace<T>().size()>(
+      GetTypeNameWithoutNamespace<T>());
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename T, typename ... Args>
+  constexpr std::size_t GetIndexOf()
+  {
+    constexpr std::array<bool, sizeof...(Args)> matches {
+      std::is_same_v<std::decay_t<T>, Args>...};
+
+    for (std::size_t i = 0; i < matches.size(); ++i)
+    {
+      if (matches[i])
+      {
+        return i;
+      }
+    }
+    return matches.size();
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename T, typename TupleType>
+  struct IndexOfImpl;
+
+  template <typename T, typename ... Args>
+  struct IndexOfImpl<T, std::tuple<Args...>>
+    : std::integral_constant<std::size_t, GetIndexOf<T, Args...>()>
+  {
+  };
+
+  template <typename T, typename TupleType>
+  inline constexpr std::size_t IndexOf = IndexOfImpl<T, TupleType>::value;
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename PacketType>
+  struct Fields
+  {
+    using Keys = decltype(boost::hana::keys(std::declval<PacketType>()));
+
+    static constexpr std::size_t Count =
+      decltype(boost::hana::length(std::declval<Keys>()))::value;
+
+    template <std::size_t Index>
+    static constexpr std::string_view GetName()
+    {
+      return std::decay_t<
+        decltype(boost::hana::at_c<Index>(std::declval<Keys>()))>::c_str();
+    }
+
+    template <std::size_t ... Indices>
+    static constexpr std::size_t GetLongestName(std::index_sequence<Indices...>)
+    {
+      return std::max({std::size_t(0), GetName<Indices>().size()...});
+    }
+
+    static constexpr std::size_t LabelCapacity =
+      2 * GetLongestName(std::make_index_sequence<Count>());
+
+    using Label = FixedString<LabelCapacity>;
+
+    //remove 'm' prefix
+    template <std::size_t Index>
+    static constexpr Label MakeLabel()
+    {
+      auto name = GetName<Index>();
+
+      if (!name.empty() && name[0] == 'm')
+      {
+        name.remove_prefix(1);
+      }
+
+      return ConvertCamelCaseToSpaces<LabelCapacity>(name);
+    }
+
+    template <std::size_t ... Indices>
+    static constexpr std::array<Label, Count> MakeLabels(
+      std::index_sequence<Indices...>)
+    {
+      return {MakeLabel<Indices>()...};
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename PacketType>
+  inline constexpr std::size_t FieldCount = Fields<PacketType>::Count;
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  template <typename PacketType>
+  inline constexpr auto FieldLabels =
+    Fields<PacketType>::MakeLabels(
+      std::make_index_sequence<Fields<PacketType>::Count>());
+}
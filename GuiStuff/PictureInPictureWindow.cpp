@@ -1,8 +1,14 @@
 #include "PictureInPictureWindow.hpp"
+#include <GuiStuff/FrameClock.hpp>
 #include <GuiStuff/Helpers.hpp>
+#include <GuiStuff/WorkerPool.hpp>
 
 #include <wx/dcbuffer.h>
+#include <wx/dcmemory.h>
+#include <wx/rawbmp.h>
+#include <wx/region.h>
 
+#include <cmath>
 #include <optional>
 
 using gs::PictureInPictureWindow;
@@ -11,16 +17,47 @@ using gs::PictureInPictureWindow;
 //------------------------------------------------------------------------------
 PictureInPictureWindow::PictureInPictureWindow(wxWindow* pParent)
   : wxScrolledWindow(pParent, wxID_ANY),
-    mpImage1(nullptr),
-    mpImage2(nullptr),
-    mImageMutex(),
+    mStream1(),
+    mStream2(),
     mIsPrimaryDisplayBitmap1(true),
-    mPrimaryDisplayMutex(),
+    mWindowSize(),
+    mPrimaryJob(),
+    mThumbnailJob(),
+    mpLifetime(std::make_shared<int>(0)),
     mSecondaryViewStart(0, 0),
-    mThumbnail(),
+    mScaleFilter(gs::ScaleFilter::Nearest),
+    mpThumbnail(),
+    mThumbnailRegion(),
+    mThumbnailImageSize(),
+    mThumbnailCache(),
+    mRequestedThumbnailRegion(),
+    mpPrimaryBitmap(),
+    mPrimaryZoom(1.0),
+    mIsZoomFitted(true),
+    mPrimaryCanvasSize(0, 0),
+    mPrimaryBitmapViewport(),
+    mPrimaryBitmapZoom(0.0),
+    mIsPrimaryBitmapExact(false),
+    mpPrimaryBitmapPyramid(),
     mpDrag(nullptr),
     mViewStart(0, 0),
-    mIsMouseCaptured(false)
+    mIsMouseCaptured(false),
+    mPanTimer(this, PanTimerId),
+    mPanPosition(),
+    mIsPanPending(false),
+    mPaintCount(0),
+    mIsStatisticsEnabled(false),
+    mIsMeasuring(false),
+    mIsMeasureStale(false),
+    mpStatistics(),
+    mpStatisticsPyramid(),
+    mStatisticsRegion(),
+    mStatisticsCursor(),
+    mStatisticsDragStart(),
+    mRegionStatistics(),
+    mStatisticsOverlay(),
+    mpFeed1(),
+    mpFeed2()
 {
    Refresh();
 
@@ -39,396 +76,1453 @@ void PictureInPictureWindow::ConnectWxStuff()
   Bind(wxEVT_LEFT_DCLICK, &PictureInPictureWindow::OnLeftClickDoubleClick, this);
   Bind(wxEVT_LEFT_UP, &PictureInPictureWindow::OnLeftClickUp, this);
   Bind(wxEVT_MOTION, &PictureInPictureWindow::OnMouseMotion, this);
+  Bind(wxEVT_MOUSEWHEEL, &PictureInPictureWindow::OnMouseWheel, this);
+  Bind(wxEVT_RIGHT_DOWN, &PictureInPictureWindow::OnRightClickDown, this);
+  Bind(wxEVT_RIGHT_UP, &PictureInPictureWindow::OnRightClickUp, this);
+  Bind(wxEVT_LEAVE_WINDOW, &PictureInPictureWindow::OnMouseLeave, this);
   Bind(wxEVT_MOUSE_CAPTURE_LOST, &PictureInPictureWindow::OnMouseCaptureLost, this);
   Bind(wxEVT_PAINT, &PictureInPictureWindow::OnPaint, this);
   Bind(wxEVT_SIZE, &PictureInPictureWindow::OnResize, this);
+  Bind(wxEVT_TIMER, &PictureInPictureWindow::OnPanTimer, this, PanTimerId);
 }
 
 //------------------------------------------------------------------------------
+// Only the update region is drawn: the primary bitmap is copied rectangle by
+// rectangle, the background filled where there is no image, the primary
+// image's overlays and statistics drawn over the damaged part of it and the
+// thumbnail redrawn only if it was damaged.  Statistics are only looked up
+// as they change, never here.
 //------------------------------------------------------------------------------
 void PictureInPictureWindow::OnPaint(wxPaintEvent& event)
 {
-  wxBufferedPaintDC Dc(this);
+  wxAutoBufferedPaintDC Dc(this);
   DoPrepareDC(Dc);
 
-  Dc.Clear();
+  wxRegion damage;
 
+  for (wxRegionIterator iRect(GetUpdateRegion()); iRect; ++iRect)
   {
-    std::lock_guard lock(mImageMutex);
+    auto rect = iRect.GetRect();
 
-    if (mPrimaryBitmap.IsOk())
+    rect.SetPosition(CalcUnscrolledPosition(rect.GetPosition()));
+
+    damage.Union(rect);
+  }
+
+  wxRegion background(damage);
+
+  auto viewport = GetPrimaryViewport();
+
+  if (GetPrimaryStream().mpImage && !viewport.IsEmpty())
+  {
+    if (
+      !mpPrimaryBitmap ||
+      viewport != mPrimaryBitmapViewport ||
+      mPrimaryZoom != mPrimaryBitmapZoom)
     {
-      Dc.DrawBitmap(mPrimaryBitmap, 0, 0, true);
+      RenderPrimaryViewport(viewport);
     }
 
-    if (mThumbnail.IsOk())
+    wxMemoryDC bitmapDc(*mpPrimaryBitmap);
+
+    wxRegion visible(damage);
+
+    visible.Intersect(viewport);
+
+    for (wxRegionIterator iRect(visible); iRect; ++iRect)
     {
-      auto location = DoGetMiniWindowLocation();
+      auto rect = iRect.GetRect();
+
+      Dc.Blit(
+        rect.GetX(),
+        rect.GetY(),
+        rect.GetWidth(),
+        rect.GetHeight(),
+        &bitmapDc,
+        rect.GetX() - viewport.GetX(),
+        rect.GetY() - viewport.GetY());
+    }
+
+    background.Subtract(viewport);
+  }
 
-      Dc.SetBrush(*wxBLACK_BRUSH);
+  Dc.SetPen(*wxTRANSPARENT_PEN);
 
-      auto thumbnailSize = mThumbnail.GetSize();
+  Dc.SetBrush(wxBrush(GetBackgroundColour()));
 
-      Dc.DrawRectangle(
-        location.x - 2,
-        location.y - 2,
-        thumbnailSize.GetWidth() + 4,
-        thumbnailSize.GetHeight() + 4);
+  for (wxRegionIterator iRect(background); iRect; ++iRect)
+  {
+    Dc.DrawRectangle(iRect.GetRect());
+  }
 
-        Dc.DrawBitmap(mThumbnail, location.x, location.y, true);
-    }
+  if (GetPrimaryStream().mpImage)
+  {
+    auto area = damage.GetBox().Intersect(viewport);
+
+    GetPrimaryStream().mOverlays.Draw(Dc, area, mPrimaryZoom);
+
+    mStatisticsOverlay.Draw(Dc, area, mPrimaryZoom);
+  }
+
+  auto frame = DoGetMiniWindowFrame();
+
+  if (!frame.IsEmpty() && damage.Contains(frame) != wxOutRegion)
+  {
+    Dc.SetBrush(*wxBLACK_BRUSH);
+
+    Dc.DrawRectangle(frame);
+
+    Dc.DrawBitmap(*mpThumbnail, DoGetMiniWindowLocation(), true);
+
+    DrawViewportIndicator(Dc);
   }
+
+  ++mPaintCount;
 }
 
 //------------------------------------------------------------------------------
+// Outlines the part of the primary image on screen over the thumbnail, taking
+// the images as two views of the same scene.  Goes through the same region
+// mapping as the thumbnail so it is only redrawn, never rescaled, on a pan.
 //------------------------------------------------------------------------------
-wxSize PictureInPictureWindow::GetDesiredPrimaryImageSize(
-  std::experimental::observer_ptr<const dl::image::Image> pImage) const
+void PictureInPictureWindow::DrawViewportIndicator(wxDC& dc) const
 {
-  auto size = GetSize();
+  auto& pPrimaryImage =
+    mIsPrimaryDisplayBitmap1 ? mStream1.mpImage : mStream2.mpImage;
 
-  auto WidthScale =
-    static_cast<double>(size.GetWidth()) / static_cast<double>(pImage->GetWidth());
+  auto viewport = GetPrimaryViewport();
 
-  auto HeightScale =
-    static_cast<double>(size.GetHeight()) / static_cast<double>(pImage->GetHeight());
+  if (!pPrimaryImage || viewport.IsEmpty() || mThumbnailRegion.IsEmpty())
+  {
+    return;
+  }
 
-  auto Scale = std::min(WidthScale, HeightScale);
+  auto thumbnailSize = mpThumbnail->GetSize();
 
-  Scale = std::max(1.0, Scale);
+  // canvas -> secondary image -> thumbnail
+  auto scaleX =
+    mThumbnailImageSize.GetWidth() /
+    (pPrimaryImage->GetWidth() * mPrimaryZoom);
 
-  return wxSize(pImage->GetWidth() * Scale, pImage->GetHeight() * Scale);
+  auto scaleY =
+    mThumbnailImageSize.GetHeight() /
+    (pPrimaryImage->GetHeight() * mPrimaryZoom);
+
+  auto toThumbnailX =
+    static_cast<double>(thumbnailSize.GetWidth()) / mThumbnailRegion.GetWidth();
+
+  auto toThumbnailY =
+    static_cast<double>(thumbnailSize.GetHeight()) /
+    mThumbnailRegion.GetHeight();
+
+  auto location = DoGetMiniWindowLocation();
+
+  auto left =
+    (viewport.GetLeft() * scaleX - mThumbnailRegion.GetX()) * toThumbnailX;
+
+  auto top =
+    (viewport.GetTop() * scaleY - mThumbnailRegion.GetY()) * toThumbnailY;
+
+  auto right =
+    ((viewport.GetRight() + 1) * scaleX - mThumbnailRegion.GetX()) *
+    toThumbnailX;
+
+  auto bottom =
+    ((viewport.GetBottom() + 1) * scaleY - mThumbnailRegion.GetY()) *
+    toThumbnailY;
+
+  wxRect indicator(
+    location.x + std::lround(left),
+    location.y + std::lround(top),
+    std::max(1L, std::lround(right - left)),
+    std::max(1L, std::lround(bottom - top)));
+
+  dc.SetClippingRegion(wxRect(location, thumbnailSize));
+
+  dc.SetPen(wxPen(*wxYELLOW));
+
+  dc.SetBrush(*wxTRANSPARENT_BRUSH);
+
+  dc.DrawRectangle(indicator);
+
+  dc.DestroyClippingRegion();
 }
 
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t PictureInPictureWindow::GetPaintCount() const
+{
+  return mPaintCount;
+}
 
+//------------------------------------------------------------------------------
+// Applies from the next frame or resize on.  Thumbnails are always box
+// filtered.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetScaleFilter(ScaleFilter filter)
+{
+  mScaleFilter = filter;
+}
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
-wxPoint PictureInPictureWindow::DoGetMiniWindowLocation() const
+void PictureInPictureWindow::SetThumbnailRegion(
+  const std::optional<wxRect>& region)
 {
-  auto Location = GetViewStart();
+  mRequestedThumbnailRegion = region;
 
-  auto size = GetSize();
+  RequestThumbnail();
+}
 
-  Location.x += .03 * size.GetWidth();
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+double PictureInPictureWindow::GetDesiredPrimaryZoom(
+  std::experimental::observer_ptr<const dl::image::Image> pImage,
+  const wxSize& size)
+{
+  auto WidthScale =
+    static_cast<double>(size.GetWidth()) / static_cast<double>(pImage->GetWidth());
 
-  Location.y += .75 * size.GetHeight();
+  auto HeightScale =
+    static_cast<double>(size.GetHeight()) / static_cast<double>(pImage->GetHeight());
 
-  return Location;
+  auto Scale = std::min(WidthScale, HeightScale);
+
+  return std::max(1.0, Scale);
 }
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::OnResize(wxSizeEvent& Event)
+wxSize PictureInPictureWindow::GetDesiredPrimaryImageSize(
+  std::experimental::observer_ptr<const dl::image::Image> pImage,
+  const wxSize& size)
+{
+  auto Scale = GetDesiredPrimaryZoom(pImage, size);
+
+  return wxSize(pImage->GetWidth() * Scale, pImage->GetHeight() * Scale);
+}
+
+//------------------------------------------------------------------------------
+// Gui thread.  Resizes the scrollable canvas when the zoom or image size
+// changed, nothing is allocated for it.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::UpdatePrimaryCanvas(const dl::image::Image& image)
 {
+  if (mIsZoomFitted)
   {
-    std::lock_guard imageLock(mImageMutex);
+    mPrimaryZoom = GetDesiredPrimaryZoom(
+      std::experimental::make_observer(&image),
+      mWindowSize);
+  }
 
-    mPrimaryBitmap = DoGeneratePrimaryImage();
+  wxSize canvasSize(
+    image.GetWidth() * mPrimaryZoom,
+    image.GetHeight() * mPrimaryZoom);
+
+  if (canvasSize != mPrimaryCanvasSize)
+  {
+    mPrimaryCanvasSize = canvasSize;
 
     SetScrollbars(
       1,
       1,
-      mPrimaryBitmap.GetWidth(),
-      mPrimaryBitmap.GetHeight(),
+      canvasSize.GetWidth(),
+      canvasSize.GetHeight(),
       mViewStart.x,
       mViewStart.y);
   }
+}
+
+//------------------------------------------------------------------------------
+// The part of the canvas currently on screen.
+//------------------------------------------------------------------------------
+wxRect PictureInPictureWindow::GetPrimaryViewport() const
+{
+  return wxRect(GetViewStart(), GetClientSize()).Intersect(
+    wxRect(mPrimaryCanvasSize));
+}
 
-  Refresh();
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::ScaleMapping PictureInPictureWindow::DoGetViewportMapping(
+  const wxRect& viewport,
+  double zoom)
+{
+  return {viewport.GetX() / zoom, viewport.GetY() / zoom, 1.0 / zoom, 1.0 / zoom};
 }
 
 //------------------------------------------------------------------------------
+// Gui thread, from OnPaint once panning or resizing moved the viewport away
+// from what the last bitmap shows.  The displayed bitmap is never handed to
+// a worker so it can be drawn into directly.  After a pan the part still in
+// view is shifted into place and only the uncovered strips are drawn, as a
+// nearest preview from the level the zoom calls for, or background while
+// that level isn't built.  Anything short of what the chosen filter gives
+// is redone by a primary image job.
 //------------------------------------------------------------------------------
-wxImage PictureInPictureWindow::DoGeneratePrimaryImage()
+void PictureInPictureWindow::RenderPrimaryViewport(const wxRect& viewport)
 {
-  auto pImage = std::experimental::make_observer(mpImage1.get());
+  auto& pPyramid = GetPrimaryStream().mpPyramid;
+
+  wxRegion exposed(viewport);
 
-  if (!mIsPrimaryDisplayBitmap1)
+  auto isExact =
+    gs::FrameClock::GetInstance().GetScaleFilter(mScaleFilter) ==
+    ScaleFilter::Nearest;
+
+  if (
+    mpPrimaryBitmap &&
+    mpPrimaryBitmap->GetSize() == viewport.GetSize() &&
+    mPrimaryZoom == mPrimaryBitmapZoom &&
+    mpPrimaryBitmapPyramid.lock() == pPyramid &&
+    viewport.Intersects(mPrimaryBitmapViewport))
+  {
+    ShiftBitmap(
+      *mpPrimaryBitmap,
+      mPrimaryBitmapViewport.GetPosition() - viewport.GetPosition());
+
+    exposed.Subtract(mPrimaryBitmapViewport);
+
+    isExact = isExact && mIsPrimaryBitmapExact;
+  }
+  else if (
+    !mpPrimaryBitmap ||
+    mpPrimaryBitmap->GetSize() != viewport.GetSize())
   {
-    pImage = std::experimental::make_observer(mpImage2.get());
+    mpPrimaryBitmap = std::make_shared<wxBitmap>(
+      viewport.GetWidth(),
+      viewport.GetHeight(),
+      wxNativePixelFormat::BitsPerPixel);
   }
 
-  if (!pImage)
+  // use what is there now, a coarser level gets built in the background
+  RequestPyramidLevels(pPyramid, pPyramid->GetLevelFor(1.0 / mPrimaryZoom) + 1);
+
+  for (wxRegionIterator iRect(exposed); iRect; ++iRect)
   {
-    return wxImage();
+    auto rect = iRect.GetRect();
+
+    auto mapping = DoGetViewportMapping(rect, mPrimaryZoom);
+
+    rect.Offset(-viewport.GetPosition());
+
+    if (pPyramid->IsBuiltFor(mapping))
+    {
+      pPyramid->Scale(*mpPrimaryBitmap, rect, ScaleFilter::Nearest, mapping);
+    }
+    else
+    {
+      wxMemoryDC bitmapDc(*mpPrimaryBitmap);
+
+      bitmapDc.SetPen(*wxTRANSPARENT_PEN);
+
+      bitmapDc.SetBrush(wxBrush(GetBackgroundColour()));
+
+      bitmapDc.DrawRectangle(rect);
+
+      isExact = false;
+    }
   }
 
-  wxImage displayImage(
-    pImage->GetWidth(),
-    pImage->GetHeight(),
-    reinterpret_cast<unsigned char*> (pImage->GetData().get()),
-    true);
+  mPrimaryBitmapViewport = viewport;
 
-  SetScrollbars(
-    1,
-    1,
-    displayImage.GetWidth(),
-    displayImage.GetHeight(),
-    mViewStart.x,
-    mViewStart.y);
+  mPrimaryBitmapZoom = mPrimaryZoom;
 
-  auto size = GetDesiredPrimaryImageSize(pImage);
+  mpPrimaryBitmapPyramid = pPyramid;
 
-  return displayImage.Rescale(
-    size.GetWidth(),
-    size.GetHeight(),
-    wxIMAGE_QUALITY_NEAREST);
+  mIsPrimaryBitmapExact = isExact;
+
+  if (!mIsPrimaryBitmapExact)
+  {
+    // not from inside the paint, the job may resize the scrollbars
+    std::weak_ptr<void> pLifetime = mpLifetime;
+
+    gs::DoOnGuiThread([this, pLifetime]
+    {
+      if (!pLifetime.expired())
+      {
+        RequestPrimaryImage();
+      }
+    });
+  }
 }
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
-wxSize PictureInPictureWindow::DoGetThumbnailSize() const
+wxPoint PictureInPictureWindow::DoGetMiniWindowLocation() const
 {
-  auto pSecondaryImage = std::experimental::make_observer(mpImage1.get());
-
-  if (!mIsPrimaryDisplayBitmap1)
-  {
-    pSecondaryImage = std::experimental::make_observer(mpImage2.get());
-  }
+  auto Location = GetViewStart();
 
-  if (!pSecondaryImage)
-  {
-    return wxSize();
-  }
+  auto size = GetSize();
 
-  auto width = mThumbnailWidth;
+  Location.x += .03 * size.GetWidth();
 
-  if (width > pSecondaryImage->GetWidth())
-  {
-    width = pSecondaryImage->GetWidth();
-  }
+  Location.y += .75 * size.GetHeight();
 
-  auto height = mThumbnailHeight;
+  return Location;
+}
 
-  if (height > pSecondaryImage->GetHeight())
+//------------------------------------------------------------------------------
+// The thumbnail and its border in canvas coordinates, empty without one.
+//------------------------------------------------------------------------------
+wxRect PictureInPictureWindow::DoGetMiniWindowFrame() const
+{
+  if (!mpThumbnail)
   {
-    height = pSecondaryImage->GetHeight();
+    return wxRect();
   }
 
-  return wxSize(width, height);
+  return wxRect(DoGetMiniWindowLocation(), mpThumbnail->GetSize()).Inflate(2);
 }
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
-wxImage PictureInPictureWindow::DoGenerateThumbnail(
-  const std::optional<wxRect> portionOfTheImageToThumbnail) const
+void PictureInPictureWindow::OnResize(wxSizeEvent& Event)
 {
-  auto desiredSize = DoGetThumbnailSize();
-  auto pSecondaryImage = std::experimental::make_observer(mpImage2.get());
+  mWindowSize = GetSize();
 
-  if (!mIsPrimaryDisplayBitmap1)
-  {
-    pSecondaryImage = std::experimental::make_observer(mpImage1.get());
-  }
+  RequestPrimaryImage();
+}
 
-  if (!pSecondaryImage)
+//------------------------------------------------------------------------------
+// Scaling happens on the worker pool straight into the pixels of a bitmap
+// made here on the gui thread, which then only has to swap it in.  While a
+// job is running further requests just mark it stale; when it finishes one
+// more job picks up the newest frame and window size.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::RequestPrimaryImage()
+{
+  if (mPrimaryJob.mIsRunning)
   {
-    return wxImage();
+    mPrimaryJob.mIsStale = true;
+
+    return;
   }
 
-  wxImage originalWxImage(
-    pSecondaryImage->GetWidth(),
-    pSecondaryImage->GetHeight(),
-    reinterpret_cast<unsigned char*> (pSecondaryImage->GetData().get()),
-    true);
+  auto pStream = &GetPrimaryStream();
 
-  auto originalSize = originalWxImage.GetSize();
+  auto isNewFrame = pStream->TakeNewest();
 
-  wxImage image;
+  auto pImage = pStream->mpImage;
 
-  if (portionOfTheImageToThumbnail)
-  {
-    auto subImageSize = portionOfTheImageToThumbnail->GetSize();
+  mPrimaryJob.mIsStale = false;
 
-    if (
-      subImageSize.GetWidth() < originalSize.GetWidth() &&
-      subImageSize.GetHeight() < originalSize.GetHeight())
-    {
-      image = originalWxImage.GetSubImage(*portionOfTheImageToThumbnail);
-    }
-    else
-    {
-      image = originalWxImage;
-    }
+  if (isNewFrame)
+  {
+    RequestStatistics();
   }
-  else
+
+  if (!pImage)
   {
-    image = originalWxImage;
+    mpPrimaryBitmap.reset();
+
+    mPrimaryCanvasSize = wxSize(0, 0);
+
+    SetScrollbars(1, 1, 0, 0);
+
+    gs::FrameClock::GetInstance().Invalidate(this);
+
+    return;
   }
-  if (image.GetHeight() < desiredSize.GetHeight())
+
+  UpdatePrimaryCanvas(*pImage);
+
+  auto viewport = GetPrimaryViewport();
+
+  if (viewport.IsEmpty())
   {
-    desiredSize.SetHeight(image.GetHeight());
+    return;
   }
 
-  return image.Rescale(desiredSize.x, desiredSize.y, wxIMAGE_QUALITY_NEAREST);
+  auto pPyramid = pStream->mpPyramid;
+
+  auto pBitmap = mPrimaryJob.GetBitmap(viewport.GetSize());
+
+  auto zoom = mPrimaryZoom;
+
+  auto mapping = DoGetViewportMapping(viewport, zoom);
+
+  auto filter = gs::FrameClock::GetInstance().GetScaleFilter(mScaleFilter);
+
+  mPrimaryJob.mIsRunning = true;
+
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  gs::WorkerPool::GetInstance().Post(
+    [
+      this, pLifetime, pStream, pPyramid, pBitmap, filter, mapping, viewport,
+      zoom, isNewFrame] () mutable
+    {
+      ScaleJob::Scale(*pPyramid, *pBitmap, filter, mapping);
+
+      // the bitmap has to be released on the gui thread
+      gs::DoOnGuiThread(
+        [
+          this, pLifetime, pStream, pPyramid, pBitmap = std::move(pBitmap),
+          viewport, zoom, isNewFrame]
+        {
+          if (pLifetime.expired())
+          {
+            return;
+          }
+
+          mPrimaryJob.mIsRunning = false;
+
+          if (pStream != &GetPrimaryStream())
+          {
+            if (isNewFrame)
+            {
+              ++pStream->mDiscardedCount;
+            }
+
+            mPrimaryJob.mpSpareBitmap = pBitmap;
+          }
+          else
+          {
+            if (isNewFrame)
+            {
+              ++pStream->mDisplayedCount;
+            }
+
+            mPrimaryJob.mpSpareBitmap = std::move(mpPrimaryBitmap);
+
+            mpPrimaryBitmap = pBitmap;
+
+            mPrimaryBitmapViewport = viewport;
+
+            mPrimaryBitmapZoom = zoom;
+
+            mpPrimaryBitmapPyramid = pPyramid;
+
+            mIsPrimaryBitmapExact = true;
+
+            gs::FrameClock::GetInstance().Invalidate(this);
+          }
+
+          if (mPrimaryJob.mIsStale || GetPrimaryStream().mFrames.IsDirty())
+          {
+            RequestPrimaryImage();
+          }
+        });
+    });
 }
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::OnLeftClickDown(wxMouseEvent& event)
+void PictureInPictureWindow::RequestThumbnail()
 {
-  if (!DoIsClickInMiniWindow(event.GetPosition()))
+  if (mThumbnailJob.mIsRunning)
   {
-    mViewStart = GetViewStart();
+    mThumbnailJob.mIsStale = true;
 
-    mpDrag.reset(new wxPoint(event.GetPosition()));
+    return;
+  }
 
-    mIsMouseCaptured = true;
+  auto pStream = &GetSecondaryStream();
 
-    CaptureMouse();
-  }
-}
+  auto isNewFrame = pStream->TakeNewest();
 
-//------------------------------------------------------------------------------
-//------------------------------------------------------------------------------
-void PictureInPictureWindow::OnLeftClickDoubleClick(wxMouseEvent& event)
-{
-  if (DoIsClickInMiniWindow(event.GetPosition()))
+  auto pImage = pStream->mpImage;
+
+  mThumbnailJob.mIsStale = false;
+
+  if (!pImage)
   {
-    auto viewStart = GetViewStart();
+    mpThumbnail.reset();
 
-    {
-      std::lock_guard lock(mImageMutex);
+    gs::FrameClock::GetInstance().Invalidate(this);
 
-      mIsPrimaryDisplayBitmap1 = !mIsPrimaryDisplayBitmap1;
+    return;
+  }
 
-      mThumbnail = DoGenerateThumbnail();
+  auto region = DoGetThumbnailRegion(*pImage, mRequestedThumbnailRegion);
 
-      mPrimaryBitmap = DoGeneratePrimaryImage();
+  if (auto pBitmap = FindCachedThumbnail(pImage, region))
+  {
+    if (isNewFrame)
+    {
+      ++pStream->mDisplayedCount;
     }
 
-    Scroll(mSecondaryViewStart);
-
-    mSecondaryViewStart = viewStart;
+    ShowThumbnail(pBitmap, region, *pImage);
 
-    Refresh();
+    return;
   }
+
+  auto pPyramid = pStream->mpPyramid;
+
+  auto thumbnailSize = DoGetThumbnailSize(region.GetSize());
+
+  auto pBitmap = mThumbnailJob.GetBitmap(thumbnailSize);
+
+  ScaleMapping mapping {
+    static_cast<double>(region.GetX()),
+    static_cast<double>(region.GetY()),
+    static_cast<double>(region.GetWidth()) / thumbnailSize.GetWidth(),
+    static_cast<double>(region.GetHeight()) / thumbnailSize.GetHeight()};
+
+  mThumbnailJob.mIsRunning = true;
+
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  std::weak_ptr<const dl::image::Image> pFrame = pImage;
+
+  // No levels are built for a thumbnail, the box filter reads whichever
+  // level is finest and built just once.
+  gs::WorkerPool::GetInstance().Post(
+    [this, pLifetime, pStream, pPyramid, pBitmap, mapping, isNewFrame, pFrame,
+     region] () mutable
+    {
+      pPyramid->Scale(*pBitmap, ScaleFilter::Box, mapping);
+
+      gs::DoOnGuiThread(
+        [
+          this, pLifetime, pStream, pBitmap = std::move(pBitmap), isNewFrame,
+          pFrame, region]
+        {
+          if (pLifetime.expired())
+          {
+            return;
+          }
+
+          mThumbnailJob.mIsRunning = false;
+
+          CacheThumbnail(pFrame, region, pBitmap);
+
+          if (pStream != &GetSecondaryStream())
+          {
+            if (isNewFrame)
+            {
+              ++pStream->mDiscardedCount;
+            }
+          }
+          else if (auto pImage = pFrame.lock())
+          {
+            if (isNewFrame)
+            {
+              ++pStream->mDisplayedCount;
+            }
+
+            ShowThumbnail(pBitmap, region, *pImage);
+          }
+
+          if (mThumbnailJob.mIsStale || GetSecondaryStream().mFrames.IsDirty())
+          {
+            RequestThumbnail();
+          }
+        });
+    });
 }
 
 //------------------------------------------------------------------------------
+// Gui thread.
 //------------------------------------------------------------------------------
-bool PictureInPictureWindow::DoIsClickInMiniWindow(const wxPoint& point)
+void PictureInPictureWindow::ShowThumbnail(
+  const std::shared_ptr<wxBitmap>& pBitmap,
+  const wxRect& region,
+  const dl::image::Image& image)
 {
- auto location = DoGetMiniWindowLocation() - GetViewStart();
+  mpThumbnail = pBitmap;
+
+  mThumbnailRegion = region;
+
+  mThumbnailImageSize = wxSize(image.GetWidth(), image.GetHeight());
 
- if (
-   static_cast<int>(point.x) > location.x &&
-   static_cast<unsigned>(point.x) < location.x + mThumbnailWidth &&
-   static_cast<int>(point.y) > location.y &&
-   static_cast<unsigned>(point.y) < location.y + mThumbnailHeight)
- {
-   return true;
- }
- return false;
+  gs::FrameClock::GetInstance().Invalidate(this);
 }
 
 //------------------------------------------------------------------------------
+// Gui thread.  A frame is identified by its image, the weak pointer stops a
+// new image allocated at the same address from matching.
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::OnMouseMotion(wxMouseEvent& event)
+std::shared_ptr<wxBitmap> PictureInPictureWindow::FindCachedThumbnail(
+  const std::shared_ptr<const dl::image::Image>& pImage,
+  const wxRect& region)
 {
-  if (mpDrag)
+  for (
+    auto iEntry = mThumbnailCache.begin();
+    iEntry != mThumbnailCache.end();
+    ++iEntry)
   {
-    PanPrimaryImage(event.GetPosition());
+    if (iEntry->mpImage.lock() == pImage && iEntry->mRegion == region)
+    {
+      auto entry = *iEntry;
+
+      mThumbnailCache.erase(iEntry);
+
+      mThumbnailCache.push_front(entry);
+
+      return entry.mpBitmap;
+    }
   }
+  return nullptr;
 }
 
 //------------------------------------------------------------------------------
+// Gui thread.  The least recently used bitmap is recycled as the next job's
+// target unless it is still on screen.
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::OnLeftClickUp(wxMouseEvent& event)
+void PictureInPictureWindow::CacheThumbnail(
+  const std::weak_ptr<const dl::image::Image>& pImage,
+  const wxRect& region,
+  const std::shared_ptr<wxBitmap>& pBitmap)
 {
-  if (mpDrag)
-  {
-    PanPrimaryImage(event.GetPosition());
-    mpDrag.reset(nullptr);
-  }
-  if (mIsMouseCaptured)
+  mThumbnailCache.push_front({pImage, region, pBitmap});
+
+  while (mThumbnailCache.size() > mThumbnailCacheSize)
   {
-    ReleaseMouse();
+    auto& pEvicted = mThumbnailCache.back().mpBitmap;
 
-    mIsMouseCaptured = false;
+    if (pEvicted != mpThumbnail)
+    {
+      mThumbnailJob.mpSpareBitmap = std::move(pEvicted);
+    }
+
+    mThumbnailCache.pop_back();
   }
 }
 
 //------------------------------------------------------------------------------
+// The requested region clipped to the image, or all of it.
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::OnMouseCaptureLost(
-  wxMouseCaptureLostEvent& Event)
+wxRect PictureInPictureWindow::DoGetThumbnailRegion(
+  const dl::image::Image& secondaryImage,
+  const std::optional<wxRect>& region)
 {
-  if (mIsMouseCaptured)
+  wxRect imageRect(
+    0,
+    0,
+    secondaryImage.GetWidth(),
+    secondaryImage.GetHeight());
+
+  if (region)
   {
-    ReleaseMouse();
+    auto clipped = region->Intersect(imageRect);
 
-    mIsMouseCaptured = false;
+    if (!clipped.IsEmpty())
+    {
+      return clipped;
+    }
   }
+  return imageRect;
 }
 
 //------------------------------------------------------------------------------
+// Never scales a region up.
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::PanPrimaryImage(const wxPoint& position)
+wxSize PictureInPictureWindow::DoGetThumbnailSize(const wxSize& regionSize)
 {
-  auto scrollDistance = ((*mpDrag - position));
-
-  Scroll(mViewStart + scrollDistance);
-
-  mViewStart = GetViewStart();
-
-  Refresh();
+  return wxSize(
+    std::min(static_cast<int>(mThumbnailWidth), regionSize.GetWidth()),
+    std::min(static_cast<int>(mThumbnailHeight), regionSize.GetHeight()));
 }
 
 //------------------------------------------------------------------------------
+// Gui thread.  Builds the levels in the background and repaints with them
+// if the pyramid is still on screen by then.
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::SetImage1(
-  const std::shared_ptr<const dl::image::Image>& pImage)
+void PictureInPictureWindow::RequestPyramidLevels(
+  const std::shared_ptr<ImagePyramid>& pPyramid,
+  std::size_t levelCount)
 {
+  if (!pPyramid->Request(levelCount))
   {
-    std::lock_guard Lock(mImageMutex);
-
-    mpImage1 = pImage;
+    return;
   }
 
-  gs::DoOnGuiThread(
-    [this]
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  gs::WorkerPool::GetInstance().Post([this, pLifetime, pPyramid, levelCount]
   {
-    std::lock_guard lock(mImageMutex);
+    pPyramid->Build(levelCount);
 
-    if (mIsPrimaryDisplayBitmap1)
-    {
-      mPrimaryBitmap = DoGeneratePrimaryImage();
-    }
-    else
+    gs::DoOnGuiThread([this, pLifetime, pPyramid]
     {
-      mThumbnail = DoGenerateThumbnail();;
-    }
+      if (!pLifetime.expired() && pPyramid == GetPrimaryStream().mpPyramid)
+      {
+        mPrimaryBitmapZoom = 0.0;
 
-    Refresh();
+        gs::FrameClock::GetInstance().Invalidate(this);
+      }
+    });
   });
 }
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
-void PictureInPictureWindow::SetImage2(
-  const std::shared_ptr<const dl::image::Image>& pImage)
+void PictureInPictureWindow::OnLeftClickDown(wxMouseEvent& event)
 {
+  if (!DoIsClickInMiniWindow(event.GetPosition()))
   {
-    std::lock_guard Lock(mImageMutex);
+    mViewStart = GetViewStart();
 
-    mpImage2 = pImage;
+    mpDrag.reset(new wxPoint(event.GetPosition()));
+
+    mIsMouseCaptured = true;
+
+    CaptureMouse();
   }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnLeftClickDoubleClick(wxMouseEvent& event)
+{
+  if (DoIsClickInMiniWindow(event.GetPosition()))
+  {
+    auto viewStart = GetViewStart();
+
+    mIsPrimaryDisplayBitmap1 = !mIsPrimaryDisplayBitmap1;
+
+    mViewStart = mSecondaryViewStart;
+
+    mSecondaryViewStart = viewStart;
 
-  gs::DoOnGuiThread([this]
+    RequestThumbnail();
+
+    RequestPrimaryImage();
+
+    mpStatistics.reset();
+
+    UpdateRegionStatistics();
+
+    RequestStatistics();
+
+    Scroll(mViewStart);
+
+    gs::FrameClock::GetInstance().Invalidate(this);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Against the thumbnail as drawn, which is smaller than mThumbnailWidth x
+// mThumbnailHeight for a small region.
+//------------------------------------------------------------------------------
+bool PictureInPictureWindow::DoIsClickInMiniWindow(const wxPoint& point)
+{
+  if (!mpThumbnail)
+  {
+    return false;
+  }
+
+  auto location = DoGetMiniWindowLocation() - GetViewStart();
+
+  return wxRect(location, mpThumbnail->GetSize()).Contains(point);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnMouseMotion(wxMouseEvent& event)
+{
+  if (mpDrag)
+  {
+    PanPrimaryImageThrottled(event.GetPosition());
+  }
+  else if (mIsStatisticsEnabled)
   {
-    std::lock_guard Lock(mImageMutex);
+    auto point = DoGetImagePoint(event.GetPosition());
 
-    if (!mIsPrimaryDisplayBitmap1)
+    if (mStatisticsDragStart)
     {
-      mPrimaryBitmap = DoGeneratePrimaryImage();
+      auto left = std::min(point.x, mStatisticsDragStart->x);
+
+      auto top = std::min(point.y, mStatisticsDragStart->y);
+
+      SetStatisticsRegion(
+        wxRect(
+          left,
+          top,
+          std::max(point.x, mStatisticsDragStart->x) - left + 1,
+          std::max(point.y, mStatisticsDragStart->y) - top + 1));
     }
-    else
+    else if (!mStatisticsRegion)
     {
-      mThumbnail = DoGenerateThumbnail();;
+      mStatisticsCursor = point;
+
+      // only looked up again once the cursor leaves the block shown
+      if (
+        mpStatistics &&
+        mpStatistics->Get(wxRect(point, wxSize(1, 1))).mRegion !=
+          mRegionStatistics.mRegion)
+      {
+        UpdateRegionStatistics();
+      }
     }
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnRightClickDown(wxMouseEvent& event)
+{
+  if (mIsStatisticsEnabled && !DoIsClickInMiniWindow(event.GetPosition()))
+  {
+    mStatisticsDragStart = DoGetImagePoint(event.GetPosition());
+  }
+}
+
+//------------------------------------------------------------------------------
+// A click that didn't drag goes back to following the cursor.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnRightClickUp(wxMouseEvent& event)
+{
+  if (!mStatisticsDragStart)
+  {
+    return;
+  }
+
+  auto point = DoGetImagePoint(event.GetPosition());
+
+  if (point == *mStatisticsDragStart)
+  {
+    mStatisticsCursor = point;
+
+    SetStatisticsRegion(std::nullopt);
+  }
+
+  mStatisticsDragStart.reset();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnMouseLeave(wxMouseEvent& event)
+{
+  if (mStatisticsCursor && !mStatisticsRegion)
+  {
+    mStatisticsCursor.reset();
+
+    UpdateRegionStatistics();
+  }
+}
+
+//------------------------------------------------------------------------------
+// The first motion of a drag scrolls straight away, the rest of that frame's
+// motions only leave their position for the timer to apply.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::PanPrimaryImageThrottled(const wxPoint& position)
+{
+  mPanPosition = position;
+
+  if (mPanTimer.IsRunning())
+  {
+    mIsPanPending = true;
+
+    return;
+  }
+
+  PanPrimaryImage(position);
+
+  mPanTimer.StartOnce(mPanPeriod);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnPanTimer(wxTimerEvent& event)
+{
+  if (mIsPanPending && mpDrag)
+  {
+    mIsPanPending = false;
+
+    PanPrimaryImage(mPanPosition);
+
+    mPanTimer.StartOnce(mPanPeriod);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Zooms about the canvas point under the cursor so it stays put.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnMouseWheel(wxMouseEvent& event)
+{
+  auto& pImage = GetPrimaryStream().mpImage;
+
+  if (!pImage || event.GetWheelRotation() == 0)
+  {
+    return;
+  }
+
+  auto steps =
+    static_cast<double>(event.GetWheelRotation()) / event.GetWheelDelta();
+
+  auto zoom = std::clamp(
+    mPrimaryZoom * std::pow(1.25, steps),
+    1.0 / 64.0,
+    64.0);
+
+  auto cursor = event.GetPosition();
+
+  auto viewStart = GetViewStart();
+
+  auto imageX = (viewStart.x + cursor.x) / mPrimaryZoom;
+
+  auto imageY = (viewStart.y + cursor.y) / mPrimaryZoom;
+
+  mPrimaryZoom = zoom;
+
+  mIsZoomFitted = false;
+
+  mViewStart = wxPoint(
+    std::max(0L, std::lround(imageX * zoom - cursor.x)),
+    std::max(0L, std::lround(imageY * zoom - cursor.y)));
+
+  mPrimaryCanvasSize = wxSize(
+    pImage->GetWidth() * zoom,
+    pImage->GetHeight() * zoom);
+
+  SetScrollbars(
+    1,
+    1,
+    mPrimaryCanvasSize.GetWidth(),
+    mPrimaryCanvasSize.GetHeight(),
+    mViewStart.x,
+    mViewStart.y);
+
+  mViewStart = GetViewStart();
+
+  gs::FrameClock::GetInstance().Invalidate(this);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnLeftClickUp(wxMouseEvent& event)
+{
+  if (mpDrag)
+  {
+    mPanTimer.Stop();
+    mIsPanPending = false;
+    PanPrimaryImage(event.GetPosition());
+    mpDrag.reset(nullptr);
+  }
+  if (mIsMouseCaptured)
+  {
+    ReleaseMouse();
+
+    mIsMouseCaptured = false;
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnMouseCaptureLost(
+  wxMouseCaptureLostEvent& Event)
+{
+  if (mIsMouseCaptured)
+  {
+    ReleaseMouse();
+
+    mIsMouseCaptured = false;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Scroll blits what stays visible and invalidates only the uncovered strips.
+// The blit drags the thumbnail along too, so both where it was moved to and
+// where it belongs are repainted.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::PanPrimaryImage(const wxPoint& position)
+{
+  auto scrollDistance = ((*mpDrag - position));
+
+  auto frame = DoGetMiniWindowFrame();
+
+  frame.SetPosition(CalcScrolledPosition(frame.GetPosition()));
+
+  Scroll(mViewStart + scrollDistance);
+
+  auto viewStart = GetViewStart();
+
+  if (!frame.IsEmpty() && viewStart != mViewStart)
+  {
+    RefreshRect(frame, false);
+
+    RefreshRect(wxRect(frame).Offset(mViewStart - viewStart), false);
+  }
+
+  mViewStart = viewStart;
+
+  *mpDrag = position;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetImage1(
+  const std::shared_ptr<const dl::image::Image>& pImage)
+{
+  SetImage(mStream1, pImage, PixelFormat());
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetImage2(
+  const std::shared_ptr<const dl::image::Image>& pImage)
+{
+  SetImage(mStream2, pImage, PixelFormat());
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetImage1(
+  const std::shared_ptr<const dl::image::Image>& pImage,
+  const PixelFormat& format)
+{
+  SetImage(mStream1, pImage, format);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetImage2(
+  const std::shared_ptr<const dl::image::Image>& pImage,
+  const PixelFormat& format)
+{
+  SetImage(mStream2, pImage, format);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::AttachImage1(const std::string& ringName)
+{
+  AttachImage(mStream1, mpFeed1, ringName);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::AttachImage2(const std::string& ringName)
+{
+  AttachImage(mStream2, mpFeed2, ringName);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetOverlay1(
+  std::size_t layer,
+  std::shared_ptr<const Overlay> pOverlay)
+{
+  SetOverlay(mStream1, layer, std::move(pOverlay));
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetOverlay2(
+  std::size_t layer,
+  std::shared_ptr<const Overlay> pOverlay)
+{
+  SetOverlay(mStream2, layer, std::move(pOverlay));
+}
+
+//------------------------------------------------------------------------------
+// Any thread.  The layers only change on the gui thread, and only the canvas
+// under the old and new overlay of the primary image is invalidated.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetOverlay(
+  ImageStream& stream,
+  std::size_t layer,
+  std::shared_ptr<const Overlay> pOverlay)
+{
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  gs::DoOnGuiThread(
+    [this, pLifetime, &stream, layer, pOverlay = std::move(pOverlay)]
+    {
+      if (pLifetime.expired())
+      {
+        return;
+      }
+
+      auto damage =
+        stream.mOverlays.Set(layer, pOverlay, mPrimaryZoom, *this);
+
+      if (&stream == &GetPrimaryStream() && !damage.IsEmpty())
+      {
+        damage.SetPosition(CalcScrolledPosition(damage.GetPosition()));
+
+        gs::FrameClock::GetInstance().Invalidate(this, damage);
+      }
+    });
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::EnableStatistics(bool isEnabled)
+{
+  mIsStatisticsEnabled = isEnabled;
+
+  if (isEnabled)
+  {
+    RequestStatistics();
+  }
+  else
+  {
+    mpStatistics.reset();
+
+    mpStatisticsPyramid.reset();
+
+    mStatisticsCursor.reset();
+
+    mStatisticsDragStart.reset();
+  }
+
+  UpdateRegionStatistics();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetStatisticsRegion(
+  const std::optional<wxRect>& region)
+{
+  mStatisticsRegion = region;
+
+  UpdateRegionStatistics();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+gs::RegionStatistics PictureInPictureWindow::GetRegionStatistics() const
+{
+  return mRegionStatistics;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::shared_ptr<const gs::ImageStatistics>
+PictureInPictureWindow::GetStatistics() const
+{
+  return mpStatistics;
+}
+
+//------------------------------------------------------------------------------
+// Gui thread.  The worker measures the pyramid's level 0, which keeps the
+// frame alive, so nothing the painter or the producers use is ever waited
+// on.  Frames arriving while one is measured supersede each other and only
+// the newest is measured next.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::RequestStatistics()
+{
+  if (!mIsStatisticsEnabled)
+  {
+    return;
+  }
+
+  if (mIsMeasuring)
+  {
+    mIsMeasureStale = true;
+
+    return;
+  }
+
+  mIsMeasureStale = false;
+
+  auto pPyramid = GetPrimaryStream().mpPyramid;
+
+  if (!pPyramid || pPyramid == mpStatisticsPyramid.lock())
+  {
+    return;
+  }
 
-    Refresh();
+  mIsMeasuring = true;
+
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  gs::WorkerPool::GetInstance().Post([this, pLifetime, pPyramid]
+  {
+    auto pStatistics =
+      std::make_shared<const ImageStatistics>(pPyramid->GetLevel(0));
+
+    gs::DoOnGuiThread([this, pLifetime, pPyramid, pStatistics]
+    {
+      if (pLifetime.expired())
+      {
+        return;
+      }
+
+      mIsMeasuring = false;
+
+      if (mIsStatisticsEnabled && pPyramid == GetPrimaryStream().mpPyramid)
+      {
+        mpStatistics = pStatistics;
+
+        mpStatisticsPyramid = pPyramid;
+
+        UpdateRegionStatistics();
+      }
+
+      if (mIsMeasureStale || pPyramid != GetPrimaryStream().mpPyramid)
+      {
+        RequestStatistics();
+      }
+    });
   });
 }
+
+//------------------------------------------------------------------------------
+// Looks the region up and replaces the overlay showing it, repainting just
+// the old and new outline and label.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::UpdateRegionStatistics()
+{
+  mRegionStatistics = {};
+
+  auto region = mStatisticsRegion;
+
+  if (!region && mStatisticsCursor)
+  {
+    region = wxRect(*mStatisticsCursor, wxSize(1, 1));
+  }
+
+  if (mpStatistics && region)
+  {
+    mRegionStatistics = mpStatistics->Get(*region);
+  }
+
+  std::shared_ptr<Overlay> pOverlay;
+
+  if (mRegionStatistics.mPixelCount != 0)
+  {
+    const auto& measured = mRegionStatistics.mRegion;
+
+    wxString text;
+
+    const char* channelNames[] = {"R", "G", "B"};
+
+    for (std::size_t channel = 0; channel < 3; ++channel)
+    {
+      const auto& statistics = mRegionStatistics.mChannels[channel];
+
+      text += wxString::Format(
+        "%s%s %.1f sd %.1f [%u, %u]",
+        channel == 0 ? "" : "\n",
+        channelNames[channel],
+        statistics.mMean,
+        statistics.mStandardDeviation,
+        unsigned(statistics.mMinimum),
+        unsigned(statistics.mMaximum));
+    }
+
+    pOverlay = std::make_shared<Overlay>();
+
+    pOverlay->AddRect(
+      measured.GetX(),
+      measured.GetY(),
+      measured.GetWidth(),
+      measured.GetHeight(),
+      *wxYELLOW);
+
+    pOverlay->AddLabel(
+      measured.GetX(),
+      measured.GetBottom() + 1,
+      text.ToStdString(),
+      *wxYELLOW);
+  }
+
+  auto damage = mStatisticsOverlay.Set(0, pOverlay, mPrimaryZoom, *this);
+
+  if (!damage.IsEmpty())
+  {
+    damage.SetPosition(CalcScrolledPosition(damage.GetPosition()));
+
+    gs::FrameClock::GetInstance().Invalidate(this, damage);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+wxPoint PictureInPictureWindow::DoGetImagePoint(
+  const wxPoint& windowPoint) const
+{
+  auto canvasPoint = CalcUnscrolledPosition(windowPoint);
+
+  return wxPoint(
+    static_cast<int>(std::floor(canvasPoint.x / mPrimaryZoom)),
+    static_cast<int>(std::floor(canvasPoint.y / mPrimaryZoom)));
+}
+
+//------------------------------------------------------------------------------
+// The frames go through SetImage like any other, holding their ring slots
+// until the window lets go of them.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::AttachImage(
+  ImageStream& stream,
+  std::unique_ptr<FrameRingFeed>& pFeed,
+  const std::string& ringName)
+{
+  pFeed.reset();
+
+  pFeed = std::make_unique<FrameRingFeed>(
+    ringName,
+    [this, &stream] (const FrameRingReader::Frame& frame)
+    {
+      SetImage(stream, frame.mpImage, frame.mFormat);
+    });
+}
+
+//------------------------------------------------------------------------------
+// Any thread.  Publishing never waits on the gui thread or the painter.
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::SetImage(
+  ImageStream& stream,
+  const std::shared_ptr<const dl::image::Image>& pImage,
+  const PixelFormat& format)
+{
+  stream.Publish(
+    pImage,
+    format,
+    mpLifetime,
+    [this, &stream]
+    {
+      OnFrameArrived(stream);
+    });
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void PictureInPictureWindow::OnFrameArrived(ImageStream& stream)
+{
+  if (&stream == &GetPrimaryStream())
+  {
+    RequestPrimaryImage();
+  }
+  else
+  {
+    RequestThumbnail();
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+PictureInPictureWindow::ImageStream& PictureInPictureWindow::GetPrimaryStream()
+{
+  return mIsPrimaryDisplayBitmap1 ? mStream1 : mStream2;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+PictureInPictureWindow::ImageStream& PictureInPictureWindow::GetSecondaryStream()
+{
+  return mIsPrimaryDisplayBitmap1 ? mStream2 : mStream1;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+PictureInPictureWindow::FrameCounters
+PictureInPictureWindow::GetFrameCounters1() const
+{
+  return DoGetFrameCounters(mStream1);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+PictureInPictureWindow::FrameCounters
+PictureInPictureWindow::GetFrameCounters2() const
+{
+  return DoGetFrameCounters(mStream2);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+PictureInPictureWindow::FrameCounters
+PictureInPictureWindow::DoGetFrameCounters(const ImageStream& stream)
+{
+  return {
+    stream.mPublishedCount.load(),
+    stream.mDisplayedCount.load(),
+    stream.mFrames.GetSupersededCount() + stream.mDiscardedCount.load()};
+}
@@ -1,14 +1,26 @@
 #pragma once
 
+#include <GuiStuff/FrameFeed.hpp>
+#include <GuiStuff/FrameRing.hpp>
+#include <GuiStuff/ImagePyramid.hpp>
+#include <GuiStuff/ImageScaler.hpp>
+#include <GuiStuff/ImageStatistics.hpp>
+#include <GuiStuff/Overlay.hpp>
+
 #include <DanLib/Images/Image.hpp>
 
 #include <wx/bitmap.h>
 #include <wx/scrolwin.h>
 #include <wx/gdicmn.h>
+#include <wx/timer.h>
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <experimental/memory>
-#include <mutex>
+#include <optional>
+#include <string>
 #include <iostream>
 
 //------------------------------------------------------------------------------
@@ -30,22 +42,179 @@ namespace gs
 
       void SetImage2(const std::shared_ptr<const dl::image::Image>& pImage);
 
+      // For frames that aren't packed RGB.  They are converted as they are
+      // scaled for display, so only the pixels shown are ever converted.
+      void SetImage1(
+        const std::shared_ptr<const dl::image::Image>& pImage,
+        const PixelFormat& Format);
+
+      void SetImage2(
+        const std::shared_ptr<const dl::image::Image>& pImage,
+        const PixelFormat& Format);
+
+      uint64_t GetPaintCount() const;
+
+      void SetScaleFilter(ScaleFilter Filter);
+
+      // The part of the secondary image, in its pixels, the thumbnail shows.
+      // Everything by default.
+      void SetThumbnailRegion(const std::optional<wxRect>& Region);
+
+      struct FrameCounters
+      {
+        uint64_t mPublishedCount;
+
+        uint64_t mDisplayedCount;
+
+        uint64_t mSkippedCount;
+      };
+
+      FrameCounters GetFrameCounters1() const;
+
+      FrameCounters GetFrameCounters2() const;
+
+      // Shows the frames a producer process publishes to frame ring
+      // RingName, read in place by a thread of the window's own until it is
+      // destroyed or attached to another ring.  Throws if there is no such
+      // ring.  The window holds up to four frames at a time, so the ring
+      // wants at least six slots for the producer never to drop one.
+      void AttachImage1(const std::string& RingName);
+
+      void AttachImage2(const std::string& RingName);
+
+      // Draws pOverlay, in pixels of image 1, over image 1 whenever it is the
+      // primary image, above any lower numbered layer.  Only the part of the
+      // window the old and new overlay cover is repainted, nullptr clears
+      // the layer.  Any thread.
+      void SetOverlay1(
+        std::size_t Layer,
+        std::shared_ptr<const Overlay> pOverlay);
+
+      void SetOverlay2(
+        std::size_t Layer,
+        std::shared_ptr<const Overlay> pOverlay);
+
+      // Measures every primary frame on the worker pool, see ImageStatistics,
+      // and shows the statistics of the statistics region, or else of the
+      // block under the cursor, over the image.  Dragging with the right
+      // button picks the region, a right click goes back to the cursor.
+      // Off by default.
+      void EnableStatistics(bool IsEnabled = true);
+
+      // In pixels of the primary image, empty to follow the cursor.
+      void SetStatisticsRegion(const std::optional<wxRect>& Region);
+
+      // What is shown, mPixelCount is 0 while there is nothing to show.
+      RegionStatistics GetRegionStatistics() const;
+
+      // Of the newest primary frame measured, nullptr before the first.
+      std::shared_ptr<const ImageStatistics> GetStatistics() const;
+
     private:
 
+      enum
+      {
+        PanTimerId = wxID_HIGHEST + 1
+      };
+
+      struct ImageStream : FrameFeed
+      {
+        // scaled results thrown away because the streams were swapped
+        std::atomic<uint64_t> mDiscardedCount = 0;
+
+        // gui thread only
+        OverlayLayers mOverlays;
+      };
+
+      //------------------------------------------------------------------------
+      // Thumbnails already made, so swapping the images back or returning to
+      // an earlier region doesn't scale the same frame again.
+      //------------------------------------------------------------------------
+      struct ThumbnailCacheEntry
+      {
+        std::weak_ptr<const dl::image::Image> mpImage;
+
+        wxRect mRegion;
+
+        std::shared_ptr<wxBitmap> mpBitmap;
+      };
+
+      void SetImage(
+        ImageStream& stream,
+        const std::shared_ptr<const dl::image::Image>& pImage,
+        const PixelFormat& Format);
+
+      void AttachImage(
+        ImageStream& Stream,
+        std::unique_ptr<FrameRingFeed>& pFeed,
+        const std::string& RingName);
+
+      void OnFrameArrived(ImageStream& stream);
+
+      void SetOverlay(
+        ImageStream& Stream,
+        std::size_t Layer,
+        std::shared_ptr<const Overlay> pOverlay);
+
+      void RequestStatistics();
+
+      void UpdateRegionStatistics();
+
+      wxPoint DoGetImagePoint(const wxPoint& WindowPoint) const;
+
+      ImageStream& GetPrimaryStream();
+
+      ImageStream& GetSecondaryStream();
+
+      static FrameCounters DoGetFrameCounters(const ImageStream& stream);
+
       void ConnectWxStuff();
 
       void OnPaint(wxPaintEvent& Event);
 
+      void DrawViewportIndicator(wxDC& Dc) const;
+
       wxPoint DoGetMiniWindowLocation() const;
 
+      wxRect DoGetMiniWindowFrame() const;
+
       void OnResize(wxSizeEvent& Event);
 
-      wxImage DoGeneratePrimaryImage();
+      void UpdatePrimaryCanvas(const dl::image::Image& Image);
+
+      wxRect GetPrimaryViewport() const;
+
+      static ScaleMapping DoGetViewportMapping(const wxRect& Viewport, double Zoom);
+
+      void RenderPrimaryViewport(const wxRect& Viewport);
+
+      void RequestPrimaryImage();
+
+      void RequestThumbnail();
+
+      void ShowThumbnail(
+        const std::shared_ptr<wxBitmap>& pBitmap,
+        const wxRect& Region,
+        const dl::image::Image& Image);
+
+      std::shared_ptr<wxBitmap> FindCachedThumbnail(
+        const std::shared_ptr<const dl::image::Image>& pImage,
+        const wxRect& Region);
 
-      wxSize DoGetThumbnailSize() const;
+      void CacheThumbnail(
+        const std::weak_ptr<const dl::image::Image>& pImage,
+        const wxRect& Region,
+        const std::shared_ptr<wxBitmap>& pBitmap);
 
-      wxImage DoGenerateThumbnail(
-        const std::optional<wxRect> portionOfTheImageToThumbnail = std::nullopt) const;
+      static wxRect DoGetThumbnailRegion(
+        const dl::image::Image& Image,
+        const std::optional<wxRect>& Region);
+
+      static wxSize DoGetThumbnailSize(const wxSize& RegionSize);
+
+      void RequestPyramidLevels(
+        const std::shared_ptr<ImagePyramid>& pPyramid,
+        std::size_t LevelCount);
 
       void OnLeftClickUp(wxMouseEvent& Event);
 
@@ -59,28 +228,84 @@ namespace gs
 
       void OnMouseMotion(wxMouseEvent& Event);
 
+      void OnMouseWheel(wxMouseEvent& Event);
+
+      void OnRightClickDown(wxMouseEvent& Event);
+
+      void OnRightClickUp(wxMouseEvent& Event);
+
+      void OnMouseLeave(wxMouseEvent& Event);
+
+      void OnPanTimer(wxTimerEvent& Event);
+
+      void PanPrimaryImageThrottled(const wxPoint& Position);
+
       void PanPrimaryImage(const wxPoint& Position);
 
-      wxSize GetDesiredPrimaryImageSize(
-        std::experimental::observer_ptr<const dl::image::Image> pImage) const;
+      static double GetDesiredPrimaryZoom(
+        std::experimental::observer_ptr<const dl::image::Image> pImage,
+        const wxSize& WindowSize);
 
-    private:
+      static wxSize GetDesiredPrimaryImageSize(
+        std::experimental::observer_ptr<const dl::image::Image> pImage,
+        const wxSize& WindowSize);
 
-      std::shared_ptr<const dl::image::Image> mpImage1;
+    private:
 
-      std::shared_ptr<const dl::image::Image> mpImage2;
+      ImageStream mStream1;
 
-      mutable std::mutex mImageMutex;
+      ImageStream mStream2;
 
       bool mIsPrimaryDisplayBitmap1;
 
-      mutable std::mutex mPrimaryDisplayMutex;
+      wxSize mWindowSize;
+
+      ScaleJob mPrimaryJob;
+
+      ScaleJob mThumbnailJob;
+
+      // worker results check this is still alive before touching the window
+      std::shared_ptr<void> mpLifetime;
 
       wxPoint mSecondaryViewStart;
 
-      wxBitmap mThumbnail;
+      ScaleFilter mScaleFilter;
+
+      std::shared_ptr<wxBitmap> mpThumbnail;
+
+      // what mpThumbnail shows, in pixels of a secondary image this size
+      wxRect mThumbnailRegion;
+
+      wxSize mThumbnailImageSize;
+
+      // most recently used at the front
+      std::deque<ThumbnailCacheEntry> mThumbnailCache;
+
+      std::optional<wxRect> mRequestedThumbnailRegion;
+
+      // Only the visible part of the zoomed primary image is ever rendered.
+      // The scroll position moves a viewport over a virtual canvas of the
+      // image size times mPrimaryZoom.
+      std::shared_ptr<wxBitmap> mpPrimaryBitmap;
+
+      double mPrimaryZoom;
+
+      // false once the wheel picked a zoom, until then the zoom follows the
+      // window size
+      bool mIsZoomFitted;
+
+      wxSize mPrimaryCanvasSize;
 
-      wxBitmap mPrimaryBitmap;
+      // the canvas rectangle and zoom mpPrimaryBitmap was rendered for
+      wxRect mPrimaryBitmapViewport;
+
+      double mPrimaryBitmapZoom;
+
+      // false while any of mpPrimaryBitmap is a nearest preview or
+      // background
+      bool mIsPrimaryBitmapExact;
+
+      std::weak_ptr<ImagePyramid> mpPrimaryBitmapPyramid;
 
       std::unique_ptr<wxPoint> mpDrag;
 
@@ -88,8 +313,51 @@ namespace gs
 
       bool mIsMouseCaptured;
 
+      // drags scroll at most once per mPanPeriod milliseconds
+      wxTimer mPanTimer;
+
+      wxPoint mPanPosition;
+
+      bool mIsPanPending;
+
+      uint64_t mPaintCount;
+
+      bool mIsStatisticsEnabled;
+
+      // one frame measured at a time, frames arriving meanwhile fold into
+      // one follow up
+      bool mIsMeasuring;
+
+      bool mIsMeasureStale;
+
+      std::shared_ptr<const ImageStatistics> mpStatistics;
+
+      // the frame mpStatistics measured
+      std::weak_ptr<ImagePyramid> mpStatisticsPyramid;
+
+      std::optional<wxRect> mStatisticsRegion;
+
+      // the image pixel under the cursor
+      std::optional<wxPoint> mStatisticsCursor;
+
+      // where a right drag started, in image pixels
+      std::optional<wxPoint> mStatisticsDragStart;
+
+      RegionStatistics mRegionStatistics;
+
+      OverlayLayers mStatisticsOverlay;
+
+      // last, so the feeds stop before anything they feed goes away
+      std::unique_ptr<FrameRingFeed> mpFeed1;
+
+      std::unique_ptr<FrameRingFeed> mpFeed2;
+
+      static constexpr int mPanPeriod = 16;
+
       static constexpr unsigned mThumbnailWidth = 340;
 
       static constexpr unsigned mThumbnailHeight = 220;
+
+      static constexpr std::size_t mThumbnailCacheSize = 4;
   };
 }
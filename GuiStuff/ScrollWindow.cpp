@@ -1,24 +1,128 @@
 #include "ScrollWindow.hpp"
+#include <GuiStuff/FrameClock.hpp>
+#include <GuiStuff/Helpers.hpp>
+#include <GuiStuff/WorkerPool.hpp>
 
 #include <wx/dcclient.h>
+#include <wx/dcmemory.h>
+#include <wx/rawbmp.h>
+#include <wx/region.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 using gs::ScrollWindow;
 
 //------------------------------------------------------------------------------
+// The pixels are copied once into the pyramid's level 0, coarser levels are
+// built on the worker pool and used as soon as they are ready.
 //------------------------------------------------------------------------------
 ScrollWindow::ScrollWindow(wxWindow* pParent, const wxImage& Image)
   : wxScrolledWindow(pParent, wxID_ANY),
-    mBitmap(Image),
+    mpPyramid(),
+    mpTiledImage(),
+    mPrefetchTiles(),
+    mIsPrefetching(false),
+    mScaleFilter(gs::ScaleFilter::Nearest),
+    mZoom(1.0),
+    mCanvasSize(0, 0),
+    mBitmap(),
+    mBitmapViewport(),
+    mBitmapZoom(0.0),
+    mIsBitmapExact(false),
+    mIsScaling(false),
+    mIsScaleStale(false),
+    mOverlays(),
+    mpLifetime(std::make_shared<int>(0)),
     mpDrag(nullptr),
-    mViewStart()
+    mViewStart(),
+    mPanTimer(this, PanTimerId),
+    mPanPosition(),
+    mIsPanPending(false),
+    mPaintCount(0)
 {
-   SetScrollbars(1,1,800,800, 0, 0);
+  if (Image.IsOk())
+  {
+    auto width = static_cast<unsigned>(Image.GetWidth());
+
+    auto height = static_cast<unsigned>(Image.GetHeight());
+
+    auto pPixels = std::make_shared<std::vector<uint8_t>>(
+      Image.GetData(),
+      Image.GetData() + std::size_t(width) * height * 3);
+
+    mpPyramid = std::make_shared<ImagePyramid>(
+      ImageView {pPixels->data(), width, height, std::size_t(width) * 3},
+      pPixels);
+
+    mCanvasSize = wxSize(width, height);
+
+    mpPyramid->Request(mpPyramid->GetLevelCount());
+
+    std::weak_ptr<void> pLifetime = mpLifetime;
+
+    gs::WorkerPool::GetInstance().Post(
+      [this, pLifetime, pPyramid = mpPyramid]
+      {
+        pPyramid->Build(pPyramid->GetLevelCount());
+
+        gs::DoOnGuiThread([this, pLifetime]
+        {
+          if (!pLifetime.expired())
+          {
+            mBitmapZoom = 0.0;
+
+            gs::FrameClock::GetInstance().Invalidate(this);
+          }
+        });
+      });
+  }
+
+   SetScrollbars(1, 1, mCanvasSize.GetWidth(), mCanvasSize.GetHeight(), 0, 0);
 
    Refresh();
    Update();
    ConnectWxStuff();
 }
 
+//------------------------------------------------------------------------------
+// Nothing is read until the first paint asks for the visible tiles.
+//------------------------------------------------------------------------------
+ScrollWindow::ScrollWindow(
+  wxWindow* pParent,
+  std::shared_ptr<TiledImage> pImage)
+  : wxScrolledWindow(pParent, wxID_ANY),
+    mpPyramid(),
+    mpTiledImage(std::move(pImage)),
+    mPrefetchTiles(),
+    mIsPrefetching(false),
+    mScaleFilter(gs::ScaleFilter::Nearest),
+    mZoom(1.0),
+    mCanvasSize(0, 0),
+    mBitmap(),
+    mBitmapViewport(),
+    mBitmapZoom(0.0),
+    mIsBitmapExact(false),
+    mIsScaling(false),
+    mIsScaleStale(false),
+    mOverlays(),
+    mpLifetime(std::make_shared<int>(0)),
+    mpDrag(nullptr),
+    mViewStart(),
+    mPanTimer(this, PanTimerId),
+    mPanPosition(),
+    mIsPanPending(false),
+    mPaintCount(0)
+{
+  mCanvasSize = GetImageSize();
+
+  SetScrollbars(1, 1, mCanvasSize.GetWidth(), mCanvasSize.GetHeight(), 0, 0);
+
+  Refresh();
+  ConnectWxStuff();
+}
+
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
 void ScrollWindow::ConnectWxStuff()
@@ -26,17 +130,639 @@ void ScrollWindow::ConnectWxStuff()
   Bind(wxEVT_LEFT_DOWN, &ScrollWindow::OnLeftClickDown, this);
   Bind(wxEVT_LEFT_UP, &ScrollWindow::OnLeftClickUp, this);
   Bind(wxEVT_MOTION, &ScrollWindow::OnMouseMotion, this);
+  Bind(wxEVT_MOUSEWHEEL, &ScrollWindow::OnMouseWheel, this);
   Bind(wxEVT_MOUSE_CAPTURE_LOST, &ScrollWindow::OnMouseCaptureLost, this);
   Bind(wxEVT_PAINT, &ScrollWindow::OnPaint, this);
+  Bind(wxEVT_TIMER, &ScrollWindow::OnPanTimer, this, PanTimerId);
 }
 
 //------------------------------------------------------------------------------
+// Only the damaged rectangles are copied to the screen, after a scroll blit
+// that is just the strips that came into view, and only the overlays over
+// them are drawn.
 //------------------------------------------------------------------------------
 void ScrollWindow::OnPaint(wxPaintEvent& Event)
 {
   wxPaintDC Dc(this);
   DoPrepareDC(Dc);
-  Dc.DrawBitmap(mBitmap, 0, 0, true);
+
+  auto viewport = GetViewport();
+
+  if ((mpPyramid || mpTiledImage) && !viewport.IsEmpty())
+  {
+    if (
+      !mBitmap.IsOk() ||
+      viewport != mBitmapViewport ||
+      mZoom != mBitmapZoom)
+    {
+      RenderViewport(viewport);
+    }
+
+    wxMemoryDC BitmapDc(mBitmap);
+
+    wxRect Damage;
+
+    for (wxRegionIterator iRect(GetUpdateRegion()); iRect; ++iRect)
+    {
+      auto Area = iRect.GetRect();
+
+      Area.SetPosition(CalcUnscrolledPosition(Area.GetPosition()));
+
+      Area = Area.Intersect(viewport);
+
+      if (!Area.IsEmpty())
+      {
+        Dc.Blit(
+          Area.GetX(),
+          Area.GetY(),
+          Area.GetWidth(),
+          Area.GetHeight(),
+          &BitmapDc,
+          Area.GetX() - viewport.GetX(),
+          Area.GetY() - viewport.GetY());
+
+        Damage.Union(Area);
+      }
+    }
+
+    mOverlays.Draw(Dc, Damage, mZoom);
+  }
+
+  ++mPaintCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t ScrollWindow::GetPaintCount() const
+{
+  return mPaintCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void ScrollWindow::SetScaleFilter(ScaleFilter Filter)
+{
+  mScaleFilter = Filter;
+
+  mBitmapZoom = 0.0;
+
+  gs::FrameClock::GetInstance().Invalidate(this);
+}
+
+//------------------------------------------------------------------------------
+// Any thread, as for PictureInPictureWindow.  The layers only change on the
+// gui thread.
+//------------------------------------------------------------------------------
+void ScrollWindow::SetOverlay(
+  std::size_t layer,
+  std::shared_ptr<const Overlay> pOverlay)
+{
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  gs::DoOnGuiThread(
+    [this, pLifetime, layer, pOverlay = std::move(pOverlay)]
+    {
+      if (pLifetime.expired())
+      {
+        return;
+      }
+
+      auto damage = mOverlays.Set(layer, pOverlay, mZoom, *this);
+
+      if (!damage.IsEmpty())
+      {
+        damage.SetPosition(CalcScrolledPosition(damage.GetPosition()));
+
+        gs::FrameClock::GetInstance().Invalidate(this, damage);
+      }
+    });
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+wxRect ScrollWindow::GetViewport() const
+{
+  return wxRect(GetViewStart(), GetClientSize()).Intersect(wxRect(mCanvasSize));
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+wxSize ScrollWindow::GetImageSize() const
+{
+  if (mpTiledImage)
+  {
+    return wxSize(mpTiledImage->GetWidth(), mpTiledImage->GetHeight());
+  }
+
+  if (mpPyramid)
+  {
+    const auto& source = mpPyramid->GetLevel(0);
+
+    return wxSize(source.mWidth, source.mHeight);
+  }
+
+  return wxSize(0, 0);
+}
+
+//------------------------------------------------------------------------------
+// After a pan at the same zoom the part of the last bitmap still in view is
+// shifted into place and only the rest is drawn.  A paint never scales with
+// the chosen filter, the rest is a nearest preview from the level the zoom
+// calls for, or background while that level isn't built, and the worker
+// pool is asked for the real thing.
+//------------------------------------------------------------------------------
+void ScrollWindow::RenderViewport(const wxRect& Viewport)
+{
+  wxRegion Exposed(Viewport);
+
+  auto Direction = wxPoint(0, 0);
+
+  mPrefetchTiles.clear();
+
+  auto IsExact =
+    mpTiledImage ||
+    gs::FrameClock::GetInstance().GetScaleFilter(mScaleFilter) ==
+      ScaleFilter::Nearest;
+
+  if (
+    mBitmap.IsOk() &&
+    mBitmap.GetSize() == Viewport.GetSize() &&
+    mZoom == mBitmapZoom &&
+    Viewport.Intersects(mBitmapViewport))
+  {
+    auto Delta = Viewport.GetPosition() - mBitmapViewport.GetPosition();
+
+    Direction =
+      wxPoint((Delta.x > 0) - (Delta.x < 0), (Delta.y > 0) - (Delta.y < 0));
+
+    ShiftBitmap(mBitmap, -Delta);
+
+    Exposed.Subtract(mBitmapViewport);
+
+    IsExact = IsExact && mIsBitmapExact;
+  }
+  else if (!mBitmap.IsOk() || mBitmap.GetSize() != Viewport.GetSize())
+  {
+    mBitmap.Create(
+      Viewport.GetWidth(),
+      Viewport.GetHeight(),
+      wxNativePixelFormat::BitsPerPixel);
+  }
+
+  for (wxRegionIterator iRect(Exposed); iRect; ++iRect)
+  {
+    auto Area = iRect.GetRect();
+
+    if (mpTiledImage)
+    {
+      IsExact =
+        RenderTiles(Viewport, Area, mpTiledImage->GetLevelFor(1.0 / mZoom)) &&
+        IsExact;
+
+      continue;
+    }
+
+    ScaleMapping Mapping {
+      Area.GetX() / mZoom,
+      Area.GetY() / mZoom,
+      1.0 / mZoom,
+      1.0 / mZoom};
+
+    if (mpPyramid->IsBuiltFor(Mapping))
+    {
+      mpPyramid->Scale(
+        mBitmap,
+        wxRect(Area).Offset(-Viewport.GetPosition()),
+        ScaleFilter::Nearest,
+        Mapping);
+    }
+    else
+    {
+      ClearBitmap(wxRect(Area).Offset(-Viewport.GetPosition()));
+
+      IsExact = false;
+    }
+  }
+
+  mBitmapViewport = Viewport;
+
+  mBitmapZoom = mZoom;
+
+  mIsBitmapExact = IsExact;
+
+  if (mpTiledImage)
+  {
+    if (Direction != wxPoint(0, 0))
+    {
+      PrefetchTiles(Viewport, Direction);
+    }
+
+    PostPrefetch();
+  }
+  else if (!mIsBitmapExact)
+  {
+    RequestViewportScale();
+  }
+  else if (mIsScaling)
+  {
+    mIsScaleStale = true;
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void ScrollWindow::ClearBitmap(const wxRect& Area)
+{
+  wxMemoryDC Dc(mBitmap);
+
+  Dc.SetPen(*wxTRANSPARENT_PEN);
+
+  Dc.SetBrush(wxBrush(GetBackgroundColour()));
+
+  Dc.DrawRectangle(Area);
+}
+
+//------------------------------------------------------------------------------
+// Scales the whole viewport with the chosen filter into a fresh bitmap, one
+// job at a time.  A viewport, zoom or filter change while a job runs makes
+// its result stale, and the job is run again for whatever is current once
+// it finishes.
+//------------------------------------------------------------------------------
+void ScrollWindow::RequestViewportScale()
+{
+  if (mIsScaling)
+  {
+    mIsScaleStale = true;
+
+    return;
+  }
+
+  auto viewport = GetViewport();
+
+  if (!mpPyramid || viewport.IsEmpty())
+  {
+    return;
+  }
+
+  mIsScaling = true;
+
+  mIsScaleStale = false;
+
+  auto pBitmap = std::make_shared<wxBitmap>(
+    viewport.GetWidth(),
+    viewport.GetHeight(),
+    wxNativePixelFormat::BitsPerPixel);
+
+  auto zoom = mZoom;
+
+  auto filter = gs::FrameClock::GetInstance().GetScaleFilter(mScaleFilter);
+
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  gs::WorkerPool::GetInstance().Post(
+    [
+      this, pLifetime, pPyramid = mpPyramid, pBitmap, viewport, zoom,
+      filter] () mutable
+    {
+      pPyramid->Scale(
+        *pBitmap,
+        filter,
+        {
+          viewport.GetX() / zoom,
+          viewport.GetY() / zoom,
+          1.0 / zoom,
+          1.0 / zoom});
+
+      // the bitmap has to be released on the gui thread
+      gs::DoOnGuiThread(
+        [this, pLifetime, pBitmap = std::move(pBitmap), viewport, zoom]
+        {
+          if (pLifetime.expired())
+          {
+            return;
+          }
+
+          mIsScaling = false;
+
+          if (mIsScaleStale)
+          {
+            if (!mIsBitmapExact)
+            {
+              RequestViewportScale();
+            }
+          }
+          else if (viewport == GetViewport() && zoom == mZoom)
+          {
+            mBitmap = *pBitmap;
+
+            mBitmapViewport = viewport;
+
+            mBitmapZoom = zoom;
+
+            mIsBitmapExact = true;
+
+            gs::FrameClock::GetInstance().Invalidate(this);
+          }
+        });
+    });
+}
+
+//------------------------------------------------------------------------------
+// Level pixel u of the chosen level lies under canvas pixel u / step.
+//------------------------------------------------------------------------------
+ScrollWindow::TileRange ScrollWindow::GetTileRange(
+  const wxRect& Viewport,
+  std::size_t Level) const
+{
+  auto tileSize = static_cast<double>(mpTiledImage->GetTileSize());
+
+  auto stepX =
+    static_cast<double>(mpTiledImage->GetLevelWidth(Level)) /
+    mpTiledImage->GetWidth() / mZoom;
+
+  auto stepY =
+    static_cast<double>(mpTiledImage->GetLevelHeight(Level)) /
+    mpTiledImage->GetHeight() / mZoom;
+
+  auto lastColumn = static_cast<int>(mpTiledImage->GetColumnCount(Level)) - 1;
+
+  auto lastRow = static_cast<int>(mpTiledImage->GetRowCount(Level)) - 1;
+
+  return {
+    Level,
+    std::clamp(
+      static_cast<int>(Viewport.GetLeft() * stepX / tileSize), 0, lastColumn),
+    std::clamp(
+      static_cast<int>((Viewport.GetRight() + 1) * stepX / tileSize),
+      0,
+      lastColumn),
+    std::clamp(
+      static_cast<int>(Viewport.GetTop() * stepY / tileSize), 0, lastRow),
+    std::clamp(
+      static_cast<int>((Viewport.GetBottom() + 1) * stepY / tileSize),
+      0,
+      lastRow)};
+}
+
+//------------------------------------------------------------------------------
+// Each tile is scaled straight into the part of the bitmap it covers,
+// destination pixels belong to the tile their centre falls in so nearest
+// sampling gives the same picture as one big image would.  Area is the
+// canvas rectangle to fill, inside Viewport.  Only cached tiles are drawn,
+// the part of a missing one comes from the next coarser level, or is
+// background past the last, and missing tiles of the level the zoom calls
+// for are queued to be read.  Returns false if any were missing.
+//------------------------------------------------------------------------------
+bool ScrollWindow::RenderTiles(
+  const wxRect& Viewport,
+  const wxRect& Area,
+  std::size_t Level)
+{
+  std::vector<wxRect> Missing;
+
+  {
+    wxNativePixelData data(mBitmap);
+
+    if (!data)
+    {
+      return false;
+    }
+
+    RenderCachedTiles(data, Viewport, Area, Level, Missing);
+  }
+
+  for (const auto& Part : Missing)
+  {
+    if (Level + 1 < mpTiledImage->GetLevelCount())
+    {
+      RenderTiles(Viewport, Part, Level + 1);
+    }
+    else
+    {
+      ClearBitmap(wxRect(Part).Offset(-Viewport.GetPosition()));
+    }
+  }
+
+  return Missing.empty();
+}
+
+//------------------------------------------------------------------------------
+// Adds the canvas rectangle of each tile that isn't cached to Missing.
+//------------------------------------------------------------------------------
+void ScrollWindow::RenderCachedTiles(
+  wxNativePixelData& Data,
+  const wxRect& Viewport,
+  const wxRect& Area,
+  std::size_t Level,
+  std::vector<wxRect>& Missing)
+{
+  wxNativePixelData::Iterator pixels(Data);
+
+  auto stride = Data.GetRowStride();
+
+  auto layout = MakePixelLayout<wxNativePixelFormat>();
+
+  auto pDestination =
+    reinterpret_cast<uint8_t*>(pixels.m_ptr) +
+    (Area.GetY() - Viewport.GetY()) * stride +
+    (Area.GetX() - Viewport.GetX()) * std::ptrdiff_t(layout.mBytesPerPixel);
+
+  auto range = GetTileRange(Area, Level);
+
+  auto isWanted = Level == mpTiledImage->GetLevelFor(1.0 / mZoom);
+
+  auto tileSize = mpTiledImage->GetTileSize();
+
+  auto stepX =
+    static_cast<double>(mpTiledImage->GetLevelWidth(range.mLevel)) /
+    mpTiledImage->GetWidth() / mZoom;
+
+  auto stepY =
+    static_cast<double>(mpTiledImage->GetLevelHeight(range.mLevel)) /
+    mpTiledImage->GetHeight() / mZoom;
+
+  // first destination pixel whose centre is at or past Level pixel u
+  auto toColumn = [&](double u)
+  {
+    return std::clamp(
+      static_cast<int>(std::ceil(u / stepX - Area.GetX() - 0.5)),
+      0,
+      Area.GetWidth());
+  };
+
+  auto toRow = [&](double u)
+  {
+    return std::clamp(
+      static_cast<int>(std::ceil(u / stepY - Area.GetY() - 0.5)),
+      0,
+      Area.GetHeight());
+  };
+
+  for (auto row = range.mFirstRow; row <= range.mLastRow; ++row)
+  {
+    auto y0 = row == range.mFirstRow ? 0 : toRow(double(row) * tileSize);
+
+    auto y1 =
+      row == range.mLastRow ?
+        Area.GetHeight() :
+        toRow(double(row + 1) * tileSize);
+
+    for (
+      auto column = range.mFirstColumn;
+      column <= range.mLastColumn;
+      ++column)
+    {
+      auto x0 =
+        column == range.mFirstColumn ? 0 : toColumn(double(column) * tileSize);
+
+      auto x1 =
+        column == range.mLastColumn ?
+          Area.GetWidth() :
+          toColumn(double(column + 1) * tileSize);
+
+      if (x0 >= x1 || y0 >= y1)
+      {
+        continue;
+      }
+
+      auto pTile = mpTiledImage->FindTile(range.mLevel, column, row);
+
+      if (!pTile)
+      {
+        Missing.emplace_back(
+          Area.GetX() + x0,
+          Area.GetY() + y0,
+          x1 - x0,
+          y1 - y0);
+
+        if (isWanted)
+        {
+          mPrefetchTiles.push_back(
+            {range.mLevel, unsigned(column), unsigned(row)});
+        }
+
+        continue;
+      }
+
+      ScaleImage(
+        pTile->mView,
+        pDestination + y0 * stride + x0 * std::ptrdiff_t(layout.mBytesPerPixel),
+        x1 - x0,
+        y1 - y0,
+        stride,
+        layout,
+        ScaleFilter::Nearest,
+        {
+          (Area.GetX() + x0) * stepX - double(column) * tileSize,
+          (Area.GetY() + y0) * stepY - double(row) * tileSize,
+          stepX,
+          stepY});
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Queues the two rows and columns of tiles beyond the viewport on the side
+// it is moving towards, behind the visible ones the paint found missing.
+//------------------------------------------------------------------------------
+void ScrollWindow::PrefetchTiles(
+  const wxRect& Viewport,
+  const wxPoint& Direction)
+{
+  auto visible =
+    GetTileRange(Viewport, mpTiledImage->GetLevelFor(1.0 / mZoom));
+
+  auto ahead = visible;
+
+  auto lastColumn =
+    static_cast<int>(mpTiledImage->GetColumnCount(visible.mLevel)) - 1;
+
+  auto lastRow =
+    static_cast<int>(mpTiledImage->GetRowCount(visible.mLevel)) - 1;
+
+  if (Direction.x > 0)
+  {
+    ahead.mLastColumn = std::min(ahead.mLastColumn + 2, lastColumn);
+  }
+  else if (Direction.x < 0)
+  {
+    ahead.mFirstColumn = std::max(ahead.mFirstColumn - 2, 0);
+  }
+
+  if (Direction.y > 0)
+  {
+    ahead.mLastRow = std::min(ahead.mLastRow + 2, lastRow);
+  }
+  else if (Direction.y < 0)
+  {
+    ahead.mFirstRow = std::max(ahead.mFirstRow - 2, 0);
+  }
+
+  for (auto row = ahead.mFirstRow; row <= ahead.mLastRow; ++row)
+  {
+    for (
+      auto column = ahead.mFirstColumn;
+      column <= ahead.mLastColumn;
+      ++column)
+    {
+      auto isVisible =
+        row >= visible.mFirstRow && row <= visible.mLastRow &&
+        column >= visible.mFirstColumn && column <= visible.mLastColumn;
+
+      if (!isVisible && !mpTiledImage->IsCached(visible.mLevel, column, row))
+      {
+        mPrefetchTiles.push_back(
+          {visible.mLevel, unsigned(column), unsigned(row)});
+      }
+    }
+  }
+
+  PostPrefetch();
+}
+
+//------------------------------------------------------------------------------
+// One batch at a time, a pan that moves on while a batch is loading
+// replaces whatever was queued behind it.  A viewport drawn with tiles
+// missing is drawn again once each batch is in.
+//------------------------------------------------------------------------------
+void ScrollWindow::PostPrefetch()
+{
+  if (mIsPrefetching || mPrefetchTiles.empty())
+  {
+    return;
+  }
+
+  mIsPrefetching = true;
+
+  std::weak_ptr<void> pLifetime = mpLifetime;
+
+  gs::WorkerPool::GetInstance().Post(
+    [this, pLifetime, pImage = mpTiledImage, tiles = std::move(mPrefetchTiles)]
+    {
+      for (const auto& tile : tiles)
+      {
+        pImage->GetTile(tile.mLevel, tile.mColumn, tile.mRow);
+      }
+
+      gs::DoOnGuiThread([this, pLifetime]
+      {
+        if (!pLifetime.expired())
+        {
+          mIsPrefetching = false;
+
+          if (!mIsBitmapExact)
+          {
+            mBitmapZoom = 0.0;
+
+            gs::FrameClock::GetInstance().Invalidate(this);
+          }
+
+          PostPrefetch();
+        }
+      });
+    });
+
+  mPrefetchTiles.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -54,16 +780,104 @@ void ScrollWindow::OnMouseMotion(wxMouseEvent& Event)
 {
   if (mpDrag)
   {
-    PanImage(Event.GetPosition());
+    PanImageThrottled(Event.GetPosition());
+  }
+}
+
+//------------------------------------------------------------------------------
+// The first motion of a drag scrolls straight away, the rest of that frame's
+// motions only leave their position for the timer to apply.
+//------------------------------------------------------------------------------
+void ScrollWindow::PanImageThrottled(const wxPoint& Position)
+{
+  mPanPosition = Position;
+
+  if (mPanTimer.IsRunning())
+  {
+    mIsPanPending = true;
+
+    return;
+  }
+
+  PanImage(Position);
+
+  mPanTimer.StartOnce(mPanPeriod);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void ScrollWindow::OnPanTimer(wxTimerEvent& Event)
+{
+  if (mIsPanPending && mpDrag)
+  {
+    mIsPanPending = false;
+
+    PanImage(mPanPosition);
+
+    mPanTimer.StartOnce(mPanPeriod);
   }
 }
 
+//------------------------------------------------------------------------------
+// Zooms about the image point under the cursor so it stays put.
+//------------------------------------------------------------------------------
+void ScrollWindow::OnMouseWheel(wxMouseEvent& Event)
+{
+  if ((!mpPyramid && !mpTiledImage) || Event.GetWheelRotation() == 0)
+  {
+    return;
+  }
+
+  auto steps =
+    static_cast<double>(Event.GetWheelRotation()) / Event.GetWheelDelta();
+
+  // Tiled images can't zoom out past their coarsest level or every tile
+  // of a huge image would be read for one paint.
+  auto minimumZoom = 1.0 / 64.0;
+
+  if (mpTiledImage)
+  {
+    minimumZoom = std::max(
+      minimumZoom,
+      0.5 / std::ldexp(1.0, int(mpTiledImage->GetLevelCount()) - 1));
+  }
+
+  auto zoom = std::clamp(mZoom * std::pow(1.25, steps), minimumZoom, 64.0);
+
+  auto cursor = Event.GetPosition();
+
+  auto viewStart = GetViewStart();
+
+  auto imageX = (viewStart.x + cursor.x) / mZoom;
+
+  auto imageY = (viewStart.y + cursor.y) / mZoom;
+
+  mZoom = zoom;
+
+  auto imageSize = GetImageSize();
+
+  mCanvasSize =
+    wxSize(imageSize.GetWidth() * zoom, imageSize.GetHeight() * zoom);
+
+  SetScrollbars(
+    1,
+    1,
+    mCanvasSize.GetWidth(),
+    mCanvasSize.GetHeight(),
+    std::max(0L, std::lround(imageX * zoom - cursor.x)),
+    std::max(0L, std::lround(imageY * zoom - cursor.y)));
+
+  gs::FrameClock::GetInstance().Invalidate(this);
+}
+
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
 void ScrollWindow::OnLeftClickUp(wxMouseEvent& Event)
 {
   if (mpDrag)
   {
+    mPanTimer.Stop();
+    mIsPanPending = false;
     PanImage(Event.GetPosition());
     mpDrag.reset(nullptr);
   }
@@ -79,12 +893,11 @@ void ScrollWindow::OnMouseCaptureLost(
 }
 
 //------------------------------------------------------------------------------
+// Scroll blits what stays visible and invalidates only the uncovered strips.
 //------------------------------------------------------------------------------
 void ScrollWindow::PanImage(const wxPoint& Position)
 {
   auto ScrollDistance = ((*mpDrag - Position));
 
   Scroll(mViewStart + ScrollDistance);
-
-  Refresh();
 }
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <GuiStuff/ImagePyramid.hpp>
+#include <GuiStuff/Overlay.hpp>
+#include <GuiStuff/TiledImage.hpp>
+
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include <wx/bitmap.h>
 #include <wx/scrolwin.h>
 #include <wx/gdicmn.h>
+#include <wx/rawbmp.h>
+#include <wx/timer.h>
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
@@ -16,8 +24,55 @@ namespace gs
 
       ScrollWindow(wxWindow* pParent, const wxImage& Image);
 
+      // Shows an image too big for memory, tiles are read on the worker
+      // pool as they come into view, a coarser level standing in until they
+      // are, and the ones ahead of a pan are prefetched.  Its memory cap
+      // bounds the tiles kept around.
+      ScrollWindow(wxWindow* pParent, std::shared_ptr<TiledImage> pImage);
+
+      uint64_t GetPaintCount() const;
+
+      // Tiled images are always drawn nearest, bilinear would show the tile
+      // seams.
+      void SetScaleFilter(ScaleFilter Filter);
+
+      // Any thread.  Draws pOverlay, in image pixels, over the image above
+      // any lower numbered layer, repainting only the part of the window the
+      // old and new overlay cover.  nullptr clears the layer.
+      void SetOverlay(
+        std::size_t Layer,
+        std::shared_ptr<const Overlay> pOverlay);
+
     private:
 
+      enum
+      {
+        PanTimerId = wxID_HIGHEST + 1
+      };
+
+      struct TileIndex
+      {
+        std::size_t mLevel;
+
+        unsigned mColumn;
+
+        unsigned mRow;
+      };
+
+      // Inclusive range of the tiles of one level under part of the canvas.
+      struct TileRange
+      {
+        std::size_t mLevel;
+
+        int mFirstColumn;
+
+        int mLastColumn;
+
+        int mFirstRow;
+
+        int mLastRow;
+      };
+
       void ConnectWxStuff();
 
       void OnPaint(wxPaintEvent& Event);
@@ -30,14 +85,95 @@ namespace gs
 
       void OnMouseMotion(wxMouseEvent& Event);
 
+      void OnMouseWheel(wxMouseEvent& Event);
+
+      void OnPanTimer(wxTimerEvent& Event);
+
+      void PanImageThrottled(const wxPoint& Position);
+
       void PanImage(const wxPoint& Position);
 
+      wxRect GetViewport() const;
+
+      wxSize GetImageSize() const;
+
+      void RenderViewport(const wxRect& Viewport);
+
+      void ClearBitmap(const wxRect& Area);
+
+      void RequestViewportScale();
+
+      TileRange GetTileRange(const wxRect& Viewport, std::size_t Level) const;
+
+      bool RenderTiles(
+        const wxRect& Viewport,
+        const wxRect& Area,
+        std::size_t Level);
+
+      void RenderCachedTiles(
+        wxNativePixelData& Data,
+        const wxRect& Viewport,
+        const wxRect& Area,
+        std::size_t Level,
+        std::vector<wxRect>& Missing);
+
+      void PrefetchTiles(const wxRect& Viewport, const wxPoint& Direction);
+
+      void PostPrefetch();
+
     private:
 
+      std::shared_ptr<ImagePyramid> mpPyramid;
+
+      std::shared_ptr<TiledImage> mpTiledImage;
+
+      // tiles ahead of the last pan still to go to the worker pool
+      std::vector<TileIndex> mPrefetchTiles;
+
+      bool mIsPrefetching;
+
+      ScaleFilter mScaleFilter;
+
+      double mZoom;
+
+      // the image times mZoom, scrolled over by the viewport
+      wxSize mCanvasSize;
+
+      // just the visible part of the canvas
       wxBitmap mBitmap;
 
+      wxRect mBitmapViewport;
+
+      double mBitmapZoom;
+
+      // false while any of mBitmap is a nearest preview or background
+      bool mIsBitmapExact;
+
+      // the worker pool is scaling the viewport, and whether it has moved
+      // on since
+      bool mIsScaling;
+
+      bool mIsScaleStale;
+
+      // drawn straight onto the window, never into mBitmap
+      OverlayLayers mOverlays;
+
+      // background pyramid builds check this is still alive
+      std::shared_ptr<void> mpLifetime;
+
       std::unique_ptr<wxPoint> mpDrag;
 
       wxPoint mViewStart;
+
+      // drags scroll at most once per mPanPeriod milliseconds
+      wxTimer mPanTimer;
+
+      wxPoint mPanPosition;
+
+      bool mIsPanPending;
+
+      uint64_t mPaintCount;
+
+      static constexpr int mPanPeriod = 16;
   };
 }
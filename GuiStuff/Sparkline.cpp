@@ -0,0 +1,320 @@
+#include "Sparkline.hpp"
+#include <GuiStuff/FrameClock.hpp>
+
+#include <wx/dcbuffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using gs::SampleRing;
+using gs::Sparkline;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+SampleRing::SampleRing(std::size_t fieldCount, std::size_t capacity)
+  : mFieldCount(fieldCount),
+    mSlots(std::max(capacity, std::size_t(1))),
+    mValues(new std::atomic<double>[mSlots.GetCapacity() * mFieldCount])
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t SampleRing::GetFieldCount() const
+{
+  return mFieldCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t SampleRing::GetCapacity() const
+{
+  return mSlots.GetCapacity();
+}
+
+//------------------------------------------------------------------------------
+// A producer only waits on one that lapped the ring onto the same slot, and
+// drops its sample if a newer one already got there.
+//------------------------------------------------------------------------------
+void SampleRing::Push(const double* pValues)
+{
+  if (auto index = mSlots.BeginWrite())
+  {
+    auto pSlot = &mValues[mSlots.GetSlot(*index) * mFieldCount];
+
+    for (std::size_t field = 0; field < mFieldCount; ++field)
+    {
+      pSlot[field].store(pValues[field], std::memory_order_relaxed);
+    }
+
+    mSlots.EndWrite(*index);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t SampleRing::GetCount() const
+{
+  return mSlots.GetCount();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::optional<double> SampleRing::Get(uint64_t index, std::size_t field) const
+{
+  if (!mSlots.BeginRead(index))
+  {
+    return std::nullopt;
+  }
+
+  auto value = mValues[mSlots.GetSlot(index) * mFieldCount + field].load(
+    std::memory_order_relaxed);
+
+  if (!mSlots.EndRead(index))
+  {
+    return std::nullopt;
+  }
+
+  return value;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+Sparkline::Sparkline(
+  wxWindow* pParent,
+  std::shared_ptr<const SampleRing> pRing,
+  std::size_t field,
+  const wxString& label)
+  : wxWindow(pParent, wxID_ANY),
+    mpRing(std::move(pRing)),
+    mField(field),
+    mLabel(label),
+    mColumns(),
+    mSamplesPerColumn(1),
+    mNewestBucket(0),
+    mNextIndex(0),
+    mLastValue(),
+    mPaintCount(0)
+{
+  SetMinSize(wxSize(-1, mHeight));
+
+  SetBackgroundStyle(wxBG_STYLE_PAINT);
+
+  Bind(wxEVT_PAINT, &Sparkline::OnPaint, this);
+  Bind(wxEVT_SIZE, &Sparkline::OnResize, this);
+
+  Reset();
+}
+
+//------------------------------------------------------------------------------
+// At most a ring's worth of samples is folded, however long it has been.  A
+// sample a producer is still writing when it is reached is left out.
+//------------------------------------------------------------------------------
+void Sparkline::Synchronize()
+{
+  auto count = mpRing->GetCount();
+
+  if (count == mNextIndex)
+  {
+    return;
+  }
+
+  auto capacity = mpRing->GetCapacity();
+
+  auto index = std::max(mNextIndex, count > capacity ? count - capacity : 0);
+
+  for (; index < count; ++index)
+  {
+    auto value = mpRing->Get(index, mField);
+
+    if (value && std::isfinite(*value))
+    {
+      Fold(index, *value);
+
+      mLastValue = *value;
+    }
+  }
+
+  mNextIndex = count;
+
+  gs::FrameClock::GetInstance().Invalidate(this);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+uint64_t Sparkline::GetPaintCount() const
+{
+  return mPaintCount;
+}
+
+//------------------------------------------------------------------------------
+// Neighbouring columns are joined by stretching each one's line to reach the
+// one before, so a slowly changing field still draws as a continuous trace.
+//------------------------------------------------------------------------------
+void Sparkline::OnPaint(wxPaintEvent& event)
+{
+  wxAutoBufferedPaintDC Dc(this);
+
+  Dc.SetBackground(wxBrush(GetBackgroundColour()));
+
+  Dc.Clear();
+
+  auto minimum = std::numeric_limits<double>::infinity();
+
+  auto maximum = -std::numeric_limits<double>::infinity();
+
+  for (const auto& column : mColumns)
+  {
+    if (!column.mIsEmpty)
+    {
+      minimum = std::min(minimum, column.mMinimum);
+
+      maximum = std::max(maximum, column.mMaximum);
+    }
+  }
+
+  if (minimum > maximum)
+  {
+    Dc.DrawText(mLabel, 2, 0);
+
+    ++mPaintCount;
+
+    return;
+  }
+
+  auto height = GetClientSize().GetHeight() - 1;
+
+  auto range = maximum - minimum;
+
+  auto toY = [height, maximum, range] (double value)
+  {
+    if (range <= 0.0)
+    {
+      return height / 2;
+    }
+    return static_cast<int>(std::lround((maximum - value) / range * height));
+  };
+
+  Dc.SetPen(wxPen(wxColour(0, 120, 215)));
+
+  auto columnCount = static_cast<uint64_t>(mColumns.size());
+
+  auto shownCount = std::min(columnCount, mNewestBucket + 1);
+
+  const Column* pPrevious = nullptr;
+
+  for (auto age = shownCount; age-- > 0;)
+  {
+    const auto& column = mColumns[(mNewestBucket - age) % columnCount];
+
+    if (column.mIsEmpty)
+    {
+      pPrevious = nullptr;
+
+      continue;
+    }
+
+    auto low = column.mMinimum;
+
+    auto high = column.mMaximum;
+
+    if (pPrevious)
+    {
+      low = std::min(low, pPrevious->mMaximum);
+
+      high = std::max(high, pPrevious->mMinimum);
+    }
+
+    auto x = static_cast<int>(columnCount - 1 - age);
+
+    Dc.DrawLine(x, toY(high), x, toY(low) + 1);
+
+    pPrevious = &column;
+  }
+
+  Dc.DrawText(
+    mLabel + wxString::Format(
+      "  %g  [%g, %g]",
+      mLastValue.value_or(0.0),
+      minimum,
+      maximum),
+    2,
+    0);
+
+  ++mPaintCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void Sparkline::OnResize(wxSizeEvent& event)
+{
+  Reset();
+
+  Synchronize();
+
+  gs::FrameClock::GetInstance().Invalidate(this);
+}
+
+//------------------------------------------------------------------------------
+// Columns are sized so the whole ring fits across the window.
+//------------------------------------------------------------------------------
+void Sparkline::Reset()
+{
+  auto width = static_cast<uint64_t>(
+    std::max(GetClientSize().GetWidth(), 1));
+
+  mColumns.assign(width, Column {0.0, 0.0, true});
+
+  uint64_t capacity = mpRing->GetCapacity();
+
+  mSamplesPerColumn = std::max(uint64_t(1), (capacity + width - 1) / width);
+
+  mNewestBucket = 0;
+
+  auto count = mpRing->GetCount();
+
+  mNextIndex = count > capacity ? count - capacity : 0;
+
+  mLastValue.reset();
+}
+
+//------------------------------------------------------------------------------
+// Buckets passed over since the newest one are emptied on the way, older
+// than what the window shows are dropped.
+//------------------------------------------------------------------------------
+void Sparkline::Fold(uint64_t index, double value)
+{
+  auto bucket = index / mSamplesPerColumn;
+
+  auto columnCount = static_cast<uint64_t>(mColumns.size());
+
+  if (bucket > mNewestBucket)
+  {
+    auto passedCount = std::min(bucket - mNewestBucket, columnCount);
+
+    for (auto passed = bucket - passedCount + 1; passed <= bucket; ++passed)
+    {
+      mColumns[passed % columnCount].mIsEmpty = true;
+    }
+
+    mNewestBucket = bucket;
+  }
+  else if (mNewestBucket - bucket >= columnCount)
+  {
+    return;
+  }
+
+  auto& column = mColumns[bucket % columnCount];
+
+  if (column.mIsEmpty)
+  {
+    column = Column {value, value, false};
+  }
+  else
+  {
+    column.mMinimum = std::min(column.mMinimum, value);
+
+    column.mMaximum = std::max(column.mMaximum, value);
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <GuiStuff/StampedSlots.hpp>
+
+#include <wx/window.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // The last Capacity samples of FieldCount numeric fields, pushed a row at a
+  // time by any number of threads without locking or allocating.  Slots are
+  // stamped as in StampedSlots, so a slot overwritten under a reader, or by
+  // two producers a lap apart, is skipped rather than read torn.
+  //----------------------------------------------------------------------------
+  class SampleRing
+  {
+    public:
+
+      SampleRing(std::size_t FieldCount, std::size_t Capacity);
+
+      SampleRing(const SampleRing&) = delete;
+
+      SampleRing& operator = (const SampleRing&) = delete;
+
+      std::size_t GetFieldCount() const;
+
+      std::size_t GetCapacity() const;
+
+      // Any thread, pValues holding one value per field.
+      void Push(const double* pValues);
+
+      // Samples pushed so far, the newest being GetCount() - 1.
+      uint64_t GetCount() const;
+
+      // Field of sample Index, nothing once it has been overwritten or while
+      // it is still being written.
+      std::optional<double> Get(uint64_t Index, std::size_t Field) const;
+
+    private:
+
+      std::size_t mFieldCount;
+
+      StampedSlots mSlots;
+
+      // mFieldCount per slot, so a push writes one run of memory
+      std::unique_ptr<std::atomic<double>[]> mValues;
+  };
+
+  //----------------------------------------------------------------------------
+  // A strip chart of one field of a SampleRing, the ring's whole capacity
+  // across the window's width, newest on the right.  Samples are folded into
+  // a minimum and maximum per pixel column as they arrive.  A column always
+  // covers the same run of sample indices, so nothing is refolded as the
+  // chart scrolls and a paint draws one line per column whatever the sample
+  // rate or depth.  NaN and infinite samples are left out.  Gui thread only.
+  //----------------------------------------------------------------------------
+  class Sparkline : public wxWindow
+  {
+    public:
+
+      Sparkline(
+        wxWindow* pParent,
+        std::shared_ptr<const SampleRing> pRing,
+        std::size_t Field,
+        const wxString& Label);
+
+      // Folds in whatever was pushed since the last call and, if anything
+      // was, repaints on the next frame clock tick.
+      void Synchronize();
+
+      uint64_t GetPaintCount() const;
+
+    private:
+
+      struct Column
+      {
+        double mMinimum;
+
+        double mMaximum;
+
+        bool mIsEmpty;
+      };
+
+      void OnPaint(wxPaintEvent& Event);
+
+      void OnResize(wxSizeEvent& Event);
+
+      // Empties every column and refolds what the ring still holds.
+      void Reset();
+
+      void Fold(uint64_t Index, double Value);
+
+    private:
+
+      std::shared_ptr<const SampleRing> mpRing;
+
+      std::size_t mField;
+
+      wxString mLabel;
+
+      // one per pixel of width, bucket b of mSamplesPerColumn samples in
+      // column b modulo their count
+      std::vector<Column> mColumns;
+
+      uint64_t mSamplesPerColumn;
+
+      // the last mColumns.size() buckets up to this one are shown
+      uint64_t mNewestBucket;
+
+      // the first sample not folded in yet
+      uint64_t mNextIndex;
+
+      std::optional<double> mLastValue;
+
+      uint64_t mPaintCount;
+
+      static constexpr int mHeight = 48;
+  };
+}
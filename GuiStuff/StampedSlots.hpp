@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // The bookkeeping of a ring of Capacity slots that any number of producers
+  // write and readers read without locking.  Every write claims the next
+  // index with one atomic add, and each slot carries a stamp saying which
+  // index it holds and whether that is still being written.  Readers check
+  // the stamp before and after copying out of a slot, seqlock style, so they
+  // never use a value that was overwritten under them.  A producer only ever
+  // waits for another one that lapped the ring onto the same slot, and gives
+  // up its write if a newer index already got there.
+  //----------------------------------------------------------------------------
+  class StampedSlots
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      explicit StampedSlots(std::size_t capacity)
+        : mCapacity(capacity),
+          mCount(0),
+          mStamps(new std::atomic<uint64_t>[capacity])
+      {
+        for (std::size_t slot = 0; slot < mCapacity; ++slot)
+        {
+          mStamps[slot].store(0, std::memory_order_relaxed);
+        }
+      }
+
+      StampedSlots(const StampedSlots&) = delete;
+
+      StampedSlots& operator = (const StampedSlots&) = delete;
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      std::size_t GetCapacity() const
+      {
+        return mCapacity;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      std::size_t GetSlot(uint64_t index) const
+      {
+        return index % mCapacity;
+      }
+
+      //------------------------------------------------------------------------
+      // Indices claimed so far, the newest being GetCount() - 1.  Some of the
+      // newest may still be being written.
+      //------------------------------------------------------------------------
+      uint64_t GetCount() const
+      {
+        return mCount.load(std::memory_order_acquire);
+      }
+
+      //------------------------------------------------------------------------
+      // Any thread.  Claims the next index and its slot, nothing when a newer
+      // index took the slot first, in which case there is nothing to write.
+      // Otherwise the slot is the caller's until EndWrite.
+      //------------------------------------------------------------------------
+      std::optional<uint64_t> BeginWrite()
+      {
+        auto index = mCount.fetch_add(1, std::memory_order_relaxed);
+
+        auto& stamp = mStamps[GetSlot(index)];
+
+        auto expected = stamp.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+          if (expected & mWritingFlag)
+          {
+            std::this_thread::yield();
+
+            expected = stamp.load(std::memory_order_relaxed);
+          }
+          else if (expected >= GetPublished(index))
+          {
+            return std::nullopt;
+          }
+          else if (stamp.compare_exchange_weak(
+            expected,
+            GetPublished(index) | mWritingFlag,
+            std::memory_order_acquire,
+            std::memory_order_relaxed))
+          {
+            break;
+          }
+        }
+
+        std::atomic_thread_fence(std::memory_order_release);
+
+        return index;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void EndWrite(uint64_t index)
+      {
+        mStamps[GetSlot(index)].store(
+          GetPublished(index),
+          std::memory_order_release);
+      }
+
+      //------------------------------------------------------------------------
+      // Whether the slot of index holds it, to be checked again with EndRead
+      // once its values are copied out.
+      //------------------------------------------------------------------------
+      bool BeginRead(uint64_t index) const
+      {
+        return
+          mStamps[GetSlot(index)].load(std::memory_order_acquire) ==
+          GetPublished(index);
+      }
+
+      //------------------------------------------------------------------------
+      // Whether what was copied since BeginRead really was index.
+      //------------------------------------------------------------------------
+      bool EndRead(uint64_t index) const
+      {
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        return
+          mStamps[GetSlot(index)].load(std::memory_order_relaxed) ==
+          GetPublished(index);
+      }
+
+    private:
+
+      //------------------------------------------------------------------------
+      // 0 is a slot never written.
+      //------------------------------------------------------------------------
+      static uint64_t GetPublished(uint64_t index)
+      {
+        return (index + 1) << 1;
+      }
+
+    private:
+
+      static constexpr uint64_t mWritingFlag = 1;
+
+      std::size_t mCapacity;
+
+      std::atomic<uint64_t> mCount;
+
+      std::unique_ptr<std::atomic<uint64_t>[]> mStamps;
+  };
+}
@@ -0,0 +1,597 @@
+#include "TiledImage.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+using gs::TiledImage;
+
+namespace
+{
+  // What tiles of a file that doesn't record its alignment start on.
+  constexpr std::size_t cDefaultAlignment = 4096;
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  std::size_t GetPageSize()
+  {
+    auto pageSize = sysconf(_SC_PAGESIZE);
+
+    return pageSize > 0 ? std::size_t(pageSize) : cDefaultAlignment;
+  }
+
+  // The host's, which Write starts tiles on so evicting one never drops a
+  // neighbour's pages.  A file written on a host with smaller pages still
+  // opens, madvise then only gets the pages wholly inside a tile.
+  const std::size_t cPageSize = GetPageSize();
+
+  constexpr char cMagic[8] = {'G', 'S', 'T', 'I', 'L', 'E', 'S', '1'};
+
+  //----------------------------------------------------------------------------
+  // Followed by the levels, finest first, each a row major grid of tiles
+  // padded out to TileSize x TileSize.
+  //----------------------------------------------------------------------------
+  struct FileHeader
+  {
+    char mMagic[8];
+
+    uint32_t mWidth;
+
+    uint32_t mHeight;
+
+    uint32_t mTileSize;
+
+    uint32_t mLevelCount;
+
+    // 0 in files written before it was recorded
+    uint32_t mAlignment;
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  std::size_t AlignUp(std::size_t Bytes, std::size_t Alignment)
+  {
+    return (Bytes + Alignment - 1) / Alignment * Alignment;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  uintptr_t GetAddress(const uint8_t* pData)
+  {
+    return reinterpret_cast<uintptr_t>(pData);
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+TiledImage::TiledImage(const std::string& filename)
+  : mFile(filename),
+    mIsRaw(false),
+    mTileSize(0),
+    mTileBytes(0),
+    mLevels(),
+    mCacheMutex(),
+    mCache(),
+    mCacheIndex(),
+    mCachedBytes(0),
+    mMemoryCap(std::size_t(256) << 20)
+{
+  FileHeader header;
+
+  if (mFile.GetSize() < sizeof(header))
+  {
+    throw std::runtime_error(filename + " is not a tiled image");
+  }
+
+  std::memcpy(&header, mFile.GetData(), sizeof(header));
+
+  auto alignment =
+    header.mAlignment == 0 ? cDefaultAlignment : header.mAlignment;
+
+  if (
+    std::memcmp(header.mMagic, cMagic, sizeof(cMagic)) != 0 ||
+    header.mTileSize == 0 ||
+    header.mWidth == 0 ||
+    header.mHeight == 0 ||
+    (alignment & (alignment - 1)) != 0)
+  {
+    throw std::runtime_error(filename + " is not a tiled image");
+  }
+
+  mTileSize = header.mTileSize;
+
+  mTileBytes = AlignUp(std::size_t(mTileSize) * mTileSize * 3, alignment);
+
+  mLevels = DoGetLevels(header.mWidth, header.mHeight, mTileSize, alignment);
+
+  const auto& last = mLevels.back();
+
+  auto lastTileCount = std::size_t(last.mColumnCount) * last.mRowCount;
+
+  if (
+    mLevels.size() != header.mLevelCount ||
+    mFile.GetSize() < last.mOffset + lastTileCount * mTileBytes)
+  {
+    throw std::runtime_error(filename + " is truncated");
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+TiledImage::TiledImage(
+  const std::string& filename,
+  unsigned width,
+  unsigned height,
+  unsigned tileSize)
+  : mFile(filename),
+    mIsRaw(true),
+    mTileSize(std::max(tileSize, 1u)),
+    mTileBytes(0),
+    mLevels(),
+    mCacheMutex(),
+    mCache(),
+    mCacheIndex(),
+    mCachedBytes(0),
+    mMemoryCap(std::size_t(256) << 20)
+{
+  if (width == 0 || height == 0)
+  {
+    throw std::invalid_argument(filename + " has no pixels");
+  }
+
+  if (mFile.GetSize() < std::size_t(width) * height * 3)
+  {
+    throw std::runtime_error(filename + " is smaller than its image");
+  }
+
+  mLevels = DoGetLevels(width, height, mTileSize, cPageSize);
+
+  mLevels.resize(1);
+
+  mLevels[0].mOffset = 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void TiledImage::Write(
+  const std::string& filename,
+  const ImageView& source,
+  unsigned tileSize)
+{
+  if (source.mWidth == 0 || source.mHeight == 0 || tileSize == 0)
+  {
+    throw std::invalid_argument("nothing to write to " + filename);
+  }
+
+  auto levels =
+    DoGetLevels(source.mWidth, source.mHeight, tileSize, cPageSize);
+
+  auto tileBytes = AlignUp(std::size_t(tileSize) * tileSize * 3, cPageSize);
+
+  const auto& last = levels.back();
+
+  MappedFile file(
+    filename,
+    last.mOffset + std::size_t(last.mColumnCount) * last.mRowCount * tileBytes);
+
+  auto pBase = reinterpret_cast<uint8_t*>(file.GetData());
+
+  FileHeader header;
+
+  std::memcpy(header.mMagic, cMagic, sizeof(cMagic));
+
+  header.mWidth = source.mWidth;
+
+  header.mHeight = source.mHeight;
+
+  header.mTileSize = tileSize;
+
+  header.mLevelCount = static_cast<uint32_t>(levels.size());
+
+  header.mAlignment = static_cast<uint32_t>(cPageSize);
+
+  std::memcpy(pBase, &header, sizeof(header));
+
+  auto getTile = [&](std::size_t level, unsigned column, unsigned row)
+  {
+    return
+      pBase + levels[level].mOffset +
+      (std::size_t(row) * levels[level].mColumnCount + column) * tileBytes;
+  };
+
+  auto getPixel = [&](std::size_t level, unsigned x, unsigned y)
+  {
+    return
+      getTile(level, x / tileSize, y / tileSize) +
+      (std::size_t(y % tileSize) * tileSize + x % tileSize) * 3;
+  };
+
+  const auto& base = levels[0];
+
+  for (unsigned row = 0; row < base.mRowCount; ++row)
+  {
+    for (unsigned column = 0; column < base.mColumnCount; ++column)
+    {
+      auto pTile = getTile(0, column, row);
+
+      auto width = std::min(tileSize, base.mWidth - column * tileSize);
+
+      auto height = std::min(tileSize, base.mHeight - row * tileSize);
+
+      for (unsigned y = 0; y < height; ++y)
+      {
+        ConvertRow(
+          source,
+          row * tileSize + y,
+          column * tileSize,
+          column * tileSize + width,
+          pTile + std::size_t(y) * tileSize * 3);
+      }
+    }
+  }
+
+  // Same 2x2 box filter as ImagePyramid, reading the level just written.
+  for (std::size_t level = 1; level < levels.size(); ++level)
+  {
+    const auto& above = levels[level - 1];
+
+    const auto& current = levels[level];
+
+    for (unsigned y = 0; y < current.mHeight; ++y)
+    {
+      auto y0 = 2 * y;
+
+      auto y1 = std::min(y0 + 1, above.mHeight - 1);
+
+      for (unsigned x = 0; x < current.mWidth; ++x)
+      {
+        auto x0 = 2 * x;
+
+        auto x1 = std::min(x0 + 1, above.mWidth - 1);
+
+        auto p00 = getPixel(level - 1, x0, y0);
+
+        auto p01 = getPixel(level - 1, x1, y0);
+
+        auto p10 = getPixel(level - 1, x0, y1);
+
+        auto p11 = getPixel(level - 1, x1, y1);
+
+        auto pPixel = getPixel(level, x, y);
+
+        for (unsigned channel = 0; channel < 3; ++channel)
+        {
+          pPixel[channel] = static_cast<uint8_t>(
+            (p00[channel] + p01[channel] +
+             p10[channel] + p11[channel] + 2) >> 2);
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned TiledImage::GetWidth() const
+{
+  return mLevels[0].mWidth;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned TiledImage::GetHeight() const
+{
+  return mLevels[0].mHeight;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned TiledImage::GetTileSize() const
+{
+  return mTileSize;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t TiledImage::GetLevelCount() const
+{
+  return mLevels.size();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned TiledImage::GetLevelWidth(std::size_t level) const
+{
+  return mLevels[level].mWidth;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned TiledImage::GetLevelHeight(std::size_t level) const
+{
+  return mLevels[level].mHeight;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned TiledImage::GetColumnCount(std::size_t level) const
+{
+  return mLevels[level].mColumnCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned TiledImage::GetRowCount(std::size_t level) const
+{
+  return mLevels[level].mRowCount;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t TiledImage::GetLevelFor(double step) const
+{
+  if (step < 2.0)
+  {
+    return 0;
+  }
+
+  auto level = static_cast<std::size_t>(std::floor(std::log2(step)));
+
+  return std::min(level, mLevels.size() - 1);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void TiledImage::SetMemoryCap(std::size_t bytes)
+{
+  std::lock_guard lock(mCacheMutex);
+
+  mMemoryCap = bytes;
+
+  DoTrimCache();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t TiledImage::GetMemoryCap() const
+{
+  std::lock_guard lock(mCacheMutex);
+
+  return mMemoryCap;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t TiledImage::GetCachedBytes() const
+{
+  std::lock_guard lock(mCacheMutex);
+
+  return mCachedBytes;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool TiledImage::IsCached(
+  std::size_t level,
+  unsigned column,
+  unsigned row) const
+{
+  std::lock_guard lock(mCacheMutex);
+
+  return mCacheIndex.count(DoGetKey(level, column, row)) != 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::shared_ptr<const TiledImage::Tile> TiledImage::FindTile(
+  std::size_t level,
+  unsigned column,
+  unsigned row)
+{
+  std::lock_guard lock(mCacheMutex);
+
+  auto iEntry = mCacheIndex.find(DoGetKey(level, column, row));
+
+  if (iEntry == mCacheIndex.end())
+  {
+    return nullptr;
+  }
+
+  mCache.splice(mCache.begin(), mCache, iEntry->second);
+
+  return iEntry->second->second;
+}
+
+//------------------------------------------------------------------------------
+// Loading happens outside the lock so a prefetching worker never holds up
+// the GUI thread, if two threads load the same tile the first one in wins.
+//------------------------------------------------------------------------------
+std::shared_ptr<const TiledImage::Tile> TiledImage::GetTile(
+  std::size_t level,
+  unsigned column,
+  unsigned row)
+{
+  if (auto pTile = FindTile(level, column, row))
+  {
+    return pTile;
+  }
+
+  auto key = DoGetKey(level, column, row);
+
+  auto pTile = DoLoadTile(level, column, row);
+
+  std::lock_guard lock(mCacheMutex);
+
+  auto iEntry = mCacheIndex.find(key);
+
+  if (iEntry != mCacheIndex.end())
+  {
+    mCache.splice(mCache.begin(), mCache, iEntry->second);
+
+    return iEntry->second->second;
+  }
+
+  mCache.emplace_front(key, pTile);
+
+  mCacheIndex.emplace(key, mCache.begin());
+
+  mCachedBytes += pTile->mData.size() + pTile->mPageBytes;
+
+  DoTrimCache();
+
+  return pTile;
+}
+
+//------------------------------------------------------------------------------
+// Level, column and row sizes are all far below these field widths.
+//------------------------------------------------------------------------------
+uint64_t TiledImage::DoGetKey(
+  std::size_t level,
+  unsigned column,
+  unsigned row)
+{
+  return
+    (uint64_t(level) << 56) |
+    (uint64_t(column) << 28) |
+    uint64_t(row);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::vector<TiledImage::Level> TiledImage::DoGetLevels(
+  unsigned width,
+  unsigned height,
+  unsigned tileSize,
+  std::size_t alignment)
+{
+  std::vector<Level> levels;
+
+  auto tileBytes = AlignUp(std::size_t(tileSize) * tileSize * 3, alignment);
+
+  auto offset = AlignUp(sizeof(FileHeader), alignment);
+
+  while (true)
+  {
+    Level level {
+      width,
+      height,
+      (width + tileSize - 1) / tileSize,
+      (height + tileSize - 1) / tileSize,
+      offset};
+
+    levels.push_back(level);
+
+    offset += std::size_t(level.mColumnCount) * level.mRowCount * tileBytes;
+
+    if (std::max(width, height) <= tileSize || std::min(width, height) <= 1)
+    {
+      return levels;
+    }
+
+    width = (width + 1) / 2;
+
+    height = (height + 1) / 2;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Mapped tiles are touched a page at a time here so the page faults land on
+// whichever thread asked for the tile rather than on the renderer.  Only
+// bytes of the tile are touched, its last page may run past the file.
+//------------------------------------------------------------------------------
+std::shared_ptr<const TiledImage::Tile> TiledImage::DoLoadTile(
+  std::size_t levelIndex,
+  unsigned column,
+  unsigned row) const
+{
+  const auto& level = mLevels[levelIndex];
+
+  auto width = std::min(mTileSize, level.mWidth - column * mTileSize);
+
+  auto height = std::min(mTileSize, level.mHeight - row * mTileSize);
+
+  auto pBase = reinterpret_cast<const uint8_t*>(mFile.GetData());
+
+  auto pTile = std::make_shared<Tile>();
+
+  if (mIsRaw)
+  {
+    pTile->mData.resize(std::size_t(width) * height * 3);
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+      std::memcpy(
+        pTile->mData.data() + std::size_t(y) * width * 3,
+        pBase +
+          (std::size_t(row * mTileSize + y) * level.mWidth +
+           std::size_t(column) * mTileSize) * 3,
+        std::size_t(width) * 3);
+    }
+
+    pTile->mView = {pTile->mData.data(), width, height, std::size_t(width) * 3};
+
+    return pTile;
+  }
+
+  auto pData =
+    pBase + level.mOffset +
+    (std::size_t(row) * level.mColumnCount + column) * mTileBytes;
+
+  auto first = GetAddress(pData) / cPageSize * cPageSize;
+
+  auto end = GetAddress(pData) + mTileBytes;
+
+  madvise(reinterpret_cast<void*>(first), end - first, MADV_WILLNEED);
+
+  uint8_t sum = 0;
+
+  for (auto page = first; page < end; page += cPageSize)
+  {
+    sum += *reinterpret_cast<const volatile uint8_t*>(
+      std::max(page, GetAddress(pData)));
+  }
+
+  static_cast<void>(sum);
+
+  pTile->mView = {pData, width, height, std::size_t(mTileSize) * 3};
+
+  pTile->mpPages = pData;
+
+  pTile->mPageBytes = mTileBytes;
+
+  return pTile;
+}
+
+//------------------------------------------------------------------------------
+// Pages are only dropped when nothing outside the cache still holds the
+// tile, a holder can't get another reference without the lock, and only the
+// ones wholly inside it.
+//------------------------------------------------------------------------------
+void TiledImage::DoTrimCache()
+{
+  while (mCachedBytes > mMemoryCap && !mCache.empty())
+  {
+    auto& [key, pTile] = mCache.back();
+
+    mCachedBytes -= pTile->mData.size() + pTile->mPageBytes;
+
+    auto first = AlignUp(GetAddress(pTile->mpPages), cPageSize);
+
+    auto end =
+      (GetAddress(pTile->mpPages) + pTile->mPageBytes) / cPageSize * cPageSize;
+
+    if (pTile->mpPages && pTile.use_count() == 1 && first < end)
+    {
+      madvise(reinterpret_cast<void*>(first), end - first, MADV_DONTNEED);
+    }
+
+    mCacheIndex.erase(key);
+
+    mCache.pop_back();
+  }
+}
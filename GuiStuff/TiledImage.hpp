@@ -0,0 +1,170 @@
+#pragma once
+
+#include <GuiStuff/ImageScaler.hpp>
+#include <GuiStuff/MappedFile.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  // An RGB image too big to hold in memory, read a tile at a time from a
+  // memory mapped file.  A tiled file (see Write) stores every tile of every
+  // mip level contiguously so tiles are used straight out of the mapping, a
+  // raw file is packed RGB rows and has only level 0, its tiles are copied
+  // out of the rows when first needed.
+  //
+  // Tiles in use are kept in an LRU cache of at most GetMemoryCap bytes,
+  // evicted mapped tiles have their pages dropped.  GetTile and FindTile
+  // may be called from any thread.
+  //----------------------------------------------------------------------------
+  class TiledImage
+  {
+    public:
+
+      struct Tile
+      {
+        ImageView mView;
+
+        // empty for a tile read straight from the mapping
+        std::vector<uint8_t> mData;
+
+        // the mapped pages to drop when the tile is evicted
+        const uint8_t* mpPages = nullptr;
+
+        std::size_t mPageBytes = 0;
+      };
+
+      // Opens a file written by Write.
+      explicit TiledImage(const std::string& Filename);
+
+      // Opens Width x Height packed RGB pixels with no header.
+      TiledImage(
+        const std::string& Filename,
+        unsigned Width,
+        unsigned Height,
+        unsigned TileSize = 256);
+
+      TiledImage(const TiledImage&) = delete;
+
+      TiledImage& operator = (const TiledImage&) = delete;
+
+      // Writes Source and all its mip levels as a tiled file, converting it
+      // to RGB if it is in another format.  Source may itself be a mapped
+      // raw file.
+      static void Write(
+        const std::string& Filename,
+        const ImageView& Source,
+        unsigned TileSize = 256);
+
+      unsigned GetWidth() const;
+
+      unsigned GetHeight() const;
+
+      unsigned GetTileSize() const;
+
+      std::size_t GetLevelCount() const;
+
+      unsigned GetLevelWidth(std::size_t Level) const;
+
+      unsigned GetLevelHeight(std::size_t Level) const;
+
+      unsigned GetColumnCount(std::size_t Level) const;
+
+      unsigned GetRowCount(std::size_t Level) const;
+
+      // Same rule as ImagePyramid::GetLevelFor.
+      std::size_t GetLevelFor(double Step) const;
+
+      void SetMemoryCap(std::size_t Bytes);
+
+      std::size_t GetMemoryCap() const;
+
+      std::size_t GetCachedBytes() const;
+
+      bool IsCached(std::size_t Level, unsigned Column, unsigned Row) const;
+
+      // Returns the tile if it is cached, nullptr rather than reading it
+      // otherwise.  For paints, which mustn't wait on the disk.
+      std::shared_ptr<const Tile> FindTile(
+        std::size_t Level,
+        unsigned Column,
+        unsigned Row);
+
+      // Returns the tile, paging or decoding it in first if it isn't
+      // cached.  The pixels stay valid for as long as the result is held.
+      std::shared_ptr<const Tile> GetTile(
+        std::size_t Level,
+        unsigned Column,
+        unsigned Row);
+
+    private:
+
+      struct Level
+      {
+        unsigned mWidth;
+
+        unsigned mHeight;
+
+        unsigned mColumnCount;
+
+        unsigned mRowCount;
+
+        std::size_t mOffset;
+      };
+
+      using CacheList = std::list<
+        std::pair<uint64_t, std::shared_ptr<const Tile>>>;
+
+      // Tiles start on multiples of Alignment in the file.
+      static std::vector<Level> DoGetLevels(
+        unsigned Width,
+        unsigned Height,
+        unsigned TileSize,
+        std::size_t Alignment);
+
+      static uint64_t DoGetKey(
+        std::size_t Level,
+        unsigned Column,
+        unsigned Row);
+
+      std::shared_ptr<const Tile> DoLoadTile(
+        std::size_t Level,
+        unsigned Column,
+        unsigned Row) const;
+
+      void DoTrimCache();
+
+    private:
+
+      MappedFile mFile;
+
+      bool mIsRaw;
+
+      unsigned mTileSize;
+
+      std::size_t mTileBytes;
+
+      std::vector<Level> mLevels;
+
+      mutable std::mutex mCacheMutex;
+
+      // most recently used at the front
+      CacheList mCache;
+
+      std::unordered_map<uint64_t, CacheList::iterator> mCacheIndex;
+
+      std::size_t mCachedBytes;
+
+      std::size_t mMemoryCap;
+  };
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace gs
+{
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct UpdateStatisticsSnapshot
+  {
+    uint64_t mReceivedCount = 0;
+
+    uint64_t mDisplayedCount = 0;
+
+    uint64_t mCoalescedCount = 0;
+
+    double mReceivedRate = 0.0;
+
+    double mDisplayedRate = 0.0;
+
+    std::chrono::nanoseconds mLatencyP50 = std::chrono::nanoseconds(0);
+
+    std::chrono::nanoseconds mLatencyP99 = std::chrono::nanoseconds(0);
+  };
+
+  //----------------------------------------------------------------------------
+  // Log scale histogram, eight buckets per power of two microseconds.  Good to
+  // about 6% which is plenty for telling 2 ms from 20 ms.
+  //----------------------------------------------------------------------------
+  class LatencyHistogram
+  {
+    public:
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      LatencyHistogram()
+        : mBuckets(),
+          mCount(0)
+      {
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void Add(std::chrono::nanoseconds latency)
+      {
+        ++mBuckets[GetBucket(latency)];
+
+        ++mCount;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      std::chrono::nanoseconds GetPercentile(double percentile) const
+      {
+        if (mCount == 0)
+        {
+          return std::chrono::nanoseconds(0);
+        }
+
+        auto target = static_cast<uint64_t>(percentile * (mCount - 1)) + 1;
+
+        uint64_t count = 0;
+
+        for (std::size_t i = 0; i < mBuckets.size(); ++i)
+        {
+          count += mBuckets[i];
+
+          if (count >= target)
+          {
+            return GetBucketValue(i);
+          }
+        }
+        return GetBucketValue(mBuckets.size() - 1);
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void Clear()
+      {
+        mBuckets.fill(0);
+
+        mCount = 0;
+      }
+
+    private:
+
+      static constexpr std::size_t mSubBucketBits = 3;
+
+      static constexpr std::size_t mSubBucketCount = 1 << mSubBucketBits;
+
+      static constexpr std::size_t mOctaveCount = 32;
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      static std::size_t GetBucket(std::chrono::nanoseconds latency)
+      {
+        auto microseconds = static_cast<uint64_t>(
+          std::max<int64_t>(latency.count() / 1000, 1));
+
+        std::size_t octave = 0;
+
+        while ((microseconds >> (octave + 1)) != 0 && octave + 1 < mOctaveCount)
+        {
+          ++octave;
+        }
+
+        auto base = uint64_t(1) << octave;
+
+        auto subBucket = std::min<uint64_t>(
+          ((microseconds - base) << mSubBucketBits) >> octave,
+          mSubBucketCount - 1);
+
+        return octave * mSubBucketCount + subBucket;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      static std::chrono::nanoseconds GetBucketValue(std::size_t bucket)
+      {
+        auto octave = bucket / mSubBucketCount;
+
+        auto subBucket = bucket % mSubBucketCount;
+
+        auto microseconds =
+          double(uint64_t(1) << octave) *
+          (1.0 + (subBucket + 0.5) / mSubBucketCount);
+
+        return std::chrono::nanoseconds(static_cast<int64_t>(microseconds * 1e3));
+      }
+
+    private:
+
+      std::array<uint32_t, mOctaveCount * mSubBucketCount> mBuckets;
+
+      uint64_t mCount;
+  };
+
+  //----------------------------------------------------------------------------
+  // Per packet type counters.  OnReceived is the only producer side call and
+  // is a couple of relaxed atomics; everything else runs on the gui thread
+  // except GetSnapshot which can be called from anywhere.
+  //----------------------------------------------------------------------------
+  class UpdateStatistics
+  {
+    public:
+
+      using Clock = std::chrono::steady_clock;
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      UpdateStatistics()
+        : mReceivedCount(0),
+          mPendingSince(0),
+          mDisplayedCount(0),
+          mIsPaintPending(false),
+          mLatencies(),
+          mLastSampleTime(Clock::now()),
+          mLastReceivedCount(0),
+          mLastDisplayedCount(0),
+          mSnapshotMutex(),
+          mSnapshot()
+      {
+      }
+
+      UpdateStatistics(const UpdateStatistics&) = delete;
+
+      UpdateStatistics& operator = (const UpdateStatistics&) = delete;
+
+      //------------------------------------------------------------------------
+      // Producer side.  Only the oldest update that hasn't been painted yet
+      // keeps its timestamp, that is the one the latency is measured from.
+      //------------------------------------------------------------------------
+      void OnReceived()
+      {
+        mReceivedCount.fetch_add(1, std::memory_order_relaxed);
+
+        if (mPendingSince.load(std::memory_order_relaxed) == 0)
+        {
+          int64_t expected = 0;
+
+          mPendingSince.compare_exchange_strong(
+            expected,
+            Clock::now().time_since_epoch().count(),
+            std::memory_order_relaxed);
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      void OnDisplayed()
+      {
+        ++mDisplayedCount;
+
+        mIsPaintPending = true;
+      }
+
+      //------------------------------------------------------------------------
+      // Only the first paint after a display counts, resizes and exposes
+      // put nothing new on screen.
+      //------------------------------------------------------------------------
+      void OnPainted()
+      {
+        if (!mIsPaintPending)
+        {
+          return;
+        }
+
+        mIsPaintPending = false;
+
+        auto pendingSince = mPendingSince.exchange(0, std::memory_order_relaxed);
+
+        if (pendingSince != 0)
+        {
+          auto now = Clock::now().time_since_epoch().count();
+
+          mLatencies.Add(std::chrono::nanoseconds(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+              Clock::duration(now - pendingSince))));
+        }
+      }
+
+      //------------------------------------------------------------------------
+      // Gui thread.  Turns the counts since the last call into rates and
+      // percentiles.
+      //------------------------------------------------------------------------
+      const UpdateStatisticsSnapshot& Sample(uint64_t coalescedCount)
+      {
+        auto now = Clock::now();
+
+        auto seconds =
+          std::chrono::duration<double>(now - mLastSampleTime).count();
+
+        auto receivedCount = mReceivedCount.load(std::memory_order_relaxed);
+
+        UpdateStatisticsSnapshot snapshot;
+
+        snapshot.mReceivedCount = receivedCount;
+
+        snapshot.mDisplayedCount = mDisplayedCount;
+
+        snapshot.mCoalescedCount = coalescedCount;
+
+        if (seconds > 0.0)
+        {
+          snapshot.mReceivedRate =
+            (receivedCount - mLastReceivedCount) / seconds;
+
+          snapshot.mDisplayedRate =
+            (mDisplayedCount - mLastDisplayedCount) / seconds;
+        }
+
+        snapshot.mLatencyP50 = mLatencies.GetPercentile(0.50);
+
+        snapshot.mLatencyP99 = mLatencies.GetPercentile(0.99);
+
+        mLatencies.Clear();
+
+        mLastSampleTime = now;
+
+        mLastReceivedCount = receivedCount;
+
+        mLastDisplayedCount = mDisplayedCount;
+
+        std::lock_guard lock(mSnapshotMutex);
+
+        mSnapshot = snapshot;
+
+        return mSnapshot;
+      }
+
+      //------------------------------------------------------------------------
+      //------------------------------------------------------------------------
+      UpdateStatisticsSnapshot GetSnapshot() const
+      {
+        std::lock_guard lock(mSnapshotMutex);
+
+        return mSnapshot;
+      }
+
+    private:
+
+      alignas(64) std::atomic<uint64_t> mReceivedCount;
+
+      std::atomic<int64_t> mPendingSince;
+
+      alignas(64) uint64_t mDisplayedCount;
+
+      // displayed since the last paint
+      bool mIsPaintPending;
+
+      LatencyHistogram mLatencies;
+
+      Clock::time_point mLastSampleTime;
+
+      uint64_t mLastReceivedCount;
+
+      uint64_t mLastDisplayedCount;
+
+      mutable std::mutex mSnapshotMutex;
+
+      UpdateStatisticsSnapshot mSnapshot;
+  };
+}
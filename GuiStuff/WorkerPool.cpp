@@ -0,0 +1,168 @@
+#include "WorkerPool.hpp"
+#include <GuiStuff/GuiDispatcher.hpp>
+
+#include <wx/module.h>
+
+#include <algorithm>
+#include <atomic>
+
+using gs::WorkerPool;
+
+namespace
+{
+  // so shutting down doesn't start a pool that was never used
+  std::atomic<bool> isInstanceMade(false);
+}
+
+//------------------------------------------------------------------------------
+// Jobs and the gui closures they post hold bitmaps and windows, which have
+// to go while wx is still up and on the gui thread, not in static
+// destruction.  The pool goes first as its last jobs post to the dispatcher.
+//------------------------------------------------------------------------------
+class WorkerPoolModule : public wxModule
+{
+  public:
+
+    bool OnInit() override
+    {
+      return true;
+    }
+
+    void OnExit() override
+    {
+      if (isInstanceMade.load())
+      {
+        WorkerPool::GetInstance().Shutdown();
+      }
+
+      gs::GuiDispatcher::GetInstance().Shutdown();
+    }
+
+  private:
+
+    wxDECLARE_DYNAMIC_CLASS(WorkerPoolModule);
+};
+
+wxIMPLEMENT_DYNAMIC_CLASS(WorkerPoolModule, wxModule);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+WorkerPool& WorkerPool::GetInstance()
+{
+  static WorkerPool workerPool(
+    std::max(2u, std::thread::hardware_concurrency() / 2));
+
+  [[maybe_unused]] static auto isMarked = isInstanceMade.exchange(true);
+
+  return workerPool;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+WorkerPool::WorkerPool(unsigned ThreadCount)
+  : mMutex(),
+    mCondition(),
+    mJobs(),
+    mIsStopping(false),
+    mThreads()
+{
+  for (auto i = 0u; i < std::max(1u, ThreadCount); ++i)
+  {
+    mThreads.emplace_back([this] { Run(); });
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+  Shutdown();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void WorkerPool::Post(std::function<void()> Job)
+{
+  {
+    std::lock_guard lock(mMutex);
+
+    if (mIsStopping)
+    {
+      return;
+    }
+
+    mJobs.push_back(std::move(Job));
+  }
+
+  mCondition.notify_one();
+}
+
+//------------------------------------------------------------------------------
+// The queued jobs are destroyed once the workers are joined, outside the
+// lock in case destroying one posts another.
+//------------------------------------------------------------------------------
+void WorkerPool::Shutdown()
+{
+  std::deque<std::function<void()>> jobs;
+
+  {
+    std::lock_guard lock(mMutex);
+
+    mIsStopping = true;
+
+    jobs.swap(mJobs);
+  }
+
+  mCondition.notify_all();
+
+  for (auto& thread : mThreads)
+  {
+    if (thread.joinable())
+    {
+      thread.join();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+unsigned WorkerPool::GetThreadCount() const
+{
+  return mThreads.size();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+std::size_t WorkerPool::GetQueueDepth() const
+{
+  std::lock_guard lock(mMutex);
+
+  return mJobs.size();
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void WorkerPool::Run()
+{
+  while (true)
+  {
+    std::function<void()> job;
+
+    {
+      std::unique_lock lock(mMutex);
+
+      mCondition.wait(lock, [this] { return mIsStopping || !mJobs.empty(); });
+
+      if (mJobs.empty())
+      {
+        return;
+      }
+
+      job = std::move(mJobs.front());
+
+      mJobs.pop_front();
+    }
+
+    job();
+  }
+}
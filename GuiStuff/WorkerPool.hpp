@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+namespace gs
+{
+  class WorkerPool
+  {
+    public:
+
+      // Shared by all the image widgets.
+      static WorkerPool& GetInstance();
+
+      explicit WorkerPool(unsigned ThreadCount);
+
+      ~WorkerPool();
+
+      WorkerPool(const WorkerPool&) = delete;
+
+      WorkerPool& operator = (const WorkerPool&) = delete;
+
+      // Dropped once shut down.
+      void Post(std::function<void()> Job);
+
+      // Lets the jobs running finish, destroys the ones still queued on the
+      // calling thread and stops the workers.  Done for the shared pool by a
+      // wxModule as the app exits, so no job outlives wx.
+      void Shutdown();
+
+      unsigned GetThreadCount() const;
+
+      std::size_t GetQueueDepth() const;
+
+    private:
+
+      void Run();
+
+    private:
+
+      mutable std::mutex mMutex;
+
+      std::condition_variable mCondition;
+
+      std::deque<std::function<void()>> mJobs;
+
+      bool mIsStopping;
+
+      std::vector<std::thread> mThreads;
+  };
+}
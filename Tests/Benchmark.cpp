@@ -0,0 +1,1113 @@
+#include "Packets.hpp"
+
+#include <GuiStuff/FrameClock.hpp>
+#include <GuiStuff/GridDisplayer.hpp>
+#include <GuiStuff/ImageStatistics.hpp>
+#include <GuiStuff/MultiImageWindow.hpp>
+#include <GuiStuff/Overlay.hpp>
+#include <GuiStuff/PictureInPictureWindow.hpp>
+#include <GuiStuff/ScrollWindow.hpp>
+#include <GuiStuff/Sparkline.hpp>
+
+#include <wx/app.h>
+#include <wx/frame.h>
+#include <wx/image.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//******************************************************************************
+// Headless benchmarks for the GuiStuff widgets, meant to be run under Xvfb
+// (see the benchmark target).  Results are written as json to the file named
+// on the command line, or to stdout.
+//******************************************************************************
+class App : public wxApp
+{
+  public:
+
+    bool OnInit() override;
+
+  private:
+
+    void RunBenchmarks();
+
+  private:
+
+    wxFrame* mpFrame;
+
+    std::string mOutputFilename;
+};
+
+IMPLEMENT_APP(App);
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct Result
+  {
+    std::string mName;
+
+    std::string mParameters;
+
+    double mValue;
+
+    std::string mUnit;
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  struct Resolution
+  {
+    const char* mName;
+
+    unsigned mWidth;
+
+    unsigned mHeight;
+  };
+
+  constexpr Resolution Resolutions[] =
+  {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4K", 3840, 2160}
+  };
+
+  //----------------------------------------------------------------------------
+  // Owns the pixels behind a dl::image::Image.
+  //----------------------------------------------------------------------------
+  struct TestImage
+  {
+    std::vector<std::byte> mPixels;
+
+    std::shared_ptr<const dl::image::Image> mpImage;
+  };
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  std::unique_ptr<TestImage> MakeTestImage(
+    unsigned width,
+    unsigned height,
+    unsigned seed)
+  {
+    auto pTestImage = std::make_unique<TestImage>();
+
+    pTestImage->mPixels.resize(std::size_t(width) * height * 3);
+
+    auto pPixel = pTestImage->mPixels.data();
+
+    for (auto y = 0u; y < height; ++y)
+    {
+      for (auto x = 0u; x < width; ++x)
+      {
+        *pPixel++ = std::byte((x + seed) & 0xff);
+        *pPixel++ = std::byte((y + seed) & 0xff);
+        *pPixel++ = std::byte((x ^ y) & 0xff);
+      }
+    }
+
+    pTestImage->mpImage = std::make_shared<const dl::image::Image>(
+      width,
+      height,
+      std::experimental::make_observer(pTestImage->mPixels.data()));
+
+    return pTestImage;
+  }
+
+  //----------------------------------------------------------------------------
+  // An RGGB Bayer mosaic, one byte a pixel.
+  //----------------------------------------------------------------------------
+  std::unique_ptr<TestImage> MakeTestMosaic(
+    unsigned width,
+    unsigned height,
+    unsigned seed)
+  {
+    auto pTestImage = std::make_unique<TestImage>();
+
+    pTestImage->mPixels.resize(std::size_t(width) * height);
+
+    auto pPixel = pTestImage->mPixels.data();
+
+    for (auto y = 0u; y < height; ++y)
+    {
+      for (auto x = 0u; x < width; ++x)
+      {
+        *pPixel++ = std::byte((x + y + seed) & 0xff);
+      }
+    }
+
+    pTestImage->mpImage = std::make_shared<const dl::image::Image>(
+      width,
+      height,
+      std::experimental::make_observer(pTestImage->mPixels.data()));
+
+    return pTestImage;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  wxImage MakeTestWxImage(unsigned width, unsigned height)
+  {
+    wxImage image(width, height, false);
+
+    auto pPixel = image.GetData();
+
+    for (auto y = 0u; y < height; ++y)
+    {
+      for (auto x = 0u; x < width; ++x)
+      {
+        *pPixel++ = x & 0xff;
+        *pPixel++ = y & 0xff;
+        *pPixel++ = (x ^ y) & 0xff;
+      }
+    }
+    return image;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  double ToMilliseconds(Clock::duration duration)
+  {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  double GetPercentile(std::vector<double> samples, double percentile)
+  {
+    if (samples.empty())
+    {
+      return 0.0;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    return samples[static_cast<std::size_t>(percentile * (samples.size() - 1))];
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void AddPercentiles(
+    std::vector<Result>& results,
+    const std::string& name,
+    const std::string& parameters,
+    const std::vector<double>& samples)
+  {
+    results.push_back(
+      {name + "_p50", parameters, GetPercentile(samples, 0.50), "ms"});
+
+    results.push_back(
+      {name + "_p99", parameters, GetPercentile(samples, 0.99), "ms"});
+  }
+
+  //----------------------------------------------------------------------------
+  // Pumps the event loop until done returns true or timeout has gone by.
+  //----------------------------------------------------------------------------
+  bool PumpUntil(
+    const std::function<bool()>& done,
+    Clock::duration timeout = std::chrono::seconds(1))
+  {
+    auto deadline = Clock::now() + timeout;
+
+    while (!done())
+    {
+      if (Clock::now() > deadline)
+      {
+        return false;
+      }
+
+      wxYield();
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Lets a display frame go by so the next drag motion scrolls straight away
+  // instead of being folded into a pending one.
+  //----------------------------------------------------------------------------
+  void PumpFrame()
+  {
+    auto end = Clock::now() + std::chrono::milliseconds(20);
+
+    PumpUntil([end] { return Clock::now() >= end; });
+  }
+
+  //----------------------------------------------------------------------------
+  // Runs every closure queued for the gui thread, which may point at the
+  // widget about to be destroyed.  Throws if they don't drain, as going on
+  // would leave them to run against a deleted widget.
+  //----------------------------------------------------------------------------
+  void DrainGuiDispatcher()
+  {
+    auto isDrained = PumpUntil(
+      []
+      {
+        return
+          gs::GuiDispatcher::GetInstance().GetStatistics().mQueueDepth == 0;
+      },
+      std::chrono::seconds(60));
+
+    if (!isDrained)
+    {
+      throw std::runtime_error("gui thread closures did not drain in 60 s");
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void PostMouseEvent(
+    wxWindow* pWindow,
+    const wxEventTypeTag<wxMouseEvent>& type,
+    const wxPoint& position)
+  {
+    wxMouseEvent event(type);
+
+    event.SetPosition(position);
+
+    event.SetEventObject(pWindow);
+
+    pWindow->GetEventHandler()->ProcessEvent(event);
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void BenchmarkGridSet(wxFrame* pFrame, std::vector<Result>& results)
+  {
+    using Displayer =
+      gs::GridDisplayer<gs::test::MotorCommand, gs::test::Position>;
+
+    for (auto policy : {gs::UpdatePolicy::Immediate, gs::UpdatePolicy::Coalesced})
+    {
+      for (auto threadCount : {1u, 2u, 4u, 8u, 16u, 32u})
+      {
+        gs::GridDisplayerOptions options;
+
+        options.mUpdatePolicy = policy;
+
+        auto pDisplayer = new Displayer(pFrame, options);
+
+        std::atomic<bool> isRunning(true);
+
+        std::atomic<uint64_t> setCount(0);
+
+        std::vector<std::thread> threads;
+
+        auto startTime = Clock::now();
+
+        for (auto i = 0u; i < threadCount; ++i)
+        {
+          threads.emplace_back([&isRunning, &setCount, pDisplayer, i]
+          {
+            uint64_t count = 0;
+
+            while (isRunning.load(std::memory_order_relaxed))
+            {
+              pDisplayer->Set(gs::test::Position{double(i), 1.0, 2.0, double(count)});
+
+              ++count;
+            }
+
+            setCount += count;
+          });
+        }
+
+        while (Clock::now() - startTime < std::chrono::milliseconds(250))
+        {
+          wxYield();
+        }
+
+        isRunning = false;
+
+        for (auto& thread : threads)
+        {
+          thread.join();
+        }
+
+        auto seconds =
+          std::chrono::duration<double>(Clock::now() - startTime).count();
+
+        std::ostringstream parameters;
+
+        parameters
+          << "{\"policy\": \""
+          << (policy == gs::UpdatePolicy::Immediate ? "immediate" : "coalesced")
+          << "\", \"threads\": " << threadCount << "}";
+
+        results.push_back(
+          {"grid_set_throughput", parameters.str(), setCount / seconds, "sets/s"});
+
+        DrainGuiDispatcher();
+
+        pDisplayer->Destroy();
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Packet storage grids flooded from four threads: how many grid repaints
+  // the frame clock lets through against how many it was asked for.
+  //----------------------------------------------------------------------------
+  void BenchmarkFrameClock(wxFrame* pFrame, std::vector<Result>& results)
+  {
+    using Displayer =
+      gs::GridDisplayer<gs::test::MotorCommand, gs::test::Position>;
+
+    gs::GridDisplayerOptions options;
+
+    options.mStorage = gs::GridStorage::Packet;
+
+    auto pDisplayer = new Displayer(pFrame, options);
+
+    DrainGuiDispatcher();
+
+    auto& frameClock = gs::FrameClock::GetInstance();
+
+    auto startStatistics = frameClock.GetStatistics();
+
+    std::atomic<bool> isRunning(true);
+
+    std::vector<std::thread> threads;
+
+    auto startTime = Clock::now();
+
+    for (auto i = 0u; i < 4; ++i)
+    {
+      threads.emplace_back([&isRunning, pDisplayer, i]
+      {
+        uint64_t count = 0;
+
+        while (isRunning.load(std::memory_order_relaxed))
+        {
+          pDisplayer->Set(
+            gs::test::Position{double(i), 1.0, 2.0, double(count++)});
+        }
+      });
+    }
+
+    while (Clock::now() - startTime < std::chrono::milliseconds(500))
+    {
+      wxYield();
+    }
+
+    isRunning = false;
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    DrainGuiDispatcher();
+
+    auto seconds =
+      std::chrono::duration<double>(Clock::now() - startTime).count();
+
+    auto statistics = frameClock.GetStatistics();
+
+    std::string parameters = "{\"storage\": \"packet\", \"threads\": 4}";
+
+    results.push_back({
+      "frame_clock_invalidation_rate",
+      parameters,
+      (statistics.mInvalidationCount - startStatistics.mInvalidationCount) /
+        seconds,
+      "invalidations/s"});
+
+    results.push_back({
+      "frame_clock_repaint_rate",
+      parameters,
+      (statistics.mRepaintCount - startStatistics.mRepaintCount) / seconds,
+      "repaints/s"});
+
+    results.push_back({
+      "frame_clock_paint_time",
+      parameters,
+      ToMilliseconds(statistics.mPaintTime),
+      "ms"});
+
+    pDisplayer->Destroy();
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void BenchmarkPictureInPicture(wxFrame* pFrame, std::vector<Result>& results)
+  {
+    constexpr auto iterationCount = 30;
+
+    for (const auto& resolution : Resolutions)
+    {
+      auto parameters =
+        std::string("{\"resolution\": \"") + resolution.mName + "\"}";
+
+      std::unique_ptr<TestImage> testImages[] =
+      {
+        MakeTestImage(resolution.mWidth, resolution.mHeight, 0),
+        MakeTestImage(resolution.mWidth, resolution.mHeight, 64)
+      };
+
+      auto pWindow = new gs::PictureInPictureWindow(pFrame);
+
+      pWindow->SetSize(wxSize(1280, 720));
+
+      using Setter = void (gs::PictureInPictureWindow::*)(
+        const std::shared_ptr<const dl::image::Image>&);
+
+      const std::pair<const char*, Setter> setters[] =
+      {
+        {"pip_set_image1_latency", &gs::PictureInPictureWindow::SetImage1},
+        {"pip_set_image2_latency", &gs::PictureInPictureWindow::SetImage2}
+      };
+
+      for (const auto& [name, pSetter] : setters)
+      {
+        std::vector<double> latencies;
+
+        for (auto i = 0; i < iterationCount; ++i)
+        {
+          auto paintCount = pWindow->GetPaintCount();
+
+          auto startTime = Clock::now();
+
+          (pWindow->*pSetter)(testImages[i % 2]->mpImage);
+
+          if (PumpUntil([&] { return pWindow->GetPaintCount() > paintCount; }))
+          {
+            latencies.push_back(ToMilliseconds(Clock::now() - startTime));
+          }
+        }
+
+        AddPercentiles(results, name, parameters, latencies);
+      }
+
+      std::unique_ptr<TestImage> mosaics[] =
+      {
+        MakeTestMosaic(resolution.mWidth, resolution.mHeight, 0),
+        MakeTestMosaic(resolution.mWidth, resolution.mHeight, 64)
+      };
+
+      std::vector<double> bayerLatencies;
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        auto paintCount = pWindow->GetPaintCount();
+
+        auto startTime = Clock::now();
+
+        pWindow->SetImage1(
+          mosaics[i % 2]->mpImage,
+          {gs::PixelEncoding::BayerRg8});
+
+        if (PumpUntil([&] { return pWindow->GetPaintCount() > paintCount; }))
+        {
+          bayerLatencies.push_back(ToMilliseconds(Clock::now() - startTime));
+        }
+      }
+
+      AddPercentiles(
+        results,
+        "pip_set_bayer_image1_latency",
+        parameters,
+        bayerLatencies);
+
+      std::vector<double> paintTimes;
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        auto startTime = Clock::now();
+
+        pWindow->Refresh(false);
+
+        pWindow->Update();
+
+        paintTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+      }
+
+      AddPercentiles(results, "pip_paint", parameters, paintTimes);
+
+      std::vector<double> panTimes;
+
+      auto position = wxPoint(640, 200);
+
+      PostMouseEvent(pWindow, wxEVT_LEFT_DOWN, position);
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        position.x += (i < iterationCount / 2) ? -8 : 8;
+
+        PumpFrame();
+
+        auto startTime = Clock::now();
+
+        PostMouseEvent(pWindow, wxEVT_MOTION, position);
+
+        pWindow->Update();
+
+        panTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+      }
+
+      PostMouseEvent(pWindow, wxEVT_LEFT_UP, position);
+
+      AddPercentiles(results, "pip_pan_frame", parameters, panTimes);
+
+      DrainGuiDispatcher();
+
+      pWindow->Destroy();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Sixteen streams: the time from a frame on every stream to all of them on
+  // screen in an undecimated grid, then how many rescales a mosaic makes of
+  // a second of 60 Hz frames with the default decimation.
+  //----------------------------------------------------------------------------
+  void BenchmarkMultiImage(wxFrame* pFrame, std::vector<Result>& results)
+  {
+    constexpr auto iterationCount = 30;
+
+    constexpr std::size_t streamCount = 16;
+
+    for (const auto& resolution : Resolutions)
+    {
+      auto parameters =
+        std::string("{\"resolution\": \"") + resolution.mName +
+        "\", \"streams\": " + std::to_string(streamCount) + "}";
+
+      std::unique_ptr<TestImage> testImages[] =
+      {
+        MakeTestImage(resolution.mWidth, resolution.mHeight, 0),
+        MakeTestImage(resolution.mWidth, resolution.mHeight, 64)
+      };
+
+      auto pWindow = new gs::MultiImageWindow(pFrame, streamCount);
+
+      pWindow->SetSize(wxSize(1280, 720));
+
+      pWindow->SetDecimation(wxSize(0, 0), std::chrono::milliseconds(0));
+
+      auto getDisplayedCount = [pWindow]
+      {
+        uint64_t count = 0;
+
+        for (std::size_t stream = 0; stream < streamCount; ++stream)
+        {
+          count += pWindow->GetFrameCounters(stream).mDisplayedCount;
+        }
+        return count;
+      };
+
+      std::vector<double> latencies;
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        auto displayedCount = getDisplayedCount();
+
+        auto startTime = Clock::now();
+
+        for (std::size_t stream = 0; stream < streamCount; ++stream)
+        {
+          pWindow->SetImage(stream, testImages[i % 2]->mpImage);
+        }
+
+        if (PumpUntil([&]
+          {
+            return getDisplayedCount() >= displayedCount + streamCount;
+          }))
+        {
+          latencies.push_back(ToMilliseconds(Clock::now() - startTime));
+        }
+      }
+
+      AddPercentiles(results, "multi_set_all_latency", parameters, latencies);
+
+      pWindow->SetLayout(gs::MultiImageWindow::Layout::Mosaic);
+
+      pWindow->SetDecimation(wxSize(320, 240), std::chrono::milliseconds(100));
+
+      DrainGuiDispatcher();
+
+      auto displayedCount = getDisplayedCount();
+
+      auto frameTime = Clock::now();
+
+      for (auto i = 0; i < 60; ++i)
+      {
+        for (std::size_t stream = 0; stream < streamCount; ++stream)
+        {
+          pWindow->SetImage(stream, testImages[i % 2]->mpImage);
+        }
+
+        frameTime += std::chrono::microseconds(16667);
+
+        PumpUntil([frameTime] { return Clock::now() >= frameTime; });
+      }
+
+      DrainGuiDispatcher();
+
+      results.push_back({
+        "multi_mosaic_frames_displayed",
+        parameters,
+        static_cast<double>(getDisplayedCount() - displayedCount),
+        "frames"});
+
+      pWindow->Destroy();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void BenchmarkScrollWindow(wxFrame* pFrame, std::vector<Result>& results)
+  {
+    constexpr auto iterationCount = 60;
+
+    for (const auto& resolution : Resolutions)
+    {
+      auto parameters =
+        std::string("{\"resolution\": \"") + resolution.mName + "\"}";
+
+      auto startTime = Clock::now();
+
+      auto pWindow = new gs::ScrollWindow(
+        pFrame,
+        MakeTestWxImage(resolution.mWidth, resolution.mHeight));
+
+      results.push_back(
+        {
+          "scroll_construct",
+          parameters,
+          ToMilliseconds(Clock::now() - startTime),
+          "ms"
+        });
+
+      pWindow->SetSize(wxSize(1280, 720));
+
+      std::vector<double> paintTimes;
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        startTime = Clock::now();
+
+        pWindow->Refresh(false);
+
+        pWindow->Update();
+
+        paintTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+      }
+
+      AddPercentiles(results, "scroll_paint", parameters, paintTimes);
+
+      std::vector<double> panTimes;
+
+      auto position = wxPoint(640, 360);
+
+      PostMouseEvent(pWindow, wxEVT_LEFT_DOWN, position);
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        position -= wxPoint(8, 4);
+
+        PumpFrame();
+
+        startTime = Clock::now();
+
+        PostMouseEvent(pWindow, wxEVT_MOTION, position);
+
+        pWindow->Update();
+
+        panTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+      }
+
+      PostMouseEvent(pWindow, wxEVT_LEFT_UP, position);
+
+      AddPercentiles(results, "scroll_pan_frame", parameters, panTimes);
+
+      pWindow->Destroy();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Paints a 4k image zoomed to 1:1 under an overlay of detection boxes,
+  // labels and tracks spread over all of it, so most are culled.
+  //----------------------------------------------------------------------------
+  void BenchmarkOverlay(wxFrame* pFrame, std::vector<Result>& results)
+  {
+    constexpr auto iterationCount = 60;
+
+    constexpr auto width = 3840;
+
+    constexpr auto height = 2160;
+
+    auto pWindow = new gs::ScrollWindow(pFrame, MakeTestWxImage(width, height));
+
+    pWindow->SetSize(wxSize(1280, 720));
+
+    for (auto boxCount : {100, 1000, 10000})
+    {
+      auto pOverlay = std::make_shared<gs::Overlay>();
+
+      for (auto box = 0; box < boxCount; ++box)
+      {
+        auto x = double(box * 7919 % (width - 40));
+
+        auto y = double(box * 104729 % (height - 40));
+
+        pOverlay->AddRect(x, y, 40, 30, *wxGREEN);
+
+        pOverlay->AddLabel(x, y - 14, std::to_string(box), *wxGREEN);
+
+        float track[32];
+
+        for (auto point = 0; point < 16; ++point)
+        {
+          track[point * 2] = float(x - point * 3);
+
+          track[point * 2 + 1] = float(y + 15 + (point % 3));
+        }
+
+        pOverlay->AddPolyline(track, 16, *wxRED);
+      }
+
+      pWindow->SetOverlay(0, pOverlay);
+
+      DrainGuiDispatcher();
+
+      auto parameters =
+        std::string("{\"boxes\": ") + std::to_string(boxCount) + "}";
+
+      std::vector<double> paintTimes;
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        auto startTime = Clock::now();
+
+        pWindow->Refresh(false);
+
+        pWindow->Update();
+
+        paintTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+      }
+
+      AddPercentiles(results, "overlay_paint", parameters, paintTimes);
+    }
+
+    pWindow->Destroy();
+  }
+
+  //----------------------------------------------------------------------------
+  // Building a frame's statistics, done on a worker for every primary frame,
+  // and looking regions of every size up in them, done on the gui thread.
+  //----------------------------------------------------------------------------
+  void BenchmarkImageStatistics(std::vector<Result>& results)
+  {
+    constexpr auto iterationCount = 10;
+
+    constexpr auto queryCount = 100000;
+
+    for (const auto& resolution : Resolutions)
+    {
+      auto parameters =
+        std::string("{\"resolution\": \"") + resolution.mName + "\"}";
+
+      auto pTestImage =
+        MakeTestImage(resolution.mWidth, resolution.mHeight, 0);
+
+      gs::ImageView view {
+        reinterpret_cast<const uint8_t*>(pTestImage->mPixels.data()),
+        resolution.mWidth,
+        resolution.mHeight,
+        std::size_t(resolution.mWidth) * 3};
+
+      std::vector<double> buildTimes;
+
+      std::unique_ptr<gs::ImageStatistics> pStatistics;
+
+      for (auto i = 0; i < iterationCount; ++i)
+      {
+        auto startTime = Clock::now();
+
+        pStatistics = std::make_unique<gs::ImageStatistics>(view);
+
+        buildTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+      }
+
+      AddPercentiles(results, "statistics_build", parameters, buildTimes);
+
+      double checksum = 0.0;
+
+      auto startTime = Clock::now();
+
+      for (auto i = 0; i < queryCount; ++i)
+      {
+        auto width = 1 + i * 7919 % resolution.mWidth;
+
+        auto height = 1 + i * 104729 % resolution.mHeight;
+
+        checksum += pStatistics->Get(
+          wxRect(
+            i % (resolution.mWidth - width + 1),
+            i % (resolution.mHeight - height + 1),
+            width,
+            height)).mChannels[0].mMean;
+      }
+
+      results.push_back(
+        {
+          "statistics_query",
+          parameters,
+          ToMilliseconds(Clock::now() - startTime) * 1000.0 / queryCount,
+          "us"
+        });
+
+      // keeps the lookups from being optimised away
+      if (checksum < 0.0)
+      {
+        std::cerr << checksum << std::endl;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Thirty two fields pushed from several threads at once, then one of them
+  // charted at several widths out of rings of several depths: folding a
+  // tick's worth of new samples, and painting, which should only grow with
+  // the width.
+  //----------------------------------------------------------------------------
+  void BenchmarkSparkline(wxFrame* pFrame, std::vector<Result>& results)
+  {
+    constexpr std::size_t fieldCount = 32;
+
+    constexpr auto iterationCount = 60;
+
+    // a tick's worth at 30 kHz and 30 ticks a second
+    constexpr auto samplesPerTick = 1000;
+
+    for (auto threadCount : {1u, 4u})
+    {
+      gs::SampleRing ring(fieldCount, 100000);
+
+      std::atomic<bool> isRunning(true);
+
+      std::atomic<uint64_t> pushCount(0);
+
+      std::vector<std::thread> threads;
+
+      auto startTime = Clock::now();
+
+      for (auto i = 0u; i < threadCount; ++i)
+      {
+        threads.emplace_back([&isRunning, &pushCount, &ring]
+        {
+          std::array<double, fieldCount> values {};
+
+          uint64_t count = 0;
+
+          while (isRunning.load(std::memory_order_relaxed))
+          {
+            values[0] = double(count);
+
+            ring.Push(values.data());
+
+            ++count;
+          }
+
+          pushCount += count;
+        });
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+      isRunning = false;
+
+      for (auto& thread : threads)
+      {
+        thread.join();
+      }
+
+      auto seconds =
+        std::chrono::duration<double>(Clock::now() - startTime).count();
+
+      results.push_back(
+        {
+          "sparkline_push_throughput",
+          "{\"fields\": 32, \"threads\": " + std::to_string(threadCount) + "}",
+          pushCount / seconds,
+          "pushes/s"
+        });
+    }
+
+    for (auto depth : {10000u, 1000000u})
+    {
+      auto pRing = std::make_shared<gs::SampleRing>(fieldCount, depth);
+
+      std::array<double, fieldCount> values {};
+
+      auto push = [&pRing, &values] (std::size_t count)
+      {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          values[0] = std::sin(pRing->GetCount() * 0.001) * 100.0;
+
+          pRing->Push(values.data());
+        }
+      };
+
+      push(depth);
+
+      for (auto width : {200, 800, 3200})
+      {
+        auto pSparkline = new gs::Sparkline(pFrame, pRing, 0, "value");
+
+        pSparkline->SetSize(wxSize(width, 48));
+
+        // folds the whole ring once, as showing a sparkline does
+        pSparkline->Synchronize();
+
+        auto parameters =
+          "{\"depth\": " + std::to_string(depth) +
+          ", \"width\": " + std::to_string(width) + "}";
+
+        std::vector<double> synchronizeTimes;
+
+        std::vector<double> paintTimes;
+
+        for (auto i = 0; i < iterationCount; ++i)
+        {
+          push(samplesPerTick);
+
+          auto startTime = Clock::now();
+
+          pSparkline->Synchronize();
+
+          synchronizeTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+
+          startTime = Clock::now();
+
+          pSparkline->Refresh(false);
+
+          pSparkline->Update();
+
+          paintTimes.push_back(ToMilliseconds(Clock::now() - startTime));
+        }
+
+        AddPercentiles(
+          results,
+          "sparkline_synchronize",
+          parameters,
+          synchronizeTimes);
+
+        AddPercentiles(results, "sparkline_paint", parameters, paintTimes);
+
+        pSparkline->Destroy();
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void WriteResults(std::ostream& stream, const std::vector<Result>& results)
+  {
+    stream << "{\n  \"results\":\n  [\n";
+
+    for (auto i = 0u; i < results.size(); ++i)
+    {
+      const auto& result = results[i];
+
+      stream
+        << "    {\"name\": \"" << result.mName << "\", "
+        << "\"parameters\": " << result.mParameters << ", "
+        << "\"value\": " << result.mValue << ", "
+        << "\"unit\": \"" << result.mUnit << "\"}"
+        << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+
+    stream << "  ]\n}\n";
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+bool App::OnInit()
+{
+  SetVendorName("Lomancer Heavy Industries");
+
+  SetAppName("GuiStuff Benchmark");
+
+  if (argc > 1)
+  {
+    mOutputFilename = argv[1].ToStdString();
+  }
+
+  mpFrame = new wxFrame(
+    nullptr,
+    wxID_ANY,
+    "GuiStuff Benchmark",
+    wxDefaultPosition,
+    wxSize(1300, 760));
+
+  mpFrame->Show();
+
+  CallAfter([this] { RunBenchmarks(); });
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+void App::RunBenchmarks()
+{
+  std::vector<Result> results;
+
+  try
+  {
+    BenchmarkGridSet(mpFrame, results);
+
+    BenchmarkFrameClock(mpFrame, results);
+
+    BenchmarkPictureInPicture(mpFrame, results);
+
+    BenchmarkMultiImage(mpFrame, results);
+
+    BenchmarkScrollWindow(mpFrame, results);
+
+    BenchmarkOverlay(mpFrame, results);
+
+    BenchmarkImageStatistics(results);
+
+    BenchmarkSparkline(mpFrame, results);
+  }
+  catch (const std::exception& exception)
+  {
+    std::cerr << "benchmark failed: " << exception.what() << std::endl;
+
+    // Closures still queued point at widgets that are alive, tearing any of
+    // them or the app down would hand those closures deleted windows.
+    std::_Exit(EXIT_FAILURE);
+  }
+
+  if (mOutputFilename.empty())
+  {
+    WriteResults(std::cout, results);
+  }
+  else
+  {
+    std::ofstream stream(mOutputFilename);
+
+    WriteResults(stream, results);
+  }
+
+  mpFrame->Destroy();
+}
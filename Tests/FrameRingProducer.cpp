@@ -0,0 +1,169 @@
+#include <GuiStuff/FrameRing.hpp>
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+//******************************************************************************
+// Stands in for a camera process: publishes a moving test pattern to a frame
+// ring at a steady rate until interrupted, for PictureInPictureWindowTest to
+// attach to.
+//
+//   FrameRingProducer /name [width height [rate [rgb|mono8|mono16|bayer]]]
+//******************************************************************************
+namespace
+{
+  volatile std::sig_atomic_t isStopping = 0;
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  void OnSignal(int)
+  {
+    isStopping = 1;
+  }
+
+  //----------------------------------------------------------------------------
+  //----------------------------------------------------------------------------
+  bool GetFormat(const std::string& name, gs::PixelFormat& format)
+  {
+    if (name == "rgb")
+    {
+      format = {gs::PixelEncoding::Rgb8};
+    }
+    else if (name == "mono8")
+    {
+      format = {gs::PixelEncoding::Mono8};
+    }
+    else if (name == "mono16")
+    {
+      format = {gs::PixelEncoding::Mono16, 12};
+    }
+    else if (name == "bayer")
+    {
+      format = {gs::PixelEncoding::BayerRg8};
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Diagonal bands scrolling by four pixels a frame, each channel of a Bayer
+  // mosaic taken from the same colours as the RGB pattern.
+  //----------------------------------------------------------------------------
+  void DrawFrame(
+    uint8_t* pPixels,
+    unsigned width,
+    unsigned height,
+    const gs::PixelFormat& format,
+    uint64_t frame)
+  {
+    auto shift = static_cast<unsigned>(frame * 4);
+
+    for (unsigned y = 0; y < height; ++y)
+    {
+      for (unsigned x = 0; x < width; ++x)
+      {
+        uint8_t red = (x + shift) & 0xff;
+
+        uint8_t green = (x + y + shift) & 0xff;
+
+        uint8_t blue = (y + shift) & 0xff;
+
+        switch (format.mEncoding)
+        {
+          case gs::PixelEncoding::Mono8:
+            *pPixels++ = green;
+            break;
+
+          case gs::PixelEncoding::Mono16:
+            *pPixels++ = (green << 4) & 0xff;
+            *pPixels++ = green >> 4;
+            break;
+
+          case gs::PixelEncoding::BayerRg8:
+            *pPixels++ =
+              y % 2 == 0 ? (x % 2 == 0 ? red : green) :
+              (x % 2 == 0 ? green : blue);
+            break;
+
+          default:
+            *pPixels++ = red;
+            *pPixels++ = green;
+            *pPixels++ = blue;
+            break;
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  if (argc != 2 && argc != 4 && argc != 5 && argc != 6)
+  {
+    std::cerr
+      << "usage: " << argv[0]
+      << " /name [width height [rate [rgb|mono8|mono16|bayer]]]\n";
+
+    return EXIT_FAILURE;
+  }
+
+  std::string name = argv[1];
+
+  unsigned width = argc > 2 ? std::stoul(argv[2]) : 1920;
+
+  unsigned height = argc > 3 ? std::stoul(argv[3]) : 1080;
+
+  double rate = argc > 4 ? std::stod(argv[4]) : 60.0;
+
+  gs::PixelFormat format {gs::PixelEncoding::Rgb8};
+
+  if ((argc > 5 && !GetFormat(argv[5], format)) || rate <= 0.0)
+  {
+    std::cerr << "unknown format or bad rate\n";
+
+    return EXIT_FAILURE;
+  }
+
+  std::signal(SIGINT, OnSignal);
+
+  std::signal(SIGTERM, OnSignal);
+
+  gs::FrameRingWriter writer(
+    name,
+    8,
+    std::size_t(width) * height * gs::GetBytesPerPixel(format));
+
+  auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(1.0 / rate));
+
+  auto nextFrameTime = std::chrono::steady_clock::now();
+
+  while (!isStopping)
+  {
+    if (auto pPixels = writer.BeginFrame())
+    {
+      DrawFrame(pPixels, width, height, format, writer.GetPublishedCount());
+
+      writer.EndFrame(width, height, format);
+    }
+
+    nextFrameTime += period;
+
+    std::this_thread::sleep_until(nextFrameTime);
+  }
+
+  std::cout
+    << writer.GetPublishedCount() << " frames published, "
+    << writer.GetDroppedCount() << " dropped\n";
+
+  return EXIT_SUCCESS;
+}
@@ -77,8 +77,18 @@ bool App::OnInit()
 
   auto pFrame = new wxFrame(nullptr, wxID_ANY, "Grid Displayer Test");
 
+  gs::GridDisplayerOptions options;
+
+  options.mShowStatistics = true;
+
+  options.mSparklineDepth = 1000;
+
   auto pGridDisplayer =
-    new gs::GridDisplayer<gs::test::MotorCommand, gs::test::Position>(pFrame);
+    new gs::GridDisplayer<gs::test::MotorCommand, gs::test::Position>(
+      pFrame,
+      options);
+
+  pGridDisplayer->ShowSparkline<gs::test::MotorCommand>(0);
 
   auto pMainSizer = new wxBoxSizer(wxHORIZONTAL);
 
@@ -0,0 +1,84 @@
+#include <GuiStuff/MultiImageWindow.hpp>
+#include <wx/app.h>
+#include <wx/frame.h>
+#include <wx/sizer.h>
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+class App : public wxApp
+{
+  public:
+
+    bool OnInit() override;
+
+  private:
+
+    wxImage mImage1;
+
+    wxImage mImage2;
+};
+
+IMPLEMENT_APP(App);
+
+//------------------------------------------------------------------------------
+// Shows the two test pictures over and over in a mosaic, or one tile per
+// frame ring named on the command line (see FrameRingProducer).
+//------------------------------------------------------------------------------
+bool App::OnInit()
+{
+  wxInitAllImageHandlers();
+
+  auto pFrame =
+    new wxFrame(
+      nullptr,
+      wxID_ANY,
+      wxT("test frame"),
+      wxPoint(200, 200),
+      wxSize(1000, 800));
+
+  wxBoxSizer* pSizer = new wxBoxSizer(wxHORIZONTAL);
+
+  auto Image1Filename = GUISTUFF_STATIC_DIR "/pic.png";
+  auto Image2Filename = GUISTUFF_STATIC_DIR "/pic2.png";
+
+  if (
+    !mImage1.LoadFile(Image1Filename, wxBITMAP_TYPE_ANY) ||
+    !mImage2.LoadFile(Image2Filename , wxBITMAP_TYPE_ANY))
+  {
+    return false;
+  }
+
+  std::size_t StreamCount = argc > 1 ? argc - 1 : 9;
+
+  auto pMultiImageWindow = new gs::MultiImageWindow(pFrame, StreamCount);
+
+  pMultiImageWindow->SetLayout(gs::MultiImageWindow::Layout::Mosaic);
+
+  for (std::size_t Stream = 0; Stream < StreamCount; ++Stream)
+  {
+    if (argc > 1)
+    {
+      pMultiImageWindow->AttachImage(Stream, argv[Stream + 1].ToStdString());
+
+      continue;
+    }
+
+    auto& Image = Stream % 2 == 0 ? mImage1 : mImage2;
+
+    pMultiImageWindow->SetImage(
+      Stream,
+      std::make_shared<const dl::image::Image>(
+        Image.GetWidth(),
+        Image.GetHeight(),
+        std::experimental::make_observer(
+          reinterpret_cast<std::byte*>(Image.GetData()))));
+  }
+
+  pSizer->Add(pMultiImageWindow, 1, wxEXPAND);
+
+  pFrame->SetSizer(pSizer);
+
+  pFrame->Show();
+
+  return true;
+}
@@ -33,8 +33,8 @@ bool App::OnInit()
 
   wxImage Image1, Image2;
 
-  auto Image1Filename = "/home/dloman/Source/GuiStuff/Tests/Static/pic.png";
-  auto Image2Filename = "/home/dloman/Source/GuiStuff/Tests/Static/pic2.png";
+  auto Image1Filename = GUISTUFF_STATIC_DIR "/pic.png";
+  auto Image2Filename = GUISTUFF_STATIC_DIR "/pic2.png";
 
   if (
     !Image1.LoadFile(Image1Filename, wxBITMAP_TYPE_ANY) ||
@@ -60,6 +60,21 @@ bool App::OnInit()
 
   pPictureInPicture->SetImage2(pImageWrapper2);
 
+  // right drag a region, or hover, to see its statistics
+  pPictureInPicture->EnableStatistics();
+
+  // Frame rings named on the command line (see FrameRingProducer) replace
+  // the pictures.
+  if (argc > 1)
+  {
+    pPictureInPicture->AttachImage1(argv[1].ToStdString());
+  }
+
+  if (argc > 2)
+  {
+    pPictureInPicture->AttachImage2(argv[2].ToStdString());
+  }
+
   pSizer->Add(pPictureInPicture, 1, wxEXPAND);
 
   pFrame->SetSizer(pSizer);
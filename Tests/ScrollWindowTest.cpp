@@ -3,6 +3,10 @@
 #include <wx/frame.h>
 #include <wx/sizer.h>
 
+#include <exception>
+#include <iostream>
+#include <memory>
+
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
 class App : public wxApp
@@ -16,6 +20,11 @@ class App : public wxApp
 IMPLEMENT_APP(App);
 
 //------------------------------------------------------------------------------
+// ScrollWindowTest [tiled file | raw rgb file width height |
+//                   --write tiled file [image file]]
+//
+// --write converts the image (the bundled picture by default) to a tiled
+// file and shows that.
 //------------------------------------------------------------------------------
 bool App::OnInit()
 {
@@ -31,15 +40,89 @@ bool App::OnInit()
 
   wxBoxSizer* pSizer = new wxBoxSizer(wxHORIZONTAL);
 
-  wxImage Image;
+  gs::ScrollWindow* pScrollWindow = nullptr;
 
-  if (
-    !Image.LoadFile("/home/dloman/Source/GuiStuff/pic.png", wxBITMAP_TYPE_ANY))
+  try
   {
-    return false;
+    if ((argc == 3 || argc == 4) && argv[1] == "--write")
+    {
+      wxImage Image;
+
+      auto Filename =
+        argc == 4 ? argv[3] : wxString(GUISTUFF_STATIC_DIR "/pic.png");
+
+      if (!Image.LoadFile(Filename, wxBITMAP_TYPE_ANY))
+      {
+        std::cerr << "can't load " << Filename << std::endl;
+
+        pFrame->Destroy();
+
+        return false;
+      }
+
+      auto width = static_cast<unsigned>(Image.GetWidth());
+
+      gs::TiledImage::Write(
+        argv[2].ToStdString(),
+        {
+          Image.GetData(),
+          width,
+          static_cast<unsigned>(Image.GetHeight()),
+          std::size_t(width) * 3});
+
+      pScrollWindow = new gs::ScrollWindow(
+        pFrame,
+        std::make_shared<gs::TiledImage>(argv[2].ToStdString()));
+    }
+    else if (argc == 2)
+    {
+      pScrollWindow = new gs::ScrollWindow(
+        pFrame,
+        std::make_shared<gs::TiledImage>(argv[1].ToStdString()));
+    }
+    else if (argc == 4)
+    {
+      long width = 0, height = 0;
+
+      if (!argv[2].ToLong(&width) || !argv[3].ToLong(&height))
+      {
+        std::cerr << "bad width or height" << std::endl;
+
+        pFrame->Destroy();
+
+        return false;
+      }
+
+      pScrollWindow = new gs::ScrollWindow(
+        pFrame,
+        std::make_shared<gs::TiledImage>(
+          argv[1].ToStdString(),
+          static_cast<unsigned>(width),
+          static_cast<unsigned>(height)));
+    }
+    else
+    {
+      wxImage Image;
+
+      if (
+        !Image.LoadFile(GUISTUFF_STATIC_DIR "/pic.png", wxBITMAP_TYPE_ANY))
+      {
+        pFrame->Destroy();
+
+        return false;
+      }
+
+      pScrollWindow = new gs::ScrollWindow(pFrame, Image);
+    }
   }
+  catch (const std::exception& exception)
+  {
+    std::cerr << exception.what() << std::endl;
+
+    pFrame->Destroy();
 
-  auto pScrollWindow = new gs::ScrollWindow(pFrame, Image);
+    return false;
+  }
 
   pSizer->Add(pScrollWindow, 1, wxEXPAND);
 